@@ -0,0 +1,969 @@
+#include "Scene.h"
+#include "Point.h"
+#include "Segment.h"
+#include "SegmentDraw.h"
+#include "SceneFile.h"
+#include "DxfFile.h"
+#include "UndoJournal.h"
+#include "TransformKernels.h"
+#include "TileRenderer.h"
+#include "SnapIndex.h"
+#include "IntersectionFinder.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+#include <QTemporaryDir>
+
+#include <limits>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace {
+
+// Переменная-приемник, не дающая компилятору выбросить измеряемые вычисления.
+volatile double g_sink = 0.0;
+
+// Результат одного бенчмарка.
+struct BenchmarkResult
+{
+    QString name;
+    qint64 operations; // Количество измеренных операций.
+    double totalMs;    // Общее время, мс.
+    double nsPerOp;    // Среднее время одной операции, нс.
+};
+
+// Общие параметры прогона.
+struct BenchmarkConfig
+{
+    int sceneSize = 100000; // Количество отрезков в тестовой сцене.
+    int repeats = 5;        // Количество повторов (берется лучший результат).
+};
+
+// Замеряет функцию run, выполняющую operations операций, и возвращает лучший из повторов.
+// Функция setup вызывается перед каждым повтором и не входит в замер.
+template <typename Setup, typename Run>
+BenchmarkResult measure(const QString& name, qint64 operations, int repeats, Setup setup, Run run)
+{
+    qint64 best = -1;
+    for (int i = 0; i < repeats; ++i) {
+        setup();
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    return {name, operations, best / 1e6, static_cast<double>(best) / std::max<qint64>(operations, 1)};
+}
+
+// Заполняет сцену случайными отрезками в квадрате 10000 x 10000.
+void fillScene(Scene& scene, int count, std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> position(-5000.0, 5000.0);
+    std::uniform_real_distribution<double> length(-50.0, 50.0);
+    const QColor colors[] = {Qt::white, QColor("#F92672"), QColor("#66D9EF"), QColor("#A6E22E")};
+
+    for (int i = 0; i < count; ++i) {
+        const double x = position(rng);
+        const double y = position(rng);
+        auto segment = std::make_unique<Segment>(Point(x, y), Point(x + length(rng), y + length(rng)));
+        segment->setColor(colors[i % 4]);
+        scene.addPrimitive(std::move(segment));
+    }
+}
+
+// Добавление примитивов на сцену.
+BenchmarkResult benchAddPrimitive(const BenchmarkConfig& config)
+{
+    std::unique_ptr<Scene> scene;
+    return measure("Scene::addPrimitive", config.sceneSize, config.repeats,
+        [&] { scene = std::make_unique<Scene>(); },
+        [&] {
+            std::mt19937 rng(42);
+            fillScene(*scene, config.sceneSize, rng);
+        });
+}
+
+// Удаление примитивов в случайном порядке.
+BenchmarkResult benchRemovePrimitive(const BenchmarkConfig& config)
+{
+    const int removals = config.sceneSize / 10;
+    std::unique_ptr<Scene> scene;
+    std::vector<Handle> victims;
+    return measure("Scene::removePrimitive", removals, config.repeats,
+        [&] {
+            std::mt19937 rng(42);
+            scene = std::make_unique<Scene>();
+            fillScene(*scene, config.sceneSize, rng);
+            victims = scene->getPrimitiveHandles();
+            std::shuffle(victims.begin(), victims.end(), rng);
+            victims.resize(removals);
+        },
+        [&] {
+            for (const Handle& handle : victims) {
+                scene->removePrimitive(handle);
+            }
+        });
+}
+
+// Массовое удаление половины сцены одним вызовом (как при удалении выделения).
+BenchmarkResult benchRemovePrimitives(const BenchmarkConfig& config)
+{
+    const int removals = config.sceneSize / 2;
+    std::unique_ptr<Scene> scene;
+    std::vector<Handle> victims;
+    return measure("Scene::removePrimitives", removals, config.repeats,
+        [&] {
+            std::mt19937 rng(42);
+            scene = std::make_unique<Scene>();
+            fillScene(*scene, config.sceneSize, rng);
+            victims = scene->getPrimitiveHandles();
+            std::shuffle(victims.begin(), victims.end(), rng);
+            victims.resize(removals);
+        },
+        [&] {
+            scene->removePrimitives(victims);
+        });
+}
+
+// Отмена массового удаления через журнал (объекты возвращаются пакетом с прежними ID).
+BenchmarkResult benchUndoRemovePrimitives(const BenchmarkConfig& config)
+{
+    const int removals = config.sceneSize / 2;
+    std::unique_ptr<Scene> scene;
+    std::unique_ptr<UndoJournal> journal;
+    return measure("UndoJournal::undo (remove)", removals, config.repeats,
+        [&] {
+            std::mt19937 rng(42);
+            scene = std::make_unique<Scene>();
+            fillScene(*scene, config.sceneSize, rng);
+            journal = std::make_unique<UndoJournal>();
+            scene->setUndoJournal(journal.get());
+            std::vector<Handle> victims = scene->getPrimitiveHandles();
+            std::shuffle(victims.begin(), victims.end(), rng);
+            victims.resize(removals);
+            scene->removePrimitives(victims);
+        },
+        [&] {
+            journal->undo(*scene);
+            g_sink = static_cast<double>(scene->getPrimitiveCount());
+        });
+}
+
+// Поворот всей сцены (ядро работает прямо по столбцам) или случайной половины (сбор блоками).
+BenchmarkResult benchTransformPrimitives(const BenchmarkConfig& config, bool wholeScene)
+{
+    const QString name = QString("Scene::transformPrimitives (%1, %2)")
+                             .arg(wholeScene ? "all" : "half", transformKernelName());
+    const Affine2D rotation = Affine2D::rotation(0.3, 100.0, -50.0);
+    std::unique_ptr<Scene> scene;
+    std::vector<Handle> targets;
+    return measure(name, wholeScene ? config.sceneSize : config.sceneSize / 2, config.repeats,
+        [&] {
+            std::mt19937 rng(42);
+            scene = std::make_unique<Scene>();
+            fillScene(*scene, config.sceneSize, rng);
+            targets = scene->getPrimitiveHandles();
+            if (!wholeScene) {
+                std::shuffle(targets.begin(), targets.end(), rng);
+                targets.resize(targets.size() / 2);
+            }
+        },
+        [&] {
+            scene->transformPrimitives(targets, rotation);
+            g_sink = scene->getSegments().getX0(0);
+        });
+}
+
+// Поиск примитивов по дескриптору в случайном порядке.
+BenchmarkResult benchLookup(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    std::vector<Handle> handles = scene.getPrimitiveHandles();
+    std::shuffle(handles.begin(), handles.end(), rng);
+
+    return measure("Scene::getSegmentRow", config.sceneSize, config.repeats, [] {},
+        [&] {
+            std::size_t checksum = 0;
+            for (const Handle& handle : handles) {
+                checksum += scene.getSegmentRow(handle);
+            }
+            g_sink = static_cast<double>(checksum);
+        });
+}
+
+// Полный проход по всем отрезкам сцены (суммарная длина).
+BenchmarkResult benchIterate(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    const SegmentStore& segments = scene.getSegments();
+
+    return measure("Scene iteration", config.sceneSize, config.repeats, [] {},
+        [&] {
+            const double* x0 = segments.x0Data();
+            const double* y0 = segments.y0Data();
+            const double* x1 = segments.x1Data();
+            const double* y1 = segments.y1Data();
+            double total = 0.0;
+            for (std::size_t i = 0; i < segments.size(); ++i) {
+                const double dx = x1[i] - x0[i];
+                const double dy = y1[i] - y0[i];
+                total += dx * dx + dy * dy;
+            }
+            g_sink = total;
+        });
+}
+
+// Запрос видимой области через пространственный индекс.
+BenchmarkResult benchQuery(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    std::vector<Handle> result;
+    const int queries = 1000;
+
+    return measure("Scene::queryPrimitives", queries, config.repeats, [] {},
+        [&] {
+            std::mt19937 queryRng(7);
+            std::uniform_real_distribution<double> position(-5000.0, 4000.0);
+            std::size_t found = 0;
+            for (int i = 0; i < queries; ++i) {
+                result.clear();
+                scene.queryPrimitives(QRectF(position(queryRng), position(queryRng), 1000.0, 600.0), result);
+                found += result.size();
+            }
+            g_sink = static_cast<double>(found);
+        });
+}
+
+// Распределяет отрезки сцены по layers слоям (строка row - на слой row % layers).
+void splitIntoLayers(Scene& scene, std::uint32_t layers)
+{
+    std::vector<std::vector<Handle>> groups(layers);
+    for (std::uint32_t layer = 1; layer < layers; ++layer) {
+        Layer properties;
+        properties.name = QString("L%1").arg(layer);
+        scene.addLayer(properties);
+    }
+    const SegmentStore& segments = scene.getSegments();
+    for (std::size_t row = 0; row < segments.size(); ++row) {
+        groups[row % layers].push_back(segments.getHandle(row));
+    }
+    for (std::uint32_t layer = 1; layer < layers; ++layer) {
+        scene.setPrimitivesLayer(groups[layer], layer);
+    }
+}
+
+// Запрос видимой области, когда половина из восьми слоев скрыта (индексы скрытых слоев пропускаются).
+BenchmarkResult benchLayerQuery(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    splitIntoLayers(scene, 8);
+    for (std::uint32_t layer = 0; layer < 8; layer += 2) {
+        scene.setLayerVisible(layer, false);
+    }
+    std::vector<Handle> result;
+    const int queries = 1000;
+
+    return measure("Scene::queryPrimitives (4 of 8 layers)", queries, config.repeats, [] {},
+        [&] {
+            std::mt19937 queryRng(7);
+            std::uniform_real_distribution<double> position(-5000.0, 4000.0);
+            std::size_t found = 0;
+            for (int i = 0; i < queries; ++i) {
+                result.clear();
+                scene.queryPrimitives(QRectF(position(queryRng), position(queryRng), 1000.0, 600.0), result);
+                found += result.size();
+            }
+            g_sink = static_cast<double>(found);
+        });
+}
+
+// Проверяет слои: запрос пропускает скрытые слои, выбор - еще и заблокированные,
+// перенос на слой отменяется журналом, а файл сцены сохраняет слои и их свойства.
+bool verifyLayers(const BenchmarkConfig& config, const QString& path, QTextStream& out)
+{
+    Scene scene;
+    UndoJournal journal;
+    scene.setUndoJournal(&journal);
+    std::mt19937 rng(11);
+    fillScene(scene, std::min(config.sceneSize, 20000), rng);
+    splitIntoLayers(scene, 4);
+    scene.setLayerVisible(1, false);
+    scene.setLayerLocked(2, true);
+
+    const QRectF area(-2000.0, -1500.0, 3000.0, 2500.0);
+    std::vector<Handle> all, visible, editable;
+    for (std::uint32_t layer = 0; layer < scene.getLayerCount(); ++layer) {
+        std::vector<Handle> found;
+        scene.queryLayer(layer, area, found);
+        all.insert(all.end(), found.begin(), found.end());
+    }
+    for (const Handle& handle : all) {
+        if (scene.isPrimitiveVisible(handle)) visible.push_back(handle);
+        if (scene.isPrimitiveEditable(handle)) editable.push_back(handle);
+    }
+
+    std::vector<Handle> queried, selected;
+    scene.queryPrimitives(area, queried);
+    scene.selectInRect(area, SelectionMode::Crossing, selected);
+    auto sameSet = [](std::vector<Handle> a, std::vector<Handle> b) {
+        auto less = [](const Handle& x, const Handle& y) { return x.index < y.index; };
+        std::sort(a.begin(), a.end(), less);
+        std::sort(b.begin(), b.end(), less);
+        return a == b;
+    };
+    // Выбор рамкой точнее индекса, поэтому сравнивается только принадлежность слоям.
+    bool ok = sameSet(queried, visible);
+    for (const Handle& handle : selected) {
+        ok = ok && scene.isPrimitiveEditable(handle);
+    }
+    if (!ok) {
+        out << "Layer query returned primitives of hidden or locked layers\n";
+        return false;
+    }
+
+    const std::size_t before = scene.getLayerPrimitiveCount(0);
+    scene.setPrimitivesLayer(editable, 3);
+    journal.undo(scene);
+    if (scene.getLayerPrimitiveCount(0) != before) {
+        out << "Undo of a layer move did not restore layer 0\n";
+        return false;
+    }
+
+    QString error;
+    Scene loaded;
+    if (!SceneFile::save(scene, path, &error) || !SceneFile::load(loaded, path, &error)) {
+        out << "Scene file round trip with layers failed: " << error << "\n";
+        return false;
+    }
+    ok = loaded.getLayerCount() == scene.getLayerCount();
+    for (std::uint32_t layer = 0; ok && layer < scene.getLayerCount(); ++layer) {
+        const Layer& a = scene.getLayer(layer);
+        const Layer& b = loaded.getLayer(layer);
+        ok = a.name == b.name && a.visible == b.visible && a.locked == b.locked &&
+             loaded.getLayerPrimitiveCount(layer) == scene.getLayerPrimitiveCount(layer);
+    }
+    if (!ok) {
+        out << "Scene file round trip produced different layers\n";
+    }
+    return ok;
+}
+
+// Поиск ближайшего отрезка под курсором (щелчок и подсветка во вьюпорте).
+BenchmarkResult benchPick(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    const int picks = 10000;
+
+    return measure("Scene::pick", picks, config.repeats, [] {},
+        [&] {
+            std::mt19937 pickRng(11);
+            std::uniform_real_distribution<double> position(-5000.0, 5000.0);
+            std::size_t found = 0;
+            for (int i = 0; i < picks; ++i) {
+                found += scene.pick(QPointF(position(pickRng), position(pickRng)), 5.0).isValid() ? 1 : 0;
+            }
+            g_sink = static_cast<double>(found);
+        });
+}
+
+// Полное построение индекса привязки (после загрузки сцены; во вьюпорте выполняется порциями).
+BenchmarkResult benchSnapBuild(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    SnapIndex index;
+
+    return measure("SnapIndex::build", config.sceneSize, config.repeats, [&] { index.invalidate(); },
+        [&] {
+            index.build(scene, std::numeric_limits<double>::infinity());
+            g_sink = static_cast<double>(index.getPointCount());
+        });
+}
+
+// Поиск точки привязки у курсора (как при каждом движении мыши во вьюпорте).
+BenchmarkResult benchSnapQuery(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    SnapIndex index;
+    index.build(scene, std::numeric_limits<double>::infinity()); // Построение индекса не входит в замер.
+    const int queries = 10000;
+
+    return measure("SnapIndex::findSnap", queries, config.repeats, [] {},
+        [&] {
+            std::mt19937 queryRng(11);
+            std::uniform_real_distribution<double> position(-5000.0, 5000.0);
+            std::size_t found = 0;
+            for (int i = 0; i < queries; ++i) {
+                found += index.findSnap(scene, QPointF(position(queryRng), position(queryRng)), 10.0, 50.0).isValid();
+            }
+            g_sink = static_cast<double>(found);
+        });
+}
+
+// Проверяет, что индекс привязки, обновляемый по уведомлениям сцены, совпадает с построенным заново
+// и с поиском по индексу сцены (пока индекс привязки не построен).
+bool verifySnapIndex(const BenchmarkConfig& config, QTextStream& out)
+{
+    // Передает уведомления сцены индексу, как это делает вьюпорт.
+    struct Forwarder : SceneListener
+    {
+        Scene* scene = nullptr;
+        SnapIndex* index = nullptr;
+        void onSceneChanged(const SceneChange& change) override { index->applyChange(*scene, change); }
+    };
+
+    Scene scene;
+    std::mt19937 rng(9);
+    fillScene(scene, std::min(config.sceneSize, 20000), rng);
+    SnapIndex incremental;
+    incremental.build(scene, std::numeric_limits<double>::infinity());
+    Forwarder forwarder;
+    forwarder.scene = &scene;
+    forwarder.index = &incremental;
+    scene.addListener(&forwarder);
+
+    // Перемещение, удаление и добавление отрезков небольшими транзакциями.
+    const SegmentStore& segments = scene.getSegments();
+    std::vector<Handle> targets;
+    for (std::size_t row = 0; row < segments.size(); row += 7) targets.push_back(segments.getHandle(row));
+    scene.transformPrimitives(targets, Affine2D::rotation(0.3, 100.0, -50.0));
+    targets.clear();
+    for (std::size_t row = 0; row < segments.size(); row += 11) targets.push_back(segments.getHandle(row));
+    scene.removePrimitives(targets);
+    fillScene(scene, 500, rng);
+    scene.setSegmentStart(segments.getHandle(0), Point(1.0, 2.0));
+    scene.removeListener(&forwarder);
+
+    SnapIndex rebuilt;
+    rebuilt.build(scene, std::numeric_limits<double>::infinity());
+    SnapIndex pending; // Не построен: поиск продолжает построение и привязывает по индексу сцены.
+    if (!incremental.isReady()) {
+        out << "Snap index was rebuilt instead of updated\n";
+        return false;
+    }
+    if (incremental.getPointCount() != 3 * segments.size()) {
+        out << "Snap index has " << incremental.getPointCount() << " points, expected " << 3 * segments.size() << "\n";
+        return false;
+    }
+    std::uniform_real_distribution<double> position(-5000.0, 5000.0);
+    for (int i = 0; i < 2000; ++i) {
+        const QPointF point(position(rng), position(rng));
+        const SnapResult a = incremental.findSnap(scene, point, 25.0, 0.0);
+        const SnapResult b = rebuilt.findSnap(scene, point, 25.0, 0.0);
+        const SnapResult c = pending.findSnap(scene, point, 25.0, 0.0);
+        if (a.kind != b.kind || a.point != b.point || a.kind != c.kind || a.point != c.point) {
+            out << "Snap mismatch at (" << point.x() << ", " << point.y() << ")\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Поиск всех пересечений отрезков сцены.
+BenchmarkResult benchIntersections(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+
+    return measure("IntersectionFinder::find", config.sceneSize, config.repeats, [] {},
+        [&] { g_sink = static_cast<double>(IntersectionFinder::find(scene.getSegments()).size()); });
+}
+
+// Проверяет поиск пересечений по полосам перебором всех пар на сцене с наложениями,
+// примыканиями и стыками (целочисленные координаты на общих прямых).
+bool verifyIntersections(const BenchmarkConfig& config, QTextStream& out)
+{
+    Scene scene;
+    std::mt19937 rng(13);
+    fillScene(scene, std::min(config.sceneSize, 3000) / 2, rng);
+    std::uniform_int_distribution<int> position(-100, 100);
+    std::uniform_int_distribution<int> length(-30, 30);
+    for (int i = 0; i < std::min(config.sceneSize, 3000) / 2; ++i) {
+        const int x = position(rng) * 50;
+        const int y = position(rng) * 50;
+        const bool horizontal = i % 2 == 0;
+        const int delta = length(rng) * 25;
+        scene.addPrimitive(std::make_unique<Segment>(Point(x, y), horizontal ? Point(x + delta, y) : Point(x, y + delta)));
+    }
+
+    const SegmentStore& segments = scene.getSegments();
+    std::vector<std::tuple<unsigned, unsigned, IntersectionKind>> expected;
+    for (std::size_t a = 0; a < segments.size(); ++a) {
+        for (std::size_t b = a + 1; b < segments.size(); ++b) {
+            SegmentIntersection intersection;
+            if (IntersectionFinder::intersect(segments, a, b, intersection)) {
+                expected.emplace_back(intersection.firstId, intersection.secondId, intersection.kind);
+            }
+        }
+    }
+
+    std::vector<std::tuple<unsigned, unsigned, IntersectionKind>> found;
+    for (const SegmentIntersection& intersection : IntersectionFinder::find(segments)) {
+        found.emplace_back(intersection.firstId, intersection.secondId, intersection.kind);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    if (found != expected) {
+        out << "IntersectionFinder found " << found.size() << " intersections, expected " << expected.size() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Выделение рамкой на половину сцены (грубый отбор по индексу и параллельная точная проверка).
+BenchmarkResult benchSelectInRect(const BenchmarkConfig& config, SelectionMode mode, const char* name)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+    std::vector<Handle> result;
+
+    return measure(name, config.sceneSize, config.repeats, [&] { result.clear(); },
+        [&] {
+            scene.selectInRect(QRectF(-5000.0, -5000.0, 7000.0, 7000.0), mode, result);
+            g_sink = static_cast<double>(result.size());
+        });
+}
+
+// Сохранение сцены в двоичный файл (столбцы пишутся одной операцией каждый).
+BenchmarkResult benchSceneSave(const BenchmarkConfig& config, const QString& path)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+
+    return measure("SceneFile::save", config.sceneSize, config.repeats, [] {},
+        [&] { g_sink = SceneFile::save(scene, path) ? 1.0 : 0.0; });
+}
+
+// Загрузка сцены отображением файла в память (без чтения координат).
+BenchmarkResult benchSceneLoad(const BenchmarkConfig& config, const QString& path)
+{
+    Scene scene;
+    return measure("SceneFile::load", config.sceneSize, config.repeats, [] {},
+        [&] { g_sink = SceneFile::load(scene, path) ? 1.0 : 0.0; });
+}
+
+// Загрузка сцены и первый запрос к ней (включает ленивое построение пространственного индекса).
+BenchmarkResult benchSceneLoadAndQuery(const BenchmarkConfig& config, const QString& path)
+{
+    Scene scene;
+    std::vector<Handle> result;
+    return measure("SceneFile::load + query", config.sceneSize, config.repeats, [&] { result.clear(); },
+        [&] {
+            SceneFile::load(scene, path);
+            scene.queryPrimitives(QRectF(-500.0, -500.0, 1000.0, 1000.0), result);
+            g_sink = static_cast<double>(result.size());
+        });
+}
+
+// Проверяет, что сохраненная и загруженная сцена совпадает с исходной (включая последующие изменения).
+bool verifySceneFileRoundTrip(const BenchmarkConfig& config, const QString& path, QTextStream& out)
+{
+    Scene original;
+    std::mt19937 rng(7);
+    fillScene(original, config.sceneSize, rng);
+    original.removePrimitive(original.getSegments().getHandle(0)); // Строки переставлены, ID с пропуском
+
+    QString error;
+    Scene loaded;
+    if (!SceneFile::save(original, path, &error) || !SceneFile::load(loaded, path, &error)) {
+        out << "Scene file round trip failed: " << error << "\n";
+        return false;
+    }
+
+    const SegmentStore& a = original.getSegments();
+    const SegmentStore& b = loaded.getSegments();
+    bool same = a.size() == b.size() && original.getNextID() == loaded.getNextID();
+    for (std::size_t row = 0; same && row < a.size(); ++row) {
+        same = a.getX0(row) == b.getX0(row) && a.getY0(row) == b.getY0(row) &&
+               a.getX1(row) == b.getX1(row) && a.getY1(row) == b.getY1(row) &&
+               a.getID(row) == b.getID(row) && a.getColor(row) == b.getColor(row);
+    }
+
+    // Изменение загруженной сцены копирует столбцы из файла и не затрагивает сам файл.
+    if (same && b.size() > 1) {
+        const Handle first = b.getHandle(0);
+        loaded.setSegmentStart(first, Point(1.0, 2.0));
+        loaded.removePrimitive(b.getHandle(1));
+        same = b.getX0(0) == 1.0 && b.getY0(0) == 2.0 && b.size() == a.size() - 1;
+
+        Scene reloaded;
+        same = same && SceneFile::load(reloaded, path) && reloaded.getSegments().getX0(0) == a.getX0(0);
+
+        std::vector<Handle> found;
+        loaded.queryPrimitives(QRectF(0.5, 1.5, 1.0, 1.0), found);
+        same = same && std::find(found.begin(), found.end(), first) != found.end();
+    }
+
+    if (!same) {
+        out << "Scene file round trip produced a different scene\n";
+    }
+    return same;
+}
+
+// Экспорт сцены в DXF (параллельное форматирование блоков строк).
+BenchmarkResult benchDxfExport(const BenchmarkConfig& config, const QString& path)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+
+    return measure("DxfFile::exportTo", config.sceneSize, config.repeats, [] {},
+        [&] { g_sink = DxfFile::exportTo(scene, path) ? 1.0 : 0.0; });
+}
+
+// Потоковый импорт DXF в пустую сцену (чтение, параллельный разбор и пакетная вставка).
+BenchmarkResult benchDxfImport(const BenchmarkConfig& config, const QString& path)
+{
+    std::unique_ptr<Scene> scene;
+    return measure("DxfFile::importFrom", config.sceneSize, config.repeats,
+        [&] { scene = std::make_unique<Scene>(); },
+        [&] { g_sink = DxfFile::importFrom(*scene, path) ? 1.0 : 0.0; });
+}
+
+// Проверяет, что экспорт в DXF и обратный импорт сохраняют координаты и цвета отрезков.
+bool verifyDxfRoundTrip(const BenchmarkConfig& config, const QString& path, QTextStream& out)
+{
+    Scene original;
+    std::mt19937 rng(9);
+    fillScene(original, config.sceneSize, rng);
+
+    QString error;
+    Scene imported;
+    if (!DxfFile::exportTo(original, path, &error) || !DxfFile::importFrom(imported, path, &error)) {
+        out << "DXF round trip failed: " << error << "\n";
+        return false;
+    }
+
+    // Экспорт идет в порядке строк хранилища, импорт добавляет отрезки в том же порядке.
+    const SegmentStore& a = original.getSegments();
+    const SegmentStore& b = imported.getSegments();
+    bool same = a.size() == b.size();
+    for (std::size_t row = 0; same && row < a.size(); ++row) {
+        same = a.getX0(row) == b.getX0(row) && a.getY0(row) == b.getY0(row) &&
+               a.getX1(row) == b.getX1(row) && a.getY1(row) == b.getY1(row) &&
+               a.getColor(row) == b.getColor(row);
+    }
+
+    if (!same) {
+        out << "DXF round trip produced a different scene\n";
+    }
+    return same;
+}
+
+// Проверяет, что массовое преобразование совпадает с поточечным и обновляет пространственный индекс.
+bool verifyTransform(const BenchmarkConfig& config, QTextStream& out)
+{
+    Scene scene;
+    std::mt19937 rng(5);
+    fillScene(scene, config.sceneSize, rng);
+    const SegmentStore& segments = scene.getSegments();
+    std::vector<SegmentRecord> before;
+    for (std::size_t row = 0; row < segments.size(); ++row) {
+        before.push_back(scene.getSegmentRecord(segments.getHandle(row)));
+    }
+
+    // Отражение после поворота и масштабирования; преобразуется каждый третий отрезок.
+    const Affine2D transform = Affine2D::mirror(0.0, 0.0, 1.0, 2.0) *
+                               Affine2D::rotation(1.1, 10.0, 20.0) * Affine2D::scaling(1.5, 0.5);
+    std::vector<Handle> targets;
+    for (std::size_t row = 0; row < segments.size(); row += 3) {
+        targets.push_back(segments.getHandle(row));
+    }
+    scene.transformPrimitives(targets, transform);
+
+    std::vector<Handle> found;
+    for (std::size_t row = 0; row < segments.size(); ++row) {
+        SegmentRecord expected = before[row];
+        if (row % 3 == 0) {
+            transform.map(expected.x0, expected.y0);
+            transform.map(expected.x1, expected.y1);
+        }
+        const Handle handle = segments.getHandle(row);
+        const bool same = segments.getX0(row) == expected.x0 && segments.getY0(row) == expected.y0 &&
+                          segments.getX1(row) == expected.x1 && segments.getY1(row) == expected.y1;
+        found.clear();
+        scene.queryPrimitives(scene.getBoundingBox(handle).adjusted(-1.0, -1.0, 1.0, 1.0), found);
+        if (!same || std::find(found.begin(), found.end(), handle) == found.end()) {
+            out << "Transform mismatch at row " << row << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Перевод из полярных координат в декартовы.
+BenchmarkResult benchSetPolar(const BenchmarkConfig& config)
+{
+    const int operations = config.sceneSize * 10;
+    return measure("Point::setPolar", operations, config.repeats, [] {},
+        [&] {
+            Point point;
+            double total = 0.0;
+            for (int i = 0; i < operations; ++i) {
+                point.setPolar(1.0 + (i & 1023), i % 360);
+                total += point.getX();
+            }
+            g_sink = total;
+        });
+}
+
+// Вычисление полярного угла.
+BenchmarkResult benchGetAngle(const BenchmarkConfig& config)
+{
+    const int operations = config.sceneSize * 10;
+    return measure("Point::getAngle", operations, config.repeats, [] {},
+        [&] {
+            Point point;
+            double total = 0.0;
+            for (int i = 0; i < operations; ++i) {
+                point.setX((i & 1023) - 512.0);
+                point.setY((i & 511) - 256.0);
+                total += point.getAngle();
+            }
+            g_sink = total;
+        });
+}
+
+// Отрисовка всех отрезков в QImage через стратегию SegmentDraw.
+BenchmarkResult benchSegmentDraw(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    const int count = std::min(config.sceneSize, 20000);
+    fillScene(scene, count, rng);
+    const std::vector<Handle> handles = scene.getPrimitiveHandles();
+
+    QImage image(1024, 1024, QImage::Format_ARGB32_Premultiplied);
+    SegmentDraw strategy;
+
+    return measure("SegmentDraw::draw", count, config.repeats,
+        [&] { image.fill(Qt::transparent); },
+        [&] {
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.translate(512, 512);
+            painter.scale(0.1, 0.1);
+            for (const Handle& handle : handles) {
+                Segment view(&scene, handle);
+                strategy.draw(painter, &view, false);
+            }
+        });
+}
+
+// Пакетная отрисовка тех же отрезков через SegmentDraw::drawBatch.
+BenchmarkResult benchSegmentDrawBatch(const BenchmarkConfig& config)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    const int count = std::min(config.sceneSize, 20000);
+    fillScene(scene, count, rng);
+    std::vector<std::size_t> rows(scene.getSegments().size());
+    for (std::size_t i = 0; i < rows.size(); ++i) rows[i] = i;
+
+    QImage image(1024, 1024, QImage::Format_ARGB32_Premultiplied);
+    SegmentDraw strategy;
+
+    return measure("SegmentDraw::drawBatch", count, config.repeats,
+        [&] { image.fill(Qt::transparent); },
+        [&] {
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.translate(512, 512);
+            painter.scale(0.1, 0.1);
+            strategy.drawBatch(painter, scene.getSegments(), rows, {});
+        });
+}
+
+// Отрисовка кадра 1920 x 1080 со всей сценой: в одном потоке или по плиткам на всех ядрах.
+BenchmarkResult benchRenderFrame(const BenchmarkConfig& config, bool tiled)
+{
+    Scene scene;
+    std::mt19937 rng(42);
+    fillScene(scene, config.sceneSize, rng);
+
+    std::map<PrimitiveType, std::unique_ptr<Draw>> strategies;
+    strategies[PrimitiveType::Segment] = std::make_unique<SegmentDraw>();
+    const auto* segmentDraw = static_cast<const SegmentDraw*>(strategies[PrimitiveType::Segment].get());
+
+    QImage image(1920, 1080, QImage::Format_ARGB32_Premultiplied);
+    const QRect frame = image.rect();
+    QTransform worldToScreen;
+    worldToScreen.translate(960, 540);
+    worldToScreen.scale(0.1, -0.1);
+
+    TileRenderer renderer;
+    TileRenderer::View view;
+    view.worldToScreen = worldToScreen;
+
+    std::vector<Handle> handles;
+    std::vector<std::size_t> rows;
+    const QString name = tiled ? QString("TileRenderer::render (%1 threads)").arg(parallelThreadCount())
+                               : QString("Scene render (single thread)");
+    return measure(name, config.sceneSize, config.repeats,
+        [&] { image.fill(Qt::transparent); },
+        [&] {
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            if (tiled) {
+                renderer.render(painter, frame, scene, strategies, nullptr, view);
+                return;
+            }
+            handles.clear();
+            rows.clear();
+            scene.queryPrimitives(worldToScreen.inverted().mapRect(QRectF(frame)), handles);
+            for (const Handle& handle : handles) rows.push_back(scene.getSegmentRow(handle));
+            painter.setTransform(worldToScreen);
+            segmentDraw->drawBatch(painter, scene.getSegments(), rows, {});
+        });
+}
+
+// Сериализует результаты в JSON для отслеживания регрессий между версиями.
+QJsonDocument toJson(const std::vector<BenchmarkResult>& results, const BenchmarkConfig& config)
+{
+    QJsonArray benchmarks;
+    for (const auto& result : results) {
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["operations"] = result.operations;
+        entry["total_ms"] = result.totalMs;
+        entry["ns_per_op"] = result.nsPerOp;
+        benchmarks.append(entry);
+    }
+
+    QJsonObject root;
+    root["suite"] = "UniversityCAD";
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qt_version"] = qVersion();
+    root["scene_size"] = config.sceneSize;
+    root["repeats"] = config.repeats;
+    root["benchmarks"] = benchmarks;
+    return QJsonDocument(root);
+}
+
+} // namespace
+
+// Точка входа набора бенчмарков.
+int main(int argc, char *argv[])
+{
+    // Отрисовка в QImage не требует дисплея.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("UniversityCAD micro-benchmarks");
+    parser.addHelpOption();
+    QCommandLineOption jsonOption("json", "Write results to <file> as JSON.", "file", "bench_results.json");
+    QCommandLineOption sizeOption("size", "Number of segments in the test scene.", "count", "100000");
+    QCommandLineOption repeatsOption("repeats", "Repetitions per benchmark (best is reported).", "count", "5");
+    QCommandLineOption traceOption("trace", "Record a Chrome trace-event JSON of the run to <file>.", "file");
+    parser.addOptions({jsonOption, sizeOption, repeatsOption, traceOption});
+    parser.process(app);
+
+    BenchmarkConfig config;
+    config.sceneSize = std::max(1, parser.value(sizeOption).toInt());
+    config.repeats = std::max(1, parser.value(repeatsOption).toInt());
+
+    QTextStream out(stdout);
+    QTemporaryDir tempDir;
+    const QString scenePath = tempDir.filePath(QString("bench.%1").arg(SceneFile::extension()));
+    const QString dxfPath = tempDir.filePath(QString("bench.%1").arg(DxfFile::extension()));
+    if (!tempDir.isValid() || !verifySceneFileRoundTrip(config, scenePath, out) ||
+        !verifyDxfRoundTrip(config, dxfPath, out) || !verifyTransform(config, out) ||
+        !verifySnapIndex(config, out) || !verifyIntersections(config, out) ||
+        !verifyLayers(config, scenePath, out)) {
+        return 1;
+    }
+
+    Trace::setThreadName("main");
+    if (parser.isSet(traceOption)) Trace::start();
+
+    std::vector<BenchmarkResult> results;
+    results.push_back(benchAddPrimitive(config));
+    results.push_back(benchRemovePrimitive(config));
+    results.push_back(benchRemovePrimitives(config));
+    results.push_back(benchUndoRemovePrimitives(config));
+    results.push_back(benchTransformPrimitives(config, true));
+    results.push_back(benchTransformPrimitives(config, false));
+    results.push_back(benchLookup(config));
+    results.push_back(benchIterate(config));
+    results.push_back(benchQuery(config));
+    results.push_back(benchLayerQuery(config));
+    results.push_back(benchPick(config));
+    results.push_back(benchSnapBuild(config));
+    results.push_back(benchSnapQuery(config));
+    results.push_back(benchIntersections(config));
+    results.push_back(benchSelectInRect(config, SelectionMode::Window, "Scene::selectInRect (window)"));
+    results.push_back(benchSelectInRect(config, SelectionMode::Crossing, "Scene::selectInRect (crossing)"));
+    results.push_back(benchSceneSave(config, scenePath));
+    results.push_back(benchSceneLoad(config, scenePath));
+    results.push_back(benchSceneLoadAndQuery(config, scenePath));
+    results.push_back(benchDxfExport(config, dxfPath));
+    results.push_back(benchDxfImport(config, dxfPath));
+    results.push_back(benchSetPolar(config));
+    results.push_back(benchGetAngle(config));
+    results.push_back(benchSegmentDraw(config));
+    results.push_back(benchSegmentDrawBatch(config));
+    results.push_back(benchRenderFrame(config, false));
+    results.push_back(benchRenderFrame(config, true));
+
+    for (const auto& result : results) {
+        out << QString("%1 %2 ms  %3 ns/op  (%4 ops)\n")
+                   .arg(result.name, -28)
+                   .arg(result.totalMs, 10, 'f', 3)
+                   .arg(result.nsPerOp, 10, 'f', 1)
+                   .arg(result.operations);
+    }
+
+    if (parser.isSet(traceOption)) {
+        Trace::stop();
+        QString error;
+        if (!Trace::writeJson(parser.value(traceOption), &error)) {
+            out << error << "\n";
+            return 1;
+        }
+        out << "Trace written to " << parser.value(traceOption) << "\n";
+    }
+
+    QFile file(parser.value(jsonOption));
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        out << "Cannot write " << file.fileName() << "\n";
+        return 1;
+    }
+    file.write(toJson(results, config).toJson());
+    out << "Results written to " << file.fileName() << "\n";
+    return 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cmath>
+
+// Аффинное преобразование плоскости:
+//   x' = m11 * x + m12 * y + dx
+//   y' = m21 * x + m22 * y + dy
+// Углы задаются в радианах независимо от единиц, выбранных в интерфейсе (Point::getAngleUnit).
+struct Affine2D
+{
+    double m11 = 1.0, m12 = 0.0;
+    double m21 = 0.0, m22 = 1.0;
+    double dx = 0.0, dy = 0.0;
+
+    // Перенос на (tx, ty).
+    static Affine2D translation(double tx, double ty)
+    {
+        Affine2D m;
+        m.dx = tx;
+        m.dy = ty;
+        return m;
+    }
+
+    // Поворот на angle радиан (против часовой стрелки в осях сцены) вокруг точки (cx, cy).
+    static Affine2D rotation(double angle, double cx = 0.0, double cy = 0.0)
+    {
+        const double c = std::cos(angle);
+        const double s = std::sin(angle);
+        return about(c, -s, s, c, cx, cy);
+    }
+
+    // Масштабирование с коэффициентами (sx, sy) относительно точки (cx, cy).
+    static Affine2D scaling(double sx, double sy, double cx = 0.0, double cy = 0.0)
+    {
+        return about(sx, 0.0, 0.0, sy, cx, cy);
+    }
+
+    // Зеркальное отражение относительно прямой, проходящей через точки (ax, ay) и (bx, by).
+    // Для совпадающих точек возвращается тождественное преобразование.
+    static Affine2D mirror(double ax, double ay, double bx, double by)
+    {
+        const double length = std::hypot(bx - ax, by - ay);
+        if (length == 0.0) return Affine2D();
+
+        const double ux = (bx - ax) / length;
+        const double uy = (by - ay) / length;
+        const double a = ux * ux - uy * uy;
+        const double b = 2.0 * ux * uy;
+        return about(a, b, b, -a, ax, ay);
+    }
+
+    // Возвращает композицию: сначала other, затем this.
+    Affine2D operator*(const Affine2D& other) const
+    {
+        Affine2D m;
+        m.m11 = m11 * other.m11 + m12 * other.m21;
+        m.m12 = m11 * other.m12 + m12 * other.m22;
+        m.m21 = m21 * other.m11 + m22 * other.m21;
+        m.m22 = m21 * other.m12 + m22 * other.m22;
+        m.dx = m11 * other.dx + m12 * other.dy + dx;
+        m.dy = m21 * other.dx + m22 * other.dy + dy;
+        return m;
+    }
+
+    // Преобразует точку (x, y) на месте.
+    void map(double& x, double& y) const
+    {
+        const double nx = m11 * x + m12 * y + dx;
+        const double ny = m21 * x + m22 * y + dy;
+        x = nx;
+        y = ny;
+    }
+
+private:
+    // Линейная часть (a b; c d), применяемая относительно неподвижной точки (cx, cy).
+    static Affine2D about(double a, double b, double c, double d, double cx, double cy)
+    {
+        Affine2D m;
+        m.m11 = a;
+        m.m12 = b;
+        m.m21 = c;
+        m.m22 = d;
+        m.dx = cx - (a * cx + b * cy);
+        m.dy = cy - (c * cx + d * cy);
+        return m;
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+
+// Столбец хранилища: непрерывный массив значений, который либо принадлежит столбцу,
+// либо ссылается на внешнюю память (например, на отображенный в память файл) без копирования.
+// Внешняя память только читается; первое изменение столбца копирует данные в собственный
+// буфер (копирование при записи), поэтому чтение загруженного файла не требует разбора,
+// а страницы файла подгружаются системой по мере обращения к ним.
+// T должен быть тривиально копируемым типом.
+template <typename T>
+class Column
+{
+public:
+    // Создает пустой собственный столбец.
+    Column() = default;
+
+    // Создает столбец, ссылающийся на внешнюю память. owner удерживает память
+    // (например, отображение файла) на все время, пока на нее ссылается хоть один столбец.
+    static Column borrow(const T* data, std::size_t size, std::shared_ptr<const void> owner)
+    {
+        Column column;
+        column.m_data = data;
+        column.m_size = size;
+        column.m_owner = std::move(owner);
+        return column;
+    }
+
+    Column(const Column& other) : m_owned(other.m_owned), m_owner(other.m_owner)
+    {
+        if (m_owner) {
+            m_data = other.m_data;
+            m_size = other.m_size;
+        } else {
+            sync();
+        }
+    }
+
+    Column(Column&& other) noexcept
+        : m_owned(std::move(other.m_owned)), m_data(other.m_data), m_size(other.m_size), m_owner(std::move(other.m_owner))
+    {
+        other.m_owned.clear();
+        other.sync();
+    }
+
+    Column& operator=(Column other) noexcept
+    {
+        std::swap(m_owned, other.m_owned);
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_owner, other.m_owner);
+        return *this;
+    }
+
+    // Чтение (без ветвлений: указатель всегда актуален).
+    const T* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    const T& operator[](std::size_t i) const { return m_data[i]; }
+    const T& back() const { return m_data[m_size - 1]; }
+
+    // Возвращает true, если столбец ссылается на внешнюю память.
+    bool isBorrowed() const { return static_cast<bool>(m_owner); }
+
+    // Изменение значения (при необходимости данные сначала копируются в собственный буфер).
+    // Значение принимается копией: оно может ссылаться на внешнюю память, освобождаемую при копировании.
+    void set(std::size_t i, T value)
+    {
+        detach();
+        m_owned[i] = value;
+    }
+
+    // Возвращает изменяемый указатель на данные для массовой обработки.
+    T* mutableData()
+    {
+        detach();
+        return m_owned.data();
+    }
+
+    void push_back(T value)
+    {
+        detach();
+        m_owned.push_back(value);
+        sync();
+    }
+
+    void pop_back()
+    {
+        detach();
+        m_owned.pop_back();
+        sync();
+    }
+
+    void reserve(std::size_t count)
+    {
+        detach(count);
+        m_owned.reserve(count);
+        sync();
+    }
+
+    void clear()
+    {
+        m_owner.reset();
+        m_owned.clear();
+        sync();
+    }
+
+private:
+    // Копирует внешние данные в собственный буфер (не меньше capacity элементов).
+    void detach(std::size_t capacity = 0)
+    {
+        if (!m_owner) return;
+
+        std::vector<T> owned;
+        owned.reserve(std::max(capacity, m_size));
+        owned.assign(m_data, m_data + m_size);
+        m_owned = std::move(owned);
+        m_owner.reset();
+        sync();
+    }
+
+    // Обновляет указатель чтения после изменения собственного буфера.
+    void sync()
+    {
+        m_data = m_owned.data();
+        m_size = m_owned.size();
+    }
+
+    // Собственный буфер (пуст, пока столбец ссылается на внешнюю память).
+    std::vector<T> m_owned;
+
+    // Текущие данные для чтения.
+    const T* m_data = nullptr;
+    std::size_t m_size = 0;
+
+    // Владелец внешней памяти (nullptr для собственного столбца).
+    std::shared_ptr<const void> m_owner;
+};
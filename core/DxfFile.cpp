@@ -0,0 +1,611 @@
+#include "DxfFile.h"
+#include "Scene.h"
+#include "SegmentStore.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QByteArray>
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <future>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+
+// Размер блока, читаемого из файла за один раз.
+constexpr qint64 kChunkSize = 4 << 20;
+
+// Количество строк хранилища, форматируемых одним потоком за раз при экспорте.
+constexpr std::size_t kExportBlockRows = 16384;
+
+// Цвет по умолчанию (как у новых объектов сцены).
+constexpr QRgb kDefaultColor = 0xFFFFFFFFu;
+
+// Номер цвета ACI "по слою" (BYLAYER).
+constexpr int kAciByLayer = 256;
+
+// Флаг записи слоя DXF (код 70): слой заблокирован.
+constexpr long long kDxfLayerLocked = 4;
+
+// Блок файла, содержащий целое (четное) число строк, то есть целые пары "код - значение".
+struct Chunk
+{
+    QByteArray data;   // Строки блока; последняя строка заканчивается '\n'.
+    qint64 firstLine;  // Номер первой строки блока в файле (с нуля).
+};
+
+// Групповой код с разобранным значением.
+struct Token
+{
+    int code;
+    double number;    // Числовое значение (только для кодов, которые читает импорт).
+    const char* text; // Строковое значение внутри данных блока (завершается нулем).
+};
+
+// Вид значения группового кода.
+enum class ValueKind { Text, Real, Integer };
+
+// Возвращает вид значения для кодов, которые использует импорт. Остальные значения
+// не преобразуются, поэтому их содержимое не влияет на импорт.
+ValueKind valueKind(int code)
+{
+    switch (code) {
+    case 10: case 20: case 11: case 21: return ValueKind::Real;
+    case 62: case 70: case 90: case 420: return ValueKind::Integer;
+    default: return ValueKind::Text;
+    }
+}
+
+// Отрезает пробелы и '\r' с обеих сторон строки [begin, end) и завершает ее нулем.
+const char* trimLine(char* begin, char* end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) --end;
+    *end = '\0';
+    return begin;
+}
+
+// Разбирает целое число (без учета локали). Возвращает false, если строка не является числом.
+bool parseInteger(const char* text, long long& value)
+{
+    bool negative = false;
+    if (*text == '-' || *text == '+') negative = (*text++ == '-');
+    if (*text < '0' || *text > '9') return false;
+
+    value = 0;
+    while (*text >= '0' && *text <= '9') {
+        value = value * 10 + (*text++ - '0');
+    }
+    if (negative) value = -value;
+    return *text == '\0';
+}
+
+// Читает файл блоками, каждый из которых заканчивается на границе пары строк.
+class ChunkReader
+{
+public:
+    explicit ChunkReader(QFile& file) : m_file(file) {}
+
+    // Читает до count блоков в batch (пустой batch - файл закончился). При ошибке чтения возвращает false.
+    bool readBatch(std::size_t count, std::vector<Chunk>& batch)
+    {
+        batch.clear();
+        while (batch.size() < count && !(m_atEnd && m_carry.isEmpty())) {
+            Chunk chunk;
+            if (!readChunk(chunk)) return false;
+            if (!chunk.data.isEmpty()) batch.push_back(std::move(chunk));
+        }
+        return true;
+    }
+
+private:
+    // Дочитывает данные к остатку предыдущего блока и отрезает по последней паре строк.
+    bool readChunk(Chunk& chunk)
+    {
+        QByteArray buffer = std::move(m_carry);
+        m_carry = QByteArray();
+
+        for (;;) {
+            if (!m_atEnd) {
+                const qint64 old = buffer.size();
+                buffer.resize(old + kChunkSize);
+                const qint64 read = m_file.read(buffer.data() + old, kChunkSize);
+                if (read < 0) return false;
+                buffer.resize(old + read);
+                m_atEnd = (read == 0) || m_file.atEnd();
+            }
+
+            if (m_atEnd) {
+                // Последний блок забирает все; последняя строка может быть без перевода строки.
+                if (!buffer.isEmpty() && !buffer.endsWith('\n')) buffer.append('\n');
+                chunk.data = std::move(buffer);
+                chunk.firstLine = m_nextLine;
+                m_nextLine += chunk.data.count('\n');
+                return true;
+            }
+
+            // Считаем строки и запоминаем концы двух последних, чтобы резать по четной строке.
+            const char* data = buffer.constData();
+            const char* end = data + buffer.size();
+            const char* last = nullptr;
+            const char* previous = nullptr;
+            qint64 lines = 0;
+            for (const char* p = data; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))); ++p) {
+                previous = last;
+                last = p;
+                ++lines;
+            }
+
+            const char* cut = (lines % 2 == 0) ? last : previous;
+            if (cut) {
+                const qint64 size = cut + 1 - data;
+                chunk.data = buffer.left(size);
+                chunk.firstLine = m_nextLine;
+                m_nextLine += (lines % 2 == 0) ? lines : lines - 1;
+                m_carry = buffer.mid(size);
+                return true;
+            }
+            // Пара строк длиннее блока - дочитываем еще.
+        }
+    }
+
+    QFile& m_file;
+    QByteArray m_carry;
+    qint64 m_nextLine = 0;
+    bool m_atEnd = false;
+};
+
+// Разбирает пары строк блока в групповые коды. Блок изменяется на месте (строки завершаются нулем),
+// и значения токенов ссылаются на него. При ошибке возвращает номер строки в errorLine.
+bool tokenize(Chunk& chunk, std::vector<Token>& tokens, qint64& errorLine)
+{
+    tokens.clear();
+    char* p = chunk.data.data();
+    char* end = p + chunk.data.size();
+    qint64 line = chunk.firstLine;
+
+    while (p < end) {
+        char* codeEnd = static_cast<char*>(std::memchr(p, '\n', end - p));
+        long long code;
+        if (!parseInteger(trimLine(p, codeEnd), code)) {
+            errorLine = line;
+            return false;
+        }
+        p = codeEnd + 1;
+
+        if (p >= end) {
+            errorLine = line;
+            return false;
+        }
+        char* valueEnd = static_cast<char*>(std::memchr(p, '\n', end - p));
+        const char* text = trimLine(p, valueEnd);
+        p = valueEnd + 1;
+
+        Token token{static_cast<int>(code), 0.0, text};
+        bool ok = true;
+        switch (valueKind(token.code)) {
+        case ValueKind::Real:
+            // QByteArray::toDouble не зависит от локали (в отличие от strtod).
+            token.number = QByteArray::fromRawData(text, static_cast<int>(std::strlen(text))).toDouble(&ok);
+            break;
+        case ValueKind::Integer: {
+            long long value = 0;
+            ok = parseInteger(text, value);
+            token.number = static_cast<double>(value);
+            break;
+        }
+        case ValueKind::Text:
+            break;
+        }
+        if (!ok) {
+            errorLine = line + 1;
+            return false;
+        }
+
+        tokens.push_back(token);
+        line += 2;
+    }
+    return true;
+}
+
+// Возвращает цвет по номеру из стандартной палитры ACI (неизвестные номера - цвет по умолчанию).
+QRgb aciColor(int index)
+{
+    switch (index) {
+    case 1: return 0xFFFF0000u;
+    case 2: return 0xFFFFFF00u;
+    case 3: return 0xFF00FF00u;
+    case 4: return 0xFF00FFFFu;
+    case 5: return 0xFF0000FFu;
+    case 6: return 0xFFFF00FFu;
+    case 8: return 0xFF808080u;
+    case 9: return 0xFFC0C0C0u;
+    default: return kDefaultColor;
+    }
+}
+
+// Последовательно собирает сущности из групповых кодов. Состояние сохраняется между
+// блоками, поэтому сущность может начинаться в одном блоке и заканчиваться в другом.
+// Слои из таблицы LAYER и из кодов 8 сущностей создаются на сцене сразу (сборка идет
+// в главном потоке), а отрезки получают номера слоев сцены.
+class EntityAssembler
+{
+public:
+    explicit EntityAssembler(Scene& scene) : m_scene(scene) {}
+
+    // Обрабатывает групповые коды очередного блока.
+    void feed(const std::vector<Token>& tokens)
+    {
+        for (const Token& token : tokens) {
+            if (token.code == 0) {
+                finishEntity();
+                startEntity(token.text);
+            } else if (token.code == 2 && m_expectSectionName) {
+                m_inEntities = std::strcmp(token.text, "ENTITIES") == 0;
+                m_inTables = std::strcmp(token.text, "TABLES") == 0;
+                m_expectSectionName = false;
+            } else if (m_entity != EntityType::None) {
+                readEntityValue(token);
+            }
+        }
+    }
+
+    // Завершает последнюю сущность файла.
+    void finish() { finishEntity(); }
+
+    // Собранные отрезки (вызывающий очищает их после добавления на сцену).
+    std::vector<SegmentRecord>& records() { return m_records; }
+
+private:
+    enum class EntityType { None, Line, LwPolyline, LayerEntry };
+
+    // Начинает новую сущность или секцию по значению кода 0.
+    void startEntity(const char* name)
+    {
+        m_entity = EntityType::None;
+        if (std::strcmp(name, "SECTION") == 0) {
+            m_expectSectionName = true;
+        } else if (std::strcmp(name, "ENDSEC") == 0) {
+            m_inEntities = false;
+            m_inTables = false;
+        } else if (m_inEntities) {
+            if (std::strcmp(name, "LINE") == 0) m_entity = EntityType::Line;
+            else if (std::strcmp(name, "LWPOLYLINE") == 0) m_entity = EntityType::LwPolyline;
+        } else if (m_inTables && std::strcmp(name, "LAYER") == 0) {
+            m_entity = EntityType::LayerEntry;
+        }
+
+        m_line = SegmentRecord{0.0, 0.0, 0.0, 0.0, kDefaultColor};
+        m_colorSet = false;
+        m_trueColor = false;
+        m_closed = false;
+        m_flags = 0;
+        m_hidden = false;
+        m_name.clear();
+        m_vertices.clear();
+    }
+
+    // Запоминает значение группового кода текущей сущности.
+    void readEntityValue(const Token& token)
+    {
+        switch (token.code) {
+        case 2:
+            if (m_entity == EntityType::LayerEntry) m_name = token.text;
+            break;
+        case 8:
+            if (m_entity != EntityType::LayerEntry) m_line.layer = layerIndex(token.text);
+            break;
+        case 62: {
+            // Отрицательный номер цвета в записи слоя означает, что слой выключен.
+            int index = static_cast<int>(token.number);
+            if (index < 0) {
+                m_hidden = true;
+                index = -index;
+            }
+            if (!m_trueColor && index != kAciByLayer) {
+                m_line.color = aciColor(index);
+                m_colorSet = true;
+            }
+            break;
+        }
+        case 420:
+            m_line.color = 0xFF000000u | (static_cast<QRgb>(token.number) & 0x00FFFFFFu);
+            m_colorSet = true;
+            m_trueColor = true;
+            break;
+        case 70:
+            m_flags = static_cast<long long>(token.number);
+            m_closed = (m_flags & 1) != 0;
+            break;
+        case 10:
+            if (m_entity == EntityType::Line) {
+                m_line.x0 = token.number;
+            } else {
+                // Код 10 начинает новую вершину полилинии, код 20 задает ее ординату.
+                m_vertices.push_back(token.number);
+                m_vertices.push_back(0.0);
+            }
+            break;
+        case 20:
+            if (m_entity == EntityType::Line) m_line.y0 = token.number;
+            else if (!m_vertices.empty()) m_vertices.back() = token.number;
+            break;
+        case 11:
+            if (m_entity == EntityType::Line) m_line.x1 = token.number;
+            break;
+        case 21:
+            if (m_entity == EntityType::Line) m_line.y1 = token.number;
+            break;
+        }
+    }
+
+    // Превращает завершенную сущность в отрезки.
+    void finishEntity()
+    {
+        // Сущности без собственного цвета (BYLAYER) получают цвет своего слоя.
+        if (!m_colorSet && (m_entity == EntityType::Line || m_entity == EntityType::LwPolyline)) {
+            m_line.color = m_scene.getLayer(m_line.layer).color.rgba();
+        }
+
+        if (m_entity == EntityType::LayerEntry) {
+            finishLayer();
+        } else if (m_entity == EntityType::Line) {
+            m_records.push_back(m_line);
+        } else if (m_entity == EntityType::LwPolyline) {
+            // Дуговые участки (код 42) заменяются хордами.
+            const std::size_t count = m_vertices.size() / 2;
+            for (std::size_t i = 0; i + 1 < count; ++i) {
+                addEdge(i, i + 1);
+            }
+            if (m_closed && count > 2) {
+                addEdge(count - 1, 0);
+            }
+        }
+        m_entity = EntityType::None;
+    }
+
+    // Добавляет отрезок полилинии между вершинами a и b.
+    void addEdge(std::size_t a, std::size_t b)
+    {
+        m_records.push_back(SegmentRecord{m_vertices[2 * a], m_vertices[2 * a + 1],
+                                          m_vertices[2 * b], m_vertices[2 * b + 1], m_line.color, 0, m_line.layer});
+    }
+
+    // Создает слой сцены по записи таблицы LAYER или обновляет одноименный существующий.
+    void finishLayer()
+    {
+        if (m_name.empty()) return;
+
+        Layer layer;
+        layer.name = QString::fromStdString(m_name);
+        layer.color = QColor::fromRgba(m_colorSet ? m_line.color : kDefaultColor);
+        layer.visible = !m_hidden;
+        layer.locked = (m_flags & kDxfLayerLocked) != 0;
+
+        const std::uint32_t index = m_scene.findLayer(layer.name);
+        if (index == Layer::npos) {
+            m_layerByName[m_name] = m_scene.addLayer(layer);
+        } else {
+            m_scene.setLayer(index, layer);
+            m_layerByName[m_name] = index;
+        }
+    }
+
+    // Возвращает номер слоя сцены по имени из кода 8, создавая слой при первом упоминании.
+    std::uint32_t layerIndex(const char* name)
+    {
+        const auto found = m_layerByName.find(name);
+        if (found != m_layerByName.end()) return found->second;
+
+        const QString layerName = QString::fromUtf8(name);
+        std::uint32_t index = m_scene.findLayer(layerName);
+        if (index == Layer::npos) {
+            Layer layer;
+            layer.name = layerName;
+            index = m_scene.addLayer(layer);
+        }
+        m_layerByName.emplace(name, index);
+        return index;
+    }
+
+    Scene& m_scene;
+    std::vector<SegmentRecord> m_records;
+
+    // Номера слоев сцены по именам, уже встреченным в файле.
+    std::unordered_map<std::string, std::uint32_t> m_layerByName;
+
+    bool m_expectSectionName = false;
+    bool m_inEntities = false;
+    bool m_inTables = false;
+    EntityType m_entity = EntityType::None;
+
+    // Данные текущей сущности или записи слоя.
+    SegmentRecord m_line{0.0, 0.0, 0.0, 0.0, kDefaultColor};
+    bool m_colorSet = false;
+    bool m_trueColor = false;
+    bool m_closed = false;
+    bool m_hidden = false;
+    long long m_flags = 0;
+    std::string m_name;
+    std::vector<double> m_vertices; // Пары x, y вершин полилинии.
+};
+
+// Дописывает в buffer пару "групповой код - число".
+void appendNumber(QByteArray& buffer, const char* code, double value)
+{
+    buffer.append(code);
+    buffer.append(QByteArray::number(value, 'g', 17));
+    buffer.append('\n');
+}
+
+// Форматирует таблицу слоев сцены (секция TABLES).
+QByteArray formatLayerTable(const Scene& scene)
+{
+    QByteArray buffer("  0\nSECTION\n  2\nTABLES\n  0\nTABLE\n  2\nLAYER\n 70\n");
+    buffer.append(QByteArray::number(static_cast<qulonglong>(scene.getLayerCount())));
+    buffer.append('\n');
+    for (std::uint32_t i = 0; i < scene.getLayerCount(); ++i) {
+        const Layer& layer = scene.getLayer(i);
+        buffer.append("  0\nLAYER\n  2\n");
+        buffer.append(layer.name.toUtf8());
+        buffer.append("\n 70\n");
+        buffer.append(layer.locked ? "4" : "0");
+        // Номер цвета ACI 7 (белый) с истинным цветом в коде 420; знак минус выключает слой.
+        buffer.append(layer.visible ? "\n 62\n7\n" : "\n 62\n-7\n");
+        buffer.append("420\n");
+        buffer.append(QByteArray::number(layer.color.rgb() & 0x00FFFFFFu));
+        buffer.append('\n');
+    }
+    buffer.append("  0\nENDTAB\n  0\nENDSEC\n");
+    return buffer;
+}
+
+// Форматирует строки хранилища [begin, end) как сущности LINE (layerNames - имена слоев сцены).
+void formatLines(const SegmentStore& segments, const std::vector<QByteArray>& layerNames,
+                 std::size_t begin, std::size_t end, QByteArray& buffer)
+{
+    buffer.clear();
+    for (std::size_t row = begin; row < end; ++row) {
+        buffer.append("  0\nLINE\n  8\n");
+        buffer.append(layerNames[segments.getLayer(row)]);
+        buffer.append('\n');
+        appendNumber(buffer, " 10\n", segments.getX0(row));
+        appendNumber(buffer, " 20\n", segments.getY0(row));
+        buffer.append(" 30\n0.0\n");
+        appendNumber(buffer, " 11\n", segments.getX1(row));
+        appendNumber(buffer, " 21\n", segments.getY1(row));
+        buffer.append(" 31\n0.0\n");
+        buffer.append("420\n");
+        buffer.append(QByteArray::number(segments.getColor(row).rgb() & 0x00FFFFFFu));
+        buffer.append('\n');
+    }
+}
+
+// Записывает описание ошибки, если оно запрошено.
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+} // namespace
+
+// Возвращает расширение файлов DXF.
+const char* DxfFile::extension()
+{
+    return "dxf";
+}
+
+// Потоково импортирует отрезки из файла DXF.
+bool DxfFile::importFrom(Scene& scene, const QString& path, QString* error)
+{
+    UCAD_TRACE_SCOPE("DxfFile::importFrom");
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(error, QString("Не удалось открыть файл: %1").arg(file.errorString()));
+    }
+
+    // Весь импорт - одна транзакция: один шаг отмены и одно уведомление слушателей.
+    Scene::Transaction transaction(scene);
+
+    // Каждый поток разбирает свой блок; пока они работают, следующая партия блоков читается с диска.
+    const std::size_t batchSize = parallelThreadCount();
+    ChunkReader reader(file);
+    EntityAssembler assembler(scene);
+    std::vector<std::vector<Token>> tokens(batchSize);
+    std::vector<qint64> errorLines(batchSize);
+
+    std::vector<Chunk> batch;
+    if (!reader.readBatch(batchSize, batch)) {
+        return fail(error, QString("Ошибка чтения файла: %1").arg(file.errorString()));
+    }
+
+    while (!batch.empty()) {
+        std::vector<Chunk> nextBatch;
+        std::future<bool> nextRead = std::async(std::launch::async, [&reader, &nextBatch, batchSize] {
+            return reader.readBatch(batchSize, nextBatch);
+        });
+
+        std::vector<unsigned char> parsed(batch.size(), 0);
+        parallelFor(batch.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                parsed[i] = tokenize(batch[i], tokens[i], errorLines[i]) ? 1 : 0;
+            }
+        });
+
+        // Сущности собираются по порядку блоков и добавляются на сцену одним пакетом на партию.
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            if (!parsed[i]) {
+                nextRead.wait();
+                scene.addSegments(assembler.records());
+                return fail(error, QString("Некорректный групповой код DXF в строке %1.").arg(errorLines[i] + 1));
+            }
+            assembler.feed(tokens[i]);
+        }
+        scene.addSegments(assembler.records());
+        assembler.records().clear();
+
+        if (!nextRead.get()) {
+            return fail(error, QString("Ошибка чтения файла: %1").arg(file.errorString()));
+        }
+        batch = std::move(nextBatch);
+    }
+
+    assembler.finish();
+    scene.addSegments(assembler.records());
+    return true;
+}
+
+// Экспортирует отрезки сцены в файл DXF.
+bool DxfFile::exportTo(const Scene& scene, const QString& path, QString* error)
+{
+    UCAD_TRACE_SCOPE("DxfFile::exportTo");
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(error, QString("Не удалось открыть файл для записи: %1").arg(file.errorString()));
+    }
+
+    const SegmentStore& segments = scene.getSegments();
+    std::vector<QByteArray> layerNames;
+    layerNames.reserve(scene.getLayerCount());
+    for (std::uint32_t i = 0; i < scene.getLayerCount(); ++i) {
+        layerNames.push_back(scene.getLayer(i).name.toUtf8());
+    }
+
+    bool ok = file.write(formatLayerTable(scene)) >= 0 && file.write("  0\nSECTION\n  2\nENTITIES\n") >= 0;
+
+    // Партия из нескольких блоков форматируется параллельно и записывается по порядку,
+    // поэтому в памяти одновременно находится лишь несколько блоков текста.
+    const std::size_t threads = parallelThreadCount();
+    std::vector<QByteArray> buffers(threads);
+    for (std::size_t first = 0; ok && first < segments.size(); first += threads * kExportBlockRows) {
+        const std::size_t blocks = std::min(threads, (segments.size() - first + kExportBlockRows - 1) / kExportBlockRows);
+        parallelFor(blocks, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t block = begin; block < end; ++block) {
+                const std::size_t rowBegin = first + block * kExportBlockRows;
+                const std::size_t rowEnd = std::min(segments.size(), rowBegin + kExportBlockRows);
+                formatLines(segments, layerNames, rowBegin, rowEnd, buffers[block]);
+            }
+        });
+        for (std::size_t block = 0; ok && block < blocks; ++block) {
+            ok = file.write(buffers[block]) == buffers[block].size();
+        }
+    }
+
+    ok = ok && file.write("  0\nENDSEC\n  0\nEOF\n") >= 0;
+    if (!ok) {
+        file.cancelWriting();
+        return fail(error, QString("Ошибка записи файла: %1").arg(file.errorString()));
+    }
+    if (!file.commit()) {
+        return fail(error, QString("Не удалось сохранить файл: %1").arg(file.errorString()));
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QString>
+
+class Scene;
+
+// Импорт и экспорт чертежей в формате DXF (обмен с другими САПР).
+// Поддерживаются сущности LINE и LWPOLYLINE (полилиния раскладывается на отрезки)
+// из секции ENTITIES; цвет берется из кода 420 (True Color) или 62 (номер цвета ACI),
+// а при их отсутствии (BYLAYER) - из слоя. Слои читаются из таблицы LAYER секции TABLES
+// (цвет, выключение, блокировка) и из кода 8 сущностей; экспорт записывает обе.
+// Файл читается потоково блоками: пока очередные блоки читаются с диска, групповые коды
+// предыдущих разбираются параллельно на рабочих потоках, а распознанные отрезки добавляются
+// на сцену пакетами через Scene::addSegments. Память ограничена несколькими блоками
+// независимо от размера файла.
+class DxfFile
+{
+public:
+    // Расширение файлов DXF (без точки).
+    static const char* extension();
+
+    // Добавляет на сцену отрезки из файла DXF одной транзакцией (один шаг отмены и одно
+    // уведомление). При ошибке возвращает false и описание ошибки в error; отрезки, прочитанные
+    // до ошибки, остаются на сцене. Журнал отмены хранит только отрезки, поэтому слои,
+    // созданные импортом, остаются на сцене и после его отмены.
+    static bool importFrom(Scene& scene, const QString& path, QString* error = nullptr);
+
+    // Записывает отрезки сцены в файл DXF как сущности LINE. Данные читаются прямо
+    // из столбцов хранилища и форматируются блоками строк на нескольких потоках.
+    static bool exportTo(const Scene& scene, const QString& path, QString* error = nullptr);
+};
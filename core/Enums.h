@@ -18,3 +18,26 @@ enum class AngleUnit {
     Degrees, // Градусы
     Radians  // Радианы
 };
+
+// Режимы выделения рамкой.
+enum class SelectionMode {
+    Window,  // Рамка слева направо: только объекты, целиком лежащие внутри
+    Crossing // Рамка справа налево: все объекты, касающиеся рамки
+};
+
+// Виды точек привязки курсора.
+enum class SnapKind {
+    None,         // Привязки нет
+    Endpoint,     // Конец отрезка
+    Midpoint,     // Середина отрезка
+    Intersection, // Пересечение отрезков
+    Nearest,      // Ближайшая точка отрезка
+    Grid          // Узел координатной сетки
+};
+
+// Виды пересечений отрезков.
+enum class IntersectionKind {
+    Crossing, // Отрезки пересекаются во внутренней точке обоих
+    Touch,    // Конец одного отрезка лежит на другом (T-образное примыкание)
+    Overlap   // Отрезки лежат на одной прямой и имеют общий участок
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+
+// Вспомогательные геометрические функции ядра.
+
+// Возвращает квадрат расстояния от точки (px, py) до отрезка (x0, y0)-(x1, y1).
+// Квадрат используется, чтобы при сравнении расстояний не вычислять корень.
+inline double distanceToSegmentSquared(double px, double py, double x0, double y0, double x1, double y1)
+{
+    const double dx = x1 - x0;
+    const double dy = y1 - y0;
+    const double lengthSquared = dx * dx + dy * dy;
+
+    // Параметр проекции точки на прямую отрезка, ограниченный концами отрезка.
+    double t = 0.0;
+    if (lengthSquared > 0.0) {
+        t = std::clamp(((px - x0) * dx + (py - y0) * dy) / lengthSquared, 0.0, 1.0);
+    }
+
+    const double cx = x0 + t * dx - px;
+    const double cy = y0 + t * dy - py;
+    return cx * cx + cy * cy;
+}
+
+// Возвращает квадрат расстояния от точки (px, py) до прямоугольника (0 для точки внутри).
+inline double distanceToRectSquared(double px, double py, double left, double top, double right, double bottom)
+{
+    const double cx = std::max({left - px, 0.0, px - right});
+    const double cy = std::max({top - py, 0.0, py - bottom});
+    return cx * cx + cy * cy;
+}
+
+// Проверяет, пересекает ли отрезок (x0, y0)-(x1, y1) прямоугольник или лежит в нем (границы включаются).
+inline bool segmentIntersectsRect(double x0, double y0, double x1, double y1,
+                                  double left, double top, double right, double bottom)
+{
+    // Отсечение по ограничивающим прямоугольникам.
+    if (std::max(x0, x1) < left || std::min(x0, x1) > right ||
+        std::max(y0, y1) < top || std::min(y0, y1) > bottom) {
+        return false;
+    }
+
+    // Конец внутри прямоугольника - пересечение есть.
+    if ((x0 >= left && x0 <= right && y0 >= top && y0 <= bottom) ||
+        (x1 >= left && x1 <= right && y1 >= top && y1 <= bottom)) {
+        return true;
+    }
+
+    // Иначе прямая отрезка должна разделять углы прямоугольника (или проходить через угол).
+    const double dx = x1 - x0;
+    const double dy = y1 - y0;
+    const double c0 = dx * (top - y0) - dy * (left - x0);
+    const double c1 = dx * (top - y0) - dy * (right - x0);
+    const double c2 = dx * (bottom - y0) - dy * (left - x0);
+    const double c3 = dx * (bottom - y0) - dy * (right - x0);
+    const bool allPositive = c0 > 0.0 && c1 > 0.0 && c2 > 0.0 && c3 > 0.0;
+    const bool allNegative = c0 < 0.0 && c1 < 0.0 && c2 < 0.0 && c3 < 0.0;
+    return !allPositive && !allNegative;
+}
+
+// Находит точку пересечения отрезков (ax0, ay0)-(ax1, ay1) и (bx0, by0)-(bx1, by1)
+// (касание концом считается пересечением). Параллельные и совпадающие отрезки
+// не пересекаются. Возвращает true и точку в (x, y), если пересечение есть.
+inline bool intersectSegments(double ax0, double ay0, double ax1, double ay1,
+                              double bx0, double by0, double bx1, double by1, double& x, double& y)
+{
+    const double rx = ax1 - ax0;
+    const double ry = ay1 - ay0;
+    const double sx = bx1 - bx0;
+    const double sy = by1 - by0;
+    const double denominator = rx * sy - ry * sx;
+    if (denominator == 0.0) return false;
+
+    // Параметры точки пересечения прямых вдоль каждого из отрезков.
+    const double qx = bx0 - ax0;
+    const double qy = by0 - ay0;
+    const double t = (qx * sy - qy * sx) / denominator;
+    const double u = (qx * ry - qy * rx) / denominator;
+    if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) return false;
+
+    x = ax0 + t * rx;
+    y = ay0 + t * ry;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+// Поколенческий дескриптор примитива сцены.
+// index - номер ячейки в таблице дескрипторов сцены, generation - поколение ячейки.
+// При удалении примитива поколение ячейки увеличивается, поэтому все ранее выданные
+// дескрипторы этой ячейки становятся недействительными и безопасно распознаются как устаревшие.
+struct Handle
+{
+    // Значение индекса, обозначающее пустой дескриптор.
+    static constexpr std::uint32_t kInvalidIndex = 0xFFFFFFFFu;
+
+    std::uint32_t index = kInvalidIndex;
+    std::uint32_t generation = 0;
+
+    // Возвращает true, если дескриптор не пустой (но не гарантирует, что он не устарел).
+    bool isValid() const { return index != kInvalidIndex; }
+
+    // Упаковывает дескриптор в 64-битное число (например, для хранения в QVariant).
+    std::uint64_t toKey() const { return (static_cast<std::uint64_t>(generation) << 32) | index; }
+
+    // Восстанавливает дескриптор из 64-битного числа.
+    static Handle fromKey(std::uint64_t key)
+    {
+        return Handle{static_cast<std::uint32_t>(key & 0xFFFFFFFFu), static_cast<std::uint32_t>(key >> 32)};
+    }
+
+    bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// Хеш-функция для использования Handle в качестве ключа unordered-контейнеров.
+namespace std {
+template <>
+struct hash<Handle>
+{
+    std::size_t operator()(const Handle& handle) const noexcept
+    {
+        return std::hash<std::uint64_t>()(handle.toKey());
+    }
+};
+} // namespace std
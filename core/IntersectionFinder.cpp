@@ -0,0 +1,222 @@
+#include "IntersectionFinder.h"
+#include "SegmentStore.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+// Среднее число отрезков на полосу, по которому выбирается количество полос.
+constexpr std::size_t kSegmentsPerStrip = 2048;
+
+// Наибольшее количество полос.
+constexpr std::size_t kMaxStrips = 4096;
+
+// Отрезок в полосе: охватывающий прямоугольник и строка хранилища.
+struct Item
+{
+    double left, right, bottom, top;
+    std::uint32_t row;
+};
+
+// Векторное произведение (b - a) x (c - a): знак показывает, с какой стороны прямой ab лежит c.
+double cross(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+// Возвращает true, если знаки значений строго совпадают (обе точки по одну сторону прямой).
+bool sameSide(double a, double b)
+{
+    return (a > 0.0 && b > 0.0) || (a < 0.0 && b < 0.0);
+}
+
+// Разбиение диапазона X на полосы одинаковой ширины.
+struct Strips
+{
+    double left = 0.0;
+    double width = 1.0;
+    std::size_t count = 1;
+
+    // Возвращает номер полосы, содержащей x.
+    std::size_t indexOf(double x) const
+    {
+        const double position = std::floor((x - left) / width);
+        if (!(position > 0.0)) return 0;
+        return std::min(count - 1, static_cast<std::size_t>(position));
+    }
+};
+
+} // namespace
+
+// Находит все пересечения отрезков параллельным заметанием по полосам.
+std::vector<SegmentIntersection> IntersectionFinder::find(const SegmentStore& segments)
+{
+    UCAD_TRACE_SCOPE("IntersectionFinder::find");
+    std::vector<SegmentIntersection> result;
+    const std::size_t count = segments.size();
+    if (count < 2) return result;
+
+    // Охват по X и разбиение на полосы.
+    Strips strips;
+    double minX = std::numeric_limits<double>::max();
+    double maxX = std::numeric_limits<double>::lowest();
+    for (std::size_t row = 0; row < count; ++row) {
+        minX = std::min({minX, segments.getX0(row), segments.getX1(row)});
+        maxX = std::max({maxX, segments.getX0(row), segments.getX1(row)});
+    }
+    strips.left = minX;
+    strips.count = std::clamp<std::size_t>(count / kSegmentsPerStrip, parallelThreadCount(), kMaxStrips);
+    strips.width = (maxX - minX) / strips.count;
+    if (!(strips.width > 0.0) || !std::isfinite(strips.width)) {
+        strips.count = 1;
+        strips.width = 1.0;
+    }
+
+    // Раскладка отрезков по полосам (подсчет, затем заполнение непрерывного массива).
+    std::vector<std::size_t> offsets(strips.count + 1, 0);
+    for (std::size_t row = 0; row < count; ++row) {
+        const std::size_t first = strips.indexOf(std::min(segments.getX0(row), segments.getX1(row)));
+        const std::size_t last = strips.indexOf(std::max(segments.getX0(row), segments.getX1(row)));
+        for (std::size_t strip = first; strip <= last; ++strip) ++offsets[strip + 1];
+    }
+    for (std::size_t strip = 0; strip < strips.count; ++strip) offsets[strip + 1] += offsets[strip];
+
+    std::vector<Item> items(offsets.back());
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t row = 0; row < count; ++row) {
+        const double x0 = segments.getX0(row);
+        const double y0 = segments.getY0(row);
+        const double x1 = segments.getX1(row);
+        const double y1 = segments.getY1(row);
+        const Item item{std::min(x0, x1), std::max(x0, x1), std::min(y0, y1), std::max(y0, y1),
+                        static_cast<std::uint32_t>(row)};
+        const std::size_t first = strips.indexOf(item.left);
+        const std::size_t last = strips.indexOf(item.right);
+        for (std::size_t strip = first; strip <= last; ++strip) items[fill[strip]++] = item;
+    }
+
+    // Полосы разной загруженности раздаются потокам по одной через общий счетчик.
+    std::vector<std::vector<SegmentIntersection>> found(strips.count);
+    std::atomic<std::size_t> nextStrip{0};
+    parallelFor(std::min<std::size_t>(parallelThreadCount(), strips.count), 1, [&](std::size_t, std::size_t) {
+        std::vector<Item> active;
+        for (std::size_t strip = nextStrip++; strip < strips.count; strip = nextStrip++) {
+            UCAD_TRACE_SCOPE("IntersectionFinder::sweepStrip");
+            const auto begin = items.begin() + offsets[strip];
+            const auto end = items.begin() + offsets[strip + 1];
+            std::sort(begin, end, [](const Item& a, const Item& b) { return a.left < b.left; });
+
+            // Заметание слева направо: активны отрезки, еще не закончившиеся левее текущего.
+            active.clear();
+            for (auto it = begin; it != end; ++it) {
+                const Item& item = *it;
+                std::size_t kept = 0;
+                for (std::size_t i = 0; i < active.size(); ++i) {
+                    const Item& other = active[i];
+                    if (other.right < item.left) continue;
+                    active[kept++] = other;
+                    if (other.top < item.bottom || other.bottom > item.top) continue;
+
+                    SegmentIntersection intersection;
+                    if (!intersect(segments, other.row, item.row, intersection)) continue;
+
+                    // Пару сообщает только полоса, в которую попадает точка (общий X обоих отрезков).
+                    const double x = std::clamp(intersection.point.x(), std::max(item.left, other.left),
+                                                std::min(item.right, other.right));
+                    if (strips.indexOf(x) == strip) found[strip].push_back(intersection);
+                }
+                active.resize(kept);
+                active.push_back(item);
+            }
+        }
+    });
+
+    std::size_t total = 0;
+    for (const auto& strip : found) total += strip.size();
+    result.reserve(total);
+    for (const auto& strip : found) result.insert(result.end(), strip.begin(), strip.end());
+
+    std::sort(result.begin(), result.end(), [](const SegmentIntersection& a, const SegmentIntersection& b) {
+        if (a.point.x() != b.point.x()) return a.point.x() < b.point.x();
+        if (a.point.y() != b.point.y()) return a.point.y() < b.point.y();
+        if (a.firstId != b.firstId) return a.firstId < b.firstId;
+        return a.secondId < b.secondId;
+    });
+    return result;
+}
+
+// Проверяет пару отрезков и определяет вид пересечения.
+bool IntersectionFinder::intersect(const SegmentStore& segments, std::size_t a, std::size_t b,
+                                   SegmentIntersection& result)
+{
+    const double px0 = segments.getX0(a), py0 = segments.getY0(a);
+    const double px1 = segments.getX1(a), py1 = segments.getY1(a);
+    const double qx0 = segments.getX0(b), qy0 = segments.getY0(b);
+    const double qx1 = segments.getX1(b), qy1 = segments.getY1(b);
+    if ((px0 == px1 && py0 == py1) || (qx0 == qx1 && qy0 == qy1)) return false;
+
+    // Положение концов каждого отрезка относительно прямой другого.
+    const double d1 = cross(px0, py0, px1, py1, qx0, qy0);
+    const double d2 = cross(px0, py0, px1, py1, qx1, qy1);
+    const double d3 = cross(qx0, qy0, qx1, qy1, px0, py0);
+    const double d4 = cross(qx0, qy0, qx1, qy1, px1, py1);
+
+    const unsigned idA = segments.getID(a);
+    const unsigned idB = segments.getID(b);
+    result.firstId = std::min(idA, idB);
+    result.secondId = std::max(idA, idB);
+
+    if (d1 == 0.0 && d2 == 0.0) {
+        // Отрезки на одной прямой: общий участок ищется в проекции на преобладающую ось.
+        const bool alongX = std::abs(px1 - px0) >= std::abs(py1 - py0);
+        const QPointF points[] = {{px0, py0}, {px1, py1}, {qx0, qy0}, {qx1, qy1}};
+        auto coordinate = [alongX](const QPointF& point) { return alongX ? point.x() : point.y(); };
+        const double low = std::max(std::min(coordinate(points[0]), coordinate(points[1])),
+                                    std::min(coordinate(points[2]), coordinate(points[3])));
+        const double high = std::min(std::max(coordinate(points[0]), coordinate(points[1])),
+                                     std::max(coordinate(points[2]), coordinate(points[3])));
+
+        // Касание в одной точке на общей прямой - это общий конец.
+        if (!(low < high)) return false;
+
+        // Концы общего участка - концы самих отрезков (без вычислений с округлением).
+        for (const QPointF& point : points) {
+            if (coordinate(point) == low) result.point = point;
+            if (coordinate(point) == high) result.end = point;
+        }
+        if (result.end.x() < result.point.x() || (result.end.x() == result.point.x() && result.end.y() < result.point.y())) {
+            std::swap(result.point, result.end);
+        }
+        result.kind = IntersectionKind::Overlap;
+        return true;
+    }
+
+    if (sameSide(d1, d2) || sameSide(d3, d4)) return false;
+
+    if (d1 != 0.0 && d2 != 0.0 && d3 != 0.0 && d4 != 0.0) {
+        // Собственное пересечение во внутренних точках обоих отрезков.
+        const double t = d3 / (d3 - d4);
+        result.point = QPointF(px0 + t * (px1 - px0), py0 + t * (py1 - py0));
+        result.end = result.point;
+        result.kind = IntersectionKind::Crossing;
+        return true;
+    }
+
+    // Конец одного отрезка лежит на другом: точка - сам этот конец.
+    const bool endA = d3 == 0.0 || d4 == 0.0;
+    const bool endB = d1 == 0.0 || d2 == 0.0;
+    if (endA && endB) return false; // Общий конец (стык).
+    if (d1 == 0.0) result.point = QPointF(qx0, qy0);
+    else if (d2 == 0.0) result.point = QPointF(qx1, qy1);
+    else if (d3 == 0.0) result.point = QPointF(px0, py0);
+    else result.point = QPointF(px1, py1);
+    result.end = result.point;
+    result.kind = IntersectionKind::Touch;
+    return true;
+}
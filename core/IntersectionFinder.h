@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Enums.h"
+
+#include <QPointF>
+
+#include <vector>
+#include <cstddef>
+
+class SegmentStore;
+
+// Пересечение двух отрезков сцены.
+struct SegmentIntersection
+{
+    QPointF point;           // Точка пересечения (для наложения - начало общего участка).
+    QPointF end;             // Конец общего участка для наложения (для остальных видов совпадает с point).
+    unsigned firstId = 0;    // ID отрезков; firstId < secondId.
+    unsigned secondId = 0;
+    IntersectionKind kind = IntersectionKind::Crossing;
+};
+
+// Поиск всех попарных пересечений отрезков сцены (пересечения, примыкания и наложения).
+// Плоскость делится на вертикальные полосы; каждый отрезок попадает во все полосы, которые
+// задевает по X, и полосы обрабатываются на разных потоках заметанием слева направо
+// с активным списком отрезков. Пара, найденная в нескольких полосах, сообщается только
+// полосой, в которую попадает точка пересечения, поэтому результат не зависит от числа потоков.
+// Отрезки, соединенные только общим концом (стыки ломаных), и отрезки нулевой длины не сообщаются.
+// Длинные отрезки, проходящие через много полос, проверяются в каждой из них: сцена из
+// множества длинных пересекающихся линий обрабатывается медленнее, чем из коротких.
+class IntersectionFinder
+{
+public:
+    // Возвращает все пересечения отрезков хранилища, упорядоченные по X, затем по Y точки.
+    static std::vector<SegmentIntersection> find(const SegmentStore& segments);
+
+    // Проверяет пару отрезков в строках a и b. Возвращает true и заполняет result, если
+    // они пересекаются (общий конец и отрезки нулевой длины пересечением не считаются).
+    static bool intersect(const SegmentStore& segments, std::size_t a, std::size_t b, SegmentIntersection& result);
+};
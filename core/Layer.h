@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QColor>
+#include <QString>
+
+#include <cstdint>
+
+// Слой сцены. Примитив хранит только номер слоя, поэтому изменение свойств слоя
+// (видимость, блокировка) не требует перебора его примитивов.
+struct Layer
+{
+    // Значение, обозначающее отсутствующий слой.
+    static constexpr std::uint32_t npos = 0xFFFFFFFFu;
+
+    QString name;
+    QColor color = Qt::white; // Цвет по умолчанию для новых объектов слоя.
+    bool visible = true;      // Скрытый слой не отрисовывается, не выбирается и не дает привязок.
+    bool locked = false;      // Объекты заблокированного слоя видны и дают привязки, но не выбираются.
+};
@@ -0,0 +1,141 @@
+#include "Parallel.h"
+#include "Trace.h"
+
+#include <QString>
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+namespace {
+
+// Поток выполняет часть задания пула (рабочий поток или вызывающий во время задания).
+// Вложенный parallelFor в таком потоке выполняется последовательно, иначе пул ждал бы сам себя.
+thread_local bool t_inParallelPart = false;
+
+// Постоянный пул рабочих потоков parallelFor. Потоки создаются при первом задании и живут
+// до завершения программы, поэтому задание стоит пробуждения потоков, а не их создания.
+// Одновременно выполняется одно задание; части берутся из общего счетчика, и вызывающий
+// поток выполняет их наравне с рабочими.
+class WorkerPool
+{
+public:
+    // Возвращает пул программы.
+    static WorkerPool& instance()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    // Выполняет task(part) для всех part из [0, parts) и ждет их завершения.
+    void run(std::size_t parts, const std::function<void(std::size_t)>& task)
+    {
+        // Вложенный вызов или пул занят другим потоком - части выполняются здесь же.
+        std::unique_lock<std::mutex> runLock(m_runMutex, std::defer_lock);
+        if (t_inParallelPart || m_threads.empty() || !runLock.try_lock()) {
+            for (std::size_t part = 0; part < parts; ++part) task(part);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_parts = parts;
+        m_nextPart = 0;
+        m_unfinished = parts;
+        ++m_job;
+        m_wake.notify_all();
+
+        t_inParallelPart = true;
+        runParts(lock);
+        t_inParallelPart = false;
+
+        // Задание завершено, только когда завершены все части: ссылки body остаются действительными.
+        m_done.wait(lock, [this] { return m_unfinished == 0; });
+        m_task = nullptr;
+        const std::exception_ptr error = std::exchange(m_error, nullptr);
+        lock.unlock();
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    // Создает рабочие потоки (вызывающий поток - еще один исполнитель).
+    WorkerPool()
+    {
+        const unsigned count = parallelThreadCount() - 1;
+        m_threads.reserve(count);
+        for (unsigned i = 0; i < count; ++i) {
+            m_threads.emplace_back([this, i] { workerLoop(i + 1); });
+        }
+    }
+
+    // Останавливает и присоединяет рабочие потоки.
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads) thread.join();
+    }
+
+    // Цикл рабочего потока: ждет нового задания и выполняет его свободные части.
+    void workerLoop(unsigned number)
+    {
+        Trace::setThreadName(QString("Worker %1").arg(number));
+        t_inParallelPart = true;
+        std::uint64_t seenJob = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [&] { return m_stopping || m_job != seenJob; });
+            if (m_stopping) return;
+            seenJob = m_job;
+            runParts(lock);
+        }
+    }
+
+    // Выполняет свободные части текущего задания (блокировка снимается на время части).
+    // Исключение части запоминается и пробрасывается вызывающему после завершения всех частей.
+    void runParts(std::unique_lock<std::mutex>& lock)
+    {
+        while (m_task && m_nextPart < m_parts) {
+            const std::size_t part = m_nextPart++;
+            const std::function<void(std::size_t)>* task = m_task;
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                (*task)(part);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+            if (error && !m_error) m_error = error;
+            if (--m_unfinished == 0) m_done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_runMutex; // Занят на время задания.
+
+    // Состояние текущего задания (защищено m_mutex).
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void(std::size_t)>* m_task = nullptr;
+    std::size_t m_parts = 0;
+    std::size_t m_nextPart = 0;
+    std::size_t m_unfinished = 0;
+    std::uint64_t m_job = 0;
+    std::exception_ptr m_error;
+    bool m_stopping = false;
+};
+
+} // namespace
+
+// Выполняет части задания на постоянном пуле потоков.
+void runParallelParts(std::size_t parts, const std::function<void(std::size_t)>& task)
+{
+    WorkerPool::instance().run(parts, task);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Возвращает число рабочих потоков для параллельных операций ядра (не меньше одного).
+inline unsigned parallelThreadCount()
+{
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+// Выполняет task(part) для каждого part из [0, parts) на постоянном пуле рабочих потоков
+// (вызывающий поток тоже выполняет части) и возвращается, когда завершены все части.
+// Если часть бросила исключение, оно пробрасывается после завершения остальных частей.
+// Вложенный вызов из части и вызов, пока пул занят другим потоком, выполняются последовательно.
+void runParallelParts(std::size_t parts, const std::function<void(std::size_t)>& task);
+
+// Делит диапазон [0, count) на непрерывные части и обрабатывает их параллельно.
+// body вызывается как body(begin, end) для каждой части; части не пересекаются,
+// поэтому body может без синхронизации писать в элементы своего диапазона.
+// Если диапазон меньше minChunk, он обрабатывается в вызывающем потоке без обращения к пулу.
+template <typename Body>
+void parallelFor(std::size_t count, std::size_t minChunk, Body&& body)
+{
+    if (count == 0) return;
+
+    const std::size_t maxParts = (count + minChunk - 1) / std::max<std::size_t>(minChunk, 1);
+    const std::size_t parts = std::min<std::size_t>(parallelThreadCount(), maxParts);
+    if (parts <= 1) {
+        body(std::size_t(0), count);
+        return;
+    }
+
+    const std::size_t chunk = (count + parts - 1) / parts;
+    runParallelParts(parts, [&body, chunk, count](std::size_t part) {
+        const std::size_t begin = part * chunk;
+        const std::size_t end = std::min(count, begin + chunk);
+        if (begin < end) body(begin, end);
+    });
+}
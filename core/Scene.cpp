@@ -1,36 +1,952 @@
 #include "Scene.h"
+#include "Point.h"
+#include "Segment.h"
+#include "Geometry.h"
+#include "Parallel.h"
+#include "TransformKernels.h"
+#include "Trace.h"
 
 #include <algorithm>
+#include <utility>
+
+namespace {
+
+// Минимальное число строк на поток при массовом преобразовании.
+constexpr std::size_t kMinTransformChunk = 4096;
+
+// Размер блока строк, собираемых в непрерывные буферы для векторного ядра.
+constexpr std::size_t kTransformBlock = 256;
+
+} // namespace
 
 // Конструктор класса Scene.
-Scene::Scene() : m_nextId(1) // Инициализируем счетчик ID (начинаем с 1)
+Scene::Scene()
+    : m_indexLocations(std::make_shared<SpatialIndex::LocationTable>()),
+      m_nextId(1) // Инициализируем счетчик ID (начинаем с 1)
 {
+    resetLayers({});
 }
 
+// Деструктор (определен в .cpp, т.к. Segment в заголовке объявлен заранее).
+Scene::~Scene() = default;
+
 // Добавляет примитив на сцену.
-void Scene::addPrimitive(std::unique_ptr<Object> primitive)
+Handle Scene::addPrimitive(std::unique_ptr<Object> primitive)
 {
+    UCAD_TRACE_SCOPE("Scene::addPrimitive");
+    ensureLookups();
+
     // Присваиваем объекту ID и увеличиваем счетчик
-    primitive->setID(m_nextId++);
+    const unsigned id = m_nextId++;
+
+    if (primitive->getType() == PrimitiveType::Segment) {
+        // Отрезки копируются в компактное хранилище, сам объект больше не нужен.
+        const auto* segment = static_cast<const Segment*>(primitive.get());
+        const Point start = segment->getStart();
+        const Point end = segment->getEnd();
+        const auto row = static_cast<std::uint32_t>(m_segments.size());
+        const Handle handle = allocateSlot(true, row);
+        m_segments.append(handle, id, start.getX(), start.getY(), end.getX(), end.getY(), segment->getColor(),
+                          m_currentLayer);
+        registerID(id, handle);
+        recordUndo(UndoJournal::Action::Added, row);
+        const QRectF box = m_segments.getBoundingBox(row);
+        m_layerIndices[m_currentLayer]->insert(handle, box);
+        recordChange(ChangeKind::Added, handle, QRectF(), box);
+        return handle;
+    }
+
+    const Handle handle = allocateSlot(false, static_cast<std::uint32_t>(m_primitives.size()));
+    const QRectF box = primitive->getBoundingBox();
+    primitive->setID(id);
+    primitive->setHandle(handle);
+    primitive->setLayer(m_currentLayer);
+    registerID(id, handle);
+    m_layerIndices[m_currentLayer]->insert(handle, box);
     m_primitives.push_back(std::move(primitive));
+    recordChange(ChangeKind::Added, handle, QRectF(), box);
+    return handle;
 }
 
-// Удаляет примитив из сцены по его указателю.
-void Scene::removePrimitive(Object* primitiveToRemove)
+// Добавляет отрезки пакетом прямо в хранилище.
+void Scene::addSegments(const std::vector<SegmentRecord>& records)
 {
-    m_primitives.erase(
-        std::remove_if(m_primitives.begin(), m_primitives.end(),
-            [primitiveToRemove](const std::unique_ptr<Object>& p) {
-               // Сравниваем сырые указатели, чтобы найти нужный unique_ptr.
-               return p.get() == primitiveToRemove;
-            }),
-        m_primitives.end());
+    UCAD_TRACE_SCOPE("Scene::addSegments");
+    ensureLookups();
+    Transaction transaction(*this);
+    for (const SegmentRecord& record : records) {
+        // Отрезки, возвращаемые отменой удаления, сохраняют свои ID.
+        const unsigned id = record.id != 0 ? record.id : m_nextId++;
+        if (id >= m_nextId) m_nextId = id + 1;
+
+        const std::uint32_t layer = record.layer < m_layers.size() ? record.layer : 0;
+        const auto row = static_cast<std::uint32_t>(m_segments.size());
+        const Handle handle = allocateSlot(true, row);
+        m_segments.append(handle, id, record.x0, record.y0, record.x1, record.y1, QColor::fromRgba(record.color), layer);
+        registerID(id, handle);
+        recordUndo(UndoJournal::Action::Added, row);
+        const QRectF box = m_segments.getBoundingBox(row);
+        m_layerIndices[layer]->insert(handle, box);
+        recordChange(ChangeKind::Added, handle, QRectF(), box);
+    }
+}
+
+// Удаляет примитив со сцены.
+void Scene::removePrimitive(Handle handle)
+{
+    UCAD_TRACE_SCOPE("Scene::removePrimitive");
+    if (!contains(handle)) return;
+
+    ensureLookups();
+    const std::size_t row = getSegmentRow(handle);
+    if (row != SegmentStore::npos) {
+        recordUndo(UndoJournal::Action::Removed, row);
+    }
+    recordChange(ChangeKind::Removed, handle, getBoundingBox(handle), QRectF());
+    indexOf(handle).remove(handle);
+    removeFromStorage(handle);
 
     // Примечание: m_nextId не сбрасывается, чтобы гарантировать уникальность ID.
 }
 
-// Возвращает константную ссылку на вектор всех примитивов.
+// Удаляет набор примитивов. Каждое удаление выполняется за O(1) (обмен с последней строкой),
+// поэтому удаление тысяч выбранных объектов не становится квадратичным.
+void Scene::removePrimitives(const std::vector<Handle>& handles)
+{
+    UCAD_TRACE_SCOPE("Scene::removePrimitives");
+    Transaction transaction(*this);
+    for (const Handle& handle : handles) {
+        removePrimitive(handle);
+    }
+}
+
+// Проверяет, указывает ли дескриптор на существующий примитив.
+bool Scene::contains(Handle handle) const
+{
+    return findSlot(handle) != nullptr;
+}
+
+// Обновляет положение примитива в пространственном индексе.
+void Scene::updatePrimitive(Handle handle)
+{
+    UCAD_TRACE_SCOPE("Scene::updatePrimitive");
+    if (!contains(handle)) return;
+
+    ensureLookups();
+
+    // Прежний прямоугольник известен только индексу: объект уже изменен снаружи.
+    SpatialIndex& index = indexOf(handle);
+    const QRectF oldBox = index.getBoundingBox(handle);
+    const QRectF newBox = getBoundingBox(handle);
+    index.update(handle, newBox);
+    recordChange(ChangeKind::Modified, handle, oldBox, newBox);
+}
+
+// Возвращает примитив или представление отрезка по дескриптору.
+Object* Scene::getPrimitive(Handle handle)
+{
+    const Slot* slot = findSlot(handle);
+    if (!slot) return nullptr;
+
+    if (!slot->isSegment) {
+        return m_primitives[slot->location].get();
+    }
+
+    auto& view = m_segmentViews[handle];
+    if (!view) {
+        view = std::make_unique<Segment>(this, handle);
+    }
+    return view.get();
+}
+
+// Возвращает ограничивающий прямоугольник примитива по данным хранилища.
+QRectF Scene::getBoundingBox(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    if (!slot) return QRectF();
+    return slot->isSegment ? m_segments.getBoundingBox(slot->location)
+                           : m_primitives[slot->location]->getBoundingBox();
+}
+
+// Возвращает тип примитива по дескриптору.
+PrimitiveType Scene::getPrimitiveType(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    if (!slot) return PrimitiveType::Generic;
+    return slot->isSegment ? PrimitiveType::Segment : m_primitives[slot->location]->getType();
+}
+
+// Возвращает отображаемый ID примитива.
+unsigned Scene::getPrimitiveID(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    if (!slot) return 0;
+    return slot->isSegment ? m_segments.getID(slot->location) : m_primitives[slot->location]->getID();
+}
+
+// Возвращает дескриптор примитива по ID.
+Handle Scene::findByID(unsigned id) const
+{
+    ensureLookups();
+    return id < m_handleById.size() ? m_handleById[id] : Handle();
+}
+
+// Возвращает общее количество примитивов.
+std::size_t Scene::getPrimitiveCount() const
+{
+    return m_segments.size() + m_primitives.size();
+}
+
+// Возвращает дескрипторы всех примитивов в порядке создания.
+std::vector<Handle> Scene::getPrimitiveHandles() const
+{
+    std::vector<std::pair<unsigned, Handle>> ordered;
+    ordered.reserve(getPrimitiveCount());
+    for (std::size_t row = 0; row < m_segments.size(); ++row) {
+        ordered.emplace_back(m_segments.getID(row), m_segments.getHandle(row));
+    }
+    for (const auto& primitive : m_primitives) {
+        ordered.emplace_back(primitive->getID(), primitive->getHandle());
+    }
+
+    // ID выдаются по возрастанию, поэтому сортировка по ID восстанавливает порядок создания,
+    // нарушенный удалением строк из хранилища.
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<Handle> handles;
+    handles.reserve(ordered.size());
+    for (const auto& entry : ordered) {
+        handles.push_back(entry.second);
+    }
+    return handles;
+}
+
+// Возвращает константную ссылку на вектор прочих примитивов.
 const std::vector<std::unique_ptr<Object>>& Scene::getPrimitives() const
 {
     return m_primitives;
 }
+
+// Возвращает хранилище отрезков.
+const SegmentStore& Scene::getSegments() const
+{
+    return m_segments;
+}
+
+// Заменяет содержимое сцены готовым хранилищем отрезков.
+void Scene::replaceSegments(SegmentStore&& store, unsigned nextId, std::vector<Layer> layers,
+                            std::uint32_t currentLayer)
+{
+    UCAD_TRACE_SCOPE("Scene::replaceSegments");
+    // Изменения, накопленные до замены, относятся к старым дескрипторам и теряют смысл.
+    for (const PendingChange& pending : m_pendingChanges) {
+        m_slots[pending.entry.handle.index].pending = kNoPending;
+    }
+    m_pendingChanges.clear();
+
+    m_pendingLayers.clear();
+
+    m_segmentViews.clear();
+    m_primitives.clear();
+    m_segments = std::move(store);
+    m_nextId = nextId;
+    resetLayers(std::move(layers));
+    m_currentLayer = currentLayer < m_layers.size() ? currentLayer : 0;
+
+    // Строка i занимает ячейку i. Поколение новых ячеек выше поколений всех прежних, поэтому
+    // дескриптор, выданный до замены, не совпадет ни с одним новым объектом.
+    for (const Slot& slot : m_slots) {
+        m_firstGeneration = std::max(m_firstGeneration, slot.generation + 1);
+    }
+    m_segments.resetHandles(m_firstGeneration);
+
+    const std::size_t count = m_segments.size();
+    Slot occupied;
+    occupied.generation = m_firstGeneration;
+    occupied.occupied = true;
+    occupied.isSegment = true;
+    m_slots.assign(count, occupied);
+    for (std::size_t row = 0; row < count; ++row) {
+        m_slots[row].location = static_cast<std::uint32_t>(row);
+    }
+    m_freeSlots.clear();
+
+    m_handleById.clear();
+    m_lookupsStale = true;
+
+    // История относится к прежнему содержимому сцены.
+    if (m_journal) m_journal->clear();
+
+    SceneChange change;
+    change.reset = true;
+    notifyListeners(change);
+}
+
+// Возвращает следующий выдаваемый ID.
+unsigned Scene::getNextID() const
+{
+    return m_nextId;
+}
+
+// Возвращает строку отрезка по дескриптору.
+std::size_t Scene::getSegmentRow(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    return (slot && slot->isSegment) ? slot->location : SegmentStore::npos;
+}
+
+// Устанавливает начальную точку отрезка.
+void Scene::setSegmentStart(Handle handle, const Point& point)
+{
+    UCAD_TRACE_SCOPE("Scene::setSegmentStart");
+    const std::size_t row = getSegmentRow(handle);
+    if (row == SegmentStore::npos) return;
+
+    ensureLookups();
+    recordUndo(UndoJournal::Action::Modified, row);
+    const QRectF oldBox = m_segments.getBoundingBox(row);
+    m_segments.setStart(row, point.getX(), point.getY());
+    const QRectF newBox = m_segments.getBoundingBox(row);
+    m_layerIndices[m_segments.getLayer(row)]->update(handle, newBox);
+    recordChange(ChangeKind::Modified, handle, oldBox, newBox);
+}
+
+// Устанавливает конечную точку отрезка.
+void Scene::setSegmentEnd(Handle handle, const Point& point)
+{
+    UCAD_TRACE_SCOPE("Scene::setSegmentEnd");
+    const std::size_t row = getSegmentRow(handle);
+    if (row == SegmentStore::npos) return;
+
+    ensureLookups();
+    recordUndo(UndoJournal::Action::Modified, row);
+    const QRectF oldBox = m_segments.getBoundingBox(row);
+    m_segments.setEnd(row, point.getX(), point.getY());
+    const QRectF newBox = m_segments.getBoundingBox(row);
+    m_layerIndices[m_segments.getLayer(row)]->update(handle, newBox);
+    recordChange(ChangeKind::Modified, handle, oldBox, newBox);
+}
+
+// Устанавливает цвет отрезка.
+void Scene::setSegmentColor(Handle handle, const QColor& color)
+{
+    UCAD_TRACE_SCOPE("Scene::setSegmentColor");
+    const std::size_t row = getSegmentRow(handle);
+    if (row == SegmentStore::npos) return;
+
+    recordUndo(UndoJournal::Action::Modified, row);
+    m_segments.setColor(row, color);
+    const QRectF box = m_segments.getBoundingBox(row);
+    recordChange(ChangeKind::Modified, handle, box, box);
+}
+
+// Применяет аффинное преобразование к набору отрезков.
+void Scene::transformPrimitives(const std::vector<Handle>& handles, const Affine2D& transform)
+{
+    UCAD_TRACE_SCOPE("Scene::transformPrimitives");
+    ensureLookups();
+
+    // Строки выбранных отрезков (повторы отбрасываются, чтобы потоки не писали в одну строку).
+    // Отрезки скрытых и заблокированных слоев не изменяются, как и при выборе рамкой.
+    std::vector<std::uint32_t> rows;
+    rows.reserve(handles.size());
+    for (const Handle& handle : handles) {
+        const std::size_t row = getSegmentRow(handle);
+        if (row == SegmentStore::npos) continue;
+        const Layer& layer = m_layers[m_segments.getLayer(row)];
+        if (layer.visible && !layer.locked) rows.push_back(static_cast<std::uint32_t>(row));
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.empty()) return;
+
+    Transaction transaction(*this);
+    for (std::uint32_t row : rows) {
+        recordUndo(UndoJournal::Action::Modified, row);
+    }
+
+    const std::size_t count = rows.size();
+    const bool wholeStore = count == m_segments.size();
+    double* x0 = m_segments.mutableX0Data();
+    double* y0 = m_segments.mutableY0Data();
+    double* x1 = m_segments.mutableX1Data();
+    double* y1 = m_segments.mutableY1Data();
+    std::vector<QRectF> oldBoxes(count);
+    std::vector<QRectF> newBoxes(count);
+
+    parallelFor(count, kMinTransformChunk, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            oldBoxes[i] = m_segments.getBoundingBox(rows[i]);
+        }
+
+        if (wholeStore) {
+            // Выбраны все отрезки - ядро работает прямо по столбцам хранилища.
+            transformPoints(transform, x0 + begin, y0 + begin, end - begin);
+            transformPoints(transform, x1 + begin, y1 + begin, end - begin);
+        } else {
+            // Иначе строки блоками собираются в непрерывные буферы и раскладываются обратно.
+            double xs[2 * kTransformBlock];
+            double ys[2 * kTransformBlock];
+            for (std::size_t block = begin; block < end; block += kTransformBlock) {
+                const std::size_t size = std::min(kTransformBlock, end - block);
+                for (std::size_t k = 0; k < size; ++k) {
+                    const std::uint32_t row = rows[block + k];
+                    xs[k] = x0[row];
+                    ys[k] = y0[row];
+                    xs[size + k] = x1[row];
+                    ys[size + k] = y1[row];
+                }
+                transformPoints(transform, xs, ys, 2 * size);
+                for (std::size_t k = 0; k < size; ++k) {
+                    const std::uint32_t row = rows[block + k];
+                    x0[row] = xs[k];
+                    y0[row] = ys[k];
+                    x1[row] = xs[size + k];
+                    y1[row] = ys[size + k];
+                }
+            }
+        }
+
+        for (std::size_t i = begin; i < end; ++i) {
+            newBoxes[i] = m_segments.getBoundingBox(rows[i]);
+        }
+    });
+
+    // Пространственные индексы не потокобезопасны и обновляются последовательно.
+    for (std::size_t i = 0; i < count; ++i) {
+        const Handle handle = m_segments.getHandle(rows[i]);
+        m_layerIndices[m_segments.getLayer(rows[i])]->update(handle, newBoxes[i]);
+        recordChange(ChangeKind::Modified, handle, oldBoxes[i], newBoxes[i]);
+    }
+}
+
+// Возвращает все поля отрезка.
+SegmentRecord Scene::getSegmentRecord(Handle handle) const
+{
+    const std::size_t row = getSegmentRow(handle);
+    if (row == SegmentStore::npos) return SegmentRecord{0.0, 0.0, 0.0, 0.0, 0};
+
+    return SegmentRecord{m_segments.getX0(row), m_segments.getY0(row), m_segments.getX1(row), m_segments.getY1(row),
+                         m_segments.getColor(row).rgba(), m_segments.getID(row), m_segments.getLayer(row)};
+}
+
+// Устанавливает координаты и цвет отрезка.
+void Scene::setSegmentRecord(Handle handle, const SegmentRecord& record)
+{
+    UCAD_TRACE_SCOPE("Scene::setSegmentRecord");
+    const std::size_t row = getSegmentRow(handle);
+    if (row == SegmentStore::npos) return;
+
+    ensureLookups();
+    recordUndo(UndoJournal::Action::Modified, row);
+    const QRectF oldBox = m_segments.getBoundingBox(row);
+    m_segments.setStart(row, record.x0, record.y0);
+    m_segments.setEnd(row, record.x1, record.y1);
+    m_segments.setColor(row, QColor::fromRgba(record.color));
+    const QRectF newBox = m_segments.getBoundingBox(row);
+
+    // Смена слоя переносит отрезок в индекс другого слоя.
+    const std::uint32_t layer = record.layer < m_layers.size() ? record.layer : 0;
+    if (layer != m_segments.getLayer(row)) {
+        m_layerIndices[m_segments.getLayer(row)]->remove(handle);
+        m_segments.setLayer(row, layer);
+    }
+    m_layerIndices[layer]->update(handle, newBox);
+    recordChange(ChangeKind::Modified, handle, oldBox, newBox);
+}
+
+// Выполняет поиск примитивов в заданной области через пространственный индекс.
+void Scene::queryPrimitives(const QRectF& area, std::vector<Handle>& result) const
+{
+    UCAD_TRACE_SCOPE("Scene::queryPrimitives");
+    queryLayers(area, false, result);
+}
+
+// Выполняет поиск примитивов одного слоя в заданной области.
+void Scene::queryLayer(std::uint32_t layer, const QRectF& area, std::vector<Handle>& result) const
+{
+    if (layer >= m_layerIndices.size()) return;
+    ensureLookups();
+    m_layerIndices[layer]->query(area, result);
+}
+
+// Находит ближайший к точке примитив в пределах допуска.
+Handle Scene::pick(const QPointF& point, double tolerance) const
+{
+    UCAD_TRACE_SCOPE("Scene::pick");
+    // Кандидаты - примитивы, прямоугольники которых пересекают квадрат допуска вокруг точки.
+    std::vector<Handle> candidates;
+    queryLayers(QRectF(point.x() - tolerance, point.y() - tolerance, 2.0 * tolerance, 2.0 * tolerance), true,
+                candidates);
+
+    Handle best;
+    unsigned bestId = 0;
+    double bestDistance = tolerance * tolerance;
+    for (const Handle& handle : candidates) {
+        const Slot& slot = m_slots[handle.index];
+
+        // Расстояние до отрезков считается прямо по столбцам хранилища, без представлений.
+        double distance;
+        unsigned id;
+        if (slot.isSegment) {
+            const std::size_t row = slot.location;
+            distance = distanceToSegmentSquared(point.x(), point.y(),
+                                                m_segments.getX0(row), m_segments.getY0(row),
+                                                m_segments.getX1(row), m_segments.getY1(row));
+            id = m_segments.getID(row);
+        } else {
+            const Object* primitive = m_primitives[slot.location].get();
+            distance = primitive->distanceSquaredTo(point);
+            id = primitive->getID();
+        }
+
+        // При равном расстоянии выбирается более поздний объект (он рисуется поверх).
+        if (distance < bestDistance || (distance == bestDistance && id > bestId)) {
+            best = handle;
+            bestId = id;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+// Выделяет примитивы рамкой: грубый отбор по индексу и параллельная точная проверка.
+void Scene::selectInRect(const QRectF& area, SelectionMode mode, std::vector<Handle>& result) const
+{
+    UCAD_TRACE_SCOPE("Scene::selectInRect");
+    const QRectF box = area.normalized();
+    std::vector<Handle> candidates;
+    queryLayers(box, true, candidates);
+
+    // Каждый поток пишет только в свой непрерывный диапазон флагов.
+    std::vector<unsigned char> accepted(candidates.size(), 0);
+    const std::size_t kMinChunk = 16384;
+    parallelFor(candidates.size(), kMinChunk, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            accepted[i] = isSelectedByRect(candidates[i], box, mode) ? 1 : 0;
+        }
+    });
+
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        if (accepted[i]) result.push_back(candidates[i]);
+    }
+}
+
+// Точная проверка одного кандидата.
+bool Scene::isSelectedByRect(Handle handle, const QRectF& area, SelectionMode mode) const
+{
+    const Slot& slot = m_slots[handle.index];
+    if (slot.isSegment) {
+        const std::size_t row = slot.location;
+        const double x0 = m_segments.getX0(row);
+        const double y0 = m_segments.getY0(row);
+        const double x1 = m_segments.getX1(row);
+        const double y1 = m_segments.getY1(row);
+        if (mode == SelectionMode::Window) {
+            // Отрезок лежит в рамке, если в ней лежат оба его конца.
+            return std::min(x0, x1) >= area.left() && std::max(x0, x1) <= area.right() &&
+                   std::min(y0, y1) >= area.top() && std::max(y0, y1) <= area.bottom();
+        }
+        return segmentIntersectsRect(x0, y0, x1, y1, area.left(), area.top(), area.right(), area.bottom());
+    }
+
+    // Для прочих примитивов используется их ограничивающий прямоугольник.
+    const QRectF box = m_primitives[slot.location]->getBoundingBox();
+    if (mode == SelectionMode::Window) {
+        return box.left() >= area.left() && box.right() <= area.right() &&
+               box.top() >= area.top() && box.bottom() <= area.bottom();
+    }
+    return true;
+}
+
+// Возвращает количество слоев.
+std::size_t Scene::getLayerCount() const
+{
+    return m_layers.size();
+}
+
+// Возвращает свойства слоя.
+const Layer& Scene::getLayer(std::uint32_t layer) const
+{
+    return m_layers[layer];
+}
+
+// Добавляет слой и возвращает его номер.
+std::uint32_t Scene::addLayer(const Layer& layer)
+{
+    const auto index = static_cast<std::uint32_t>(m_layers.size());
+    m_layers.push_back(layer);
+    m_layerIndices.push_back(std::make_unique<SpatialIndex>(m_indexLocations));
+    recordLayerChange(index);
+    return index;
+}
+
+// Возвращает номер слоя по имени или Layer::npos.
+std::uint32_t Scene::findLayer(const QString& name) const
+{
+    for (std::size_t i = 0; i < m_layers.size(); ++i) {
+        if (m_layers[i].name == name) return static_cast<std::uint32_t>(i);
+    }
+    return Layer::npos;
+}
+
+// Изменяет свойства слоя.
+void Scene::setLayer(std::uint32_t layer, const Layer& properties)
+{
+    if (layer >= m_layers.size()) return;
+    m_layers[layer] = properties;
+    recordLayerChange(layer);
+}
+
+// Показывает или скрывает слой.
+void Scene::setLayerVisible(std::uint32_t layer, bool visible)
+{
+    if (layer >= m_layers.size() || m_layers[layer].visible == visible) return;
+    m_layers[layer].visible = visible;
+    recordLayerChange(layer);
+}
+
+// Блокирует или разблокирует слой.
+void Scene::setLayerLocked(std::uint32_t layer, bool locked)
+{
+    if (layer >= m_layers.size() || m_layers[layer].locked == locked) return;
+    m_layers[layer].locked = locked;
+    recordLayerChange(layer);
+}
+
+// Устанавливает текущий слой.
+void Scene::setCurrentLayer(std::uint32_t layer)
+{
+    if (layer >= m_layers.size() || layer == m_currentLayer) return;
+    const std::uint32_t previous = m_currentLayer;
+    m_currentLayer = layer;
+    recordLayerChange(previous);
+    recordLayerChange(layer);
+}
+
+// Возвращает текущий слой.
+std::uint32_t Scene::getCurrentLayer() const
+{
+    return m_currentLayer;
+}
+
+// Возвращает количество примитивов на слое (по размеру индекса слоя).
+std::size_t Scene::getLayerPrimitiveCount(std::uint32_t layer) const
+{
+    if (layer >= m_layerIndices.size()) return 0;
+    ensureLookups();
+    return m_layerIndices[layer]->size();
+}
+
+// Возвращает номер слоя примитива.
+std::uint32_t Scene::getPrimitiveLayer(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    return slot ? layerOf(*slot) : Layer::npos;
+}
+
+// Переносит примитивы на слой.
+void Scene::setPrimitivesLayer(const std::vector<Handle>& handles, std::uint32_t layer)
+{
+    UCAD_TRACE_SCOPE("Scene::setPrimitivesLayer");
+    if (layer >= m_layers.size()) return;
+
+    ensureLookups();
+    Transaction transaction(*this);
+    for (const Handle& handle : handles) {
+        const Slot* slot = findSlot(handle);
+        if (!slot) continue;
+        const std::uint32_t previous = layerOf(*slot);
+        if (previous == layer) continue;
+
+        const QRectF box = getBoundingBox(handle);
+        if (slot->isSegment) {
+            recordUndo(UndoJournal::Action::Modified, slot->location);
+            m_segments.setLayer(slot->location, layer);
+        } else {
+            m_primitives[slot->location]->setLayer(layer);
+        }
+        m_layerIndices[previous]->remove(handle);
+        m_layerIndices[layer]->insert(handle, box);
+        recordChange(ChangeKind::Modified, handle, box, box);
+    }
+}
+
+// Проверяет, видим ли слой примитива.
+bool Scene::isPrimitiveVisible(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    return slot && m_layers[layerOf(*slot)].visible;
+}
+
+// Проверяет, можно ли выбрать и изменить примитив.
+bool Scene::isPrimitiveEditable(Handle handle) const
+{
+    const Slot* slot = findSlot(handle);
+    if (!slot) return false;
+    const Layer& layer = m_layers[layerOf(*slot)];
+    return layer.visible && !layer.locked;
+}
+
+// Подключает журнал отмены.
+void Scene::setUndoJournal(UndoJournal* journal)
+{
+    m_journal = journal;
+}
+
+// Регистрирует слушателя изменений сцены.
+void Scene::addListener(SceneListener* listener)
+{
+    if (std::find(m_listeners.begin(), m_listeners.end(), listener) == m_listeners.end()) {
+        m_listeners.push_back(listener);
+    }
+}
+
+// Удаляет слушателя изменений сцены.
+void Scene::removeListener(SceneListener* listener)
+{
+    m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
+}
+
+// Начинает (возможно, вложенную) транзакцию.
+void Scene::beginTransaction()
+{
+    ++m_transactionDepth;
+}
+
+// Завершает транзакцию; после самой внешней слушатели получают одно уведомление.
+void Scene::commitTransaction()
+{
+    if (m_transactionDepth > 0 && --m_transactionDepth == 0) {
+        if (m_journal) m_journal->commitEntry();
+        flushChanges();
+    }
+}
+
+// Запоминает изменение примитива. Повторные изменения одного примитива в транзакции
+// объединяются: добавление с последующим изменением остается добавлением,
+// добавление с последующим удалением взаимно уничтожаются, а у изменения сохраняется
+// самый первый прежний прямоугольник.
+void Scene::recordChange(ChangeKind kind, Handle handle, const QRectF& oldBox, const QRectF& newBox)
+{
+    // Вне транзакции каждое изменение - отдельный шаг журнала отмены.
+    if (m_journal && m_transactionDepth == 0) {
+        m_journal->commitEntry();
+    }
+
+    if (m_listeners.empty()) return;
+
+    Slot& slot = m_slots[handle.index];
+    if (slot.pending == kNoPending) {
+        slot.pending = static_cast<std::uint32_t>(m_pendingChanges.size());
+        m_pendingChanges.push_back(PendingChange{kind, SceneChange::Entry{handle, oldBox, newBox}});
+    } else {
+        PendingChange& pending = m_pendingChanges[slot.pending];
+        if (kind == ChangeKind::Removed) {
+            pending.kind = (pending.kind == ChangeKind::Added) ? ChangeKind::None : ChangeKind::Removed;
+        }
+        pending.entry.newBox = newBox;
+    }
+
+    if (m_transactionDepth == 0) {
+        flushChanges();
+    }
+}
+
+// Собирает накопленные изменения и передает их слушателям.
+void Scene::flushChanges()
+{
+    UCAD_TRACE_SCOPE("Scene::flushChanges");
+    if (m_pendingChanges.empty() && m_pendingLayers.empty()) return;
+
+    SceneChange change;
+    change.layers.swap(m_pendingLayers);
+    for (const PendingChange& pending : m_pendingChanges) {
+        // Удаленные ячейки уже освобождены, у живых сбрасываем ссылку на запись.
+        Slot& slot = m_slots[pending.entry.handle.index];
+        if (slot.generation == pending.entry.handle.generation) {
+            slot.pending = kNoPending;
+        }
+
+        switch (pending.kind) {
+        case ChangeKind::Added: change.added.push_back(pending.entry); break;
+        case ChangeKind::Removed: change.removed.push_back(pending.entry); break;
+        case ChangeKind::Modified: change.modified.push_back(pending.entry); break;
+        case ChangeKind::None: break;
+        }
+    }
+    m_pendingChanges.clear();
+
+    if (change.isEmpty()) return;
+
+    notifyListeners(change);
+}
+
+// Запоминает изменение свойств слоя; вне транзакции слушатели уведомляются сразу.
+void Scene::recordLayerChange(std::uint32_t layer)
+{
+    if (m_listeners.empty()) return;
+
+    if (std::find(m_pendingLayers.begin(), m_pendingLayers.end(), layer) == m_pendingLayers.end()) {
+        m_pendingLayers.push_back(layer);
+    }
+    if (m_transactionDepth == 0) {
+        flushChanges();
+    }
+}
+
+// Передает уведомление слушателям.
+void Scene::notifyListeners(const SceneChange& change)
+{
+    UCAD_TRACE_SCOPE("Scene::notifyListeners");
+    // Копия списка на случай, если слушатель отпишется во время уведомления.
+    const std::vector<SceneListener*> listeners = m_listeners;
+    for (SceneListener* listener : listeners) {
+        listener->onSceneChanged(change);
+    }
+}
+
+// Заполняет пространственный индекс и таблицу ID всеми отрезками после замены содержимого сцены.
+void Scene::ensureLookups() const
+{
+    if (!m_lookupsStale) return;
+    m_lookupsStale = false;
+
+    for (std::size_t row = 0; row < m_segments.size(); ++row) {
+        const Handle handle = m_segments.getHandle(row);
+        m_layerIndices[m_segments.getLayer(row)]->insert(handle, m_segments.getBoundingBox(row));
+
+        const unsigned id = m_segments.getID(row);
+        if (id >= m_handleById.size()) m_handleById.resize(id + 1);
+        m_handleById[id] = handle;
+    }
+}
+
+// Возвращает номер слоя примитива в ячейке.
+std::uint32_t Scene::layerOf(const Slot& slot) const
+{
+    return slot.isSegment ? m_segments.getLayer(slot.location) : m_primitives[slot.location]->getLayer();
+}
+
+// Возвращает пространственный индекс слоя примитива (дескриптор должен быть действительным).
+SpatialIndex& Scene::indexOf(Handle handle) const
+{
+    return *m_layerIndices[layerOf(m_slots[handle.index])];
+}
+
+// Опрашивает индексы видимых слоев; скрытые слои пропускаются целиком, без перебора их примитивов.
+void Scene::queryLayers(const QRectF& area, bool editableOnly, std::vector<Handle>& candidates) const
+{
+    ensureLookups();
+    for (std::size_t i = 0; i < m_layers.size(); ++i) {
+        const Layer& layer = m_layers[i];
+        if (!layer.visible || (editableOnly && layer.locked)) continue;
+        m_layerIndices[i]->query(area, candidates);
+    }
+}
+
+// Заменяет слои сцены и создает для них пустые индексы с новой общей таблицей узлов.
+void Scene::resetLayers(std::vector<Layer> layers)
+{
+    if (layers.empty()) {
+        Layer layer;
+        layer.name = QString("0");
+        layers.push_back(layer);
+    }
+    m_layers = std::move(layers);
+    m_currentLayer = 0;
+
+    m_layerIndices.clear();
+    m_indexLocations = std::make_shared<SpatialIndex::LocationTable>();
+    m_layerIndices.reserve(m_layers.size());
+    for (std::size_t i = 0; i < m_layers.size(); ++i) {
+        m_layerIndices.push_back(std::make_unique<SpatialIndex>(m_indexLocations));
+    }
+}
+
+// Запоминает дескриптор примитива по его ID.
+void Scene::registerID(unsigned id, Handle handle)
+{
+    if (id >= m_handleById.size()) {
+        m_handleById.resize(std::max<std::size_t>(id + 1, m_handleById.size() * 2));
+    }
+    m_handleById[id] = handle;
+}
+
+// Передает журналу отмены состояние отрезка.
+void Scene::recordUndo(UndoJournal::Action action, std::size_t row)
+{
+    if (!m_journal) return;
+
+    m_journal->record(action, SegmentRecord{m_segments.getX0(row), m_segments.getY0(row),
+                                            m_segments.getX1(row), m_segments.getY1(row),
+                                            m_segments.getColor(row).rgba(), m_segments.getID(row),
+                                            m_segments.getLayer(row)});
+}
+
+// Выделяет ячейку таблицы дескрипторов (свободные ячейки используются повторно).
+Handle Scene::allocateSlot(bool isSegment, std::uint32_t location)
+{
+    std::uint32_t index;
+    if (!m_freeSlots.empty()) {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+        m_slots.back().generation = m_firstGeneration;
+    }
+
+    Slot& slot = m_slots[index];
+    slot.location = location;
+    slot.occupied = true;
+    slot.isSegment = isSegment;
+    return Handle{index, slot.generation};
+}
+
+// Возвращает ячейку по дескриптору, проверяя поколение.
+const Scene::Slot* Scene::findSlot(Handle handle) const
+{
+    if (handle.index >= m_slots.size()) return nullptr;
+    const Slot& slot = m_slots[handle.index];
+    return (slot.occupied && slot.generation == handle.generation) ? &slot : nullptr;
+}
+
+// Освобождает ячейку таблицы дескрипторов.
+void Scene::releaseSlot(Handle handle)
+{
+    Slot& slot = m_slots[handle.index];
+    slot.occupied = false;
+    slot.pending = kNoPending; // Запись об удалении окончательна и больше не объединяется
+    ++slot.generation;
+    m_freeSlots.push_back(handle.index);
+}
+
+// Удаляет примитив из хранилища за O(1): на его место переносится последний элемент.
+void Scene::removeFromStorage(Handle handle)
+{
+    const Slot slot = m_slots[handle.index];
+    const std::uint32_t location = slot.location;
+
+    const unsigned id = slot.isSegment ? m_segments.getID(location) : m_primitives[location]->getID();
+    if (id < m_handleById.size()) m_handleById[id] = Handle();
+
+    if (slot.isSegment) {
+        const std::size_t last = m_segments.size() - 1;
+        if (location != last) {
+            m_slots[m_segments.getHandle(last).index].location = location;
+        }
+        m_segments.removeRow(location);
+        m_segmentViews.erase(handle);
+    } else {
+        const std::size_t last = m_primitives.size() - 1;
+        if (location != last) {
+            m_primitives[location] = std::move(m_primitives[last]);
+            m_slots[m_primitives[location]->getHandle().index].location = location;
+        }
+        m_primitives.pop_back();
+    }
+
+    releaseSlot(handle);
+}
@@ -1,30 +1,325 @@
 #pragma once
 
 #include "Object.h"
+#include "Handle.h"
+#include "SceneChange.h"
+#include "SegmentStore.h"
+#include "SpatialIndex.h"
+#include "UndoJournal.h"
+#include "Affine2D.h"
+#include "Layer.h"
 
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+class Point;
+class Segment;
 
 // Центральное хранилище для всех геометрических объектов в проекте.
+// Отрезки хранятся в компактном хранилище SegmentStore, а объекты Segment служат
+// лишь представлениями его строк для панелей интерфейса. Прочие примитивы
+// хранятся как отдельные объекты.
+// Каждый примитив адресуется поколенческим дескриптором Handle: вставка, удаление
+// и поиск по дескриптору выполняются за O(1), а устаревшие дескрипторы распознаются.
+// Об изменениях сцена сообщает слушателям SceneListener: каждое изменение вне транзакции
+// дает отдельное уведомление, а изменения внутри транзакции объединяются в одно.
+// Если подключен журнал отмены, состояние отрезков до изменения записывается в него,
+// и все изменения одной транзакции отменяются одним шагом.
+// Каждый примитив лежит на одном из слоев сцены (слой 0 существует всегда). У каждого слоя
+// свой пространственный индекс, поэтому запросы по области просто пропускают скрытые слои
+// (а выбор - еще и заблокированные), не перебирая их примитивы.
 class Scene
 {
 public:
+    // Транзакция на время жизни объекта: все изменения сцены внутри нее
+    // передаются слушателям одним уведомлением при выходе из области видимости.
+    class Transaction
+    {
+    public:
+        explicit Transaction(Scene& scene) : m_scene(scene) { m_scene.beginTransaction(); }
+        ~Transaction() { m_scene.commitTransaction(); }
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+    private:
+        Scene& m_scene;
+    };
+
     // Конструктор класса Scene.
     Scene();
 
-    // Добавляет новый примитив (объект) на сцену.
-    void addPrimitive(std::unique_ptr<Object> primitive);
+    // Деструктор класса Scene.
+    ~Scene();
+
+    // Добавляет новый примитив (объект) на текущий слой сцены и возвращает его дескриптор.
+    Handle addPrimitive(std::unique_ptr<Object> primitive);
+
+    // Добавляет отрезки пакетом одной транзакцией (слушатели получают одно уведомление)
+    // минуя создание объектов Segment. Используется при импорте и отмене удаления
+    // (записи с ненулевым ID добавляются с этим ID, несуществующий слой заменяется слоем 0).
+    void addSegments(const std::vector<SegmentRecord>& records);
+
+    // Удаляет примитив со сцены (устаревший дескриптор игнорируется).
+    void removePrimitive(Handle handle);
+
+    // Удаляет набор примитивов за время, линейное по размеру набора.
+    void removePrimitives(const std::vector<Handle>& handles);
+
+    // Возвращает true, если дескриптор указывает на существующий примитив.
+    bool contains(Handle handle) const;
+
+    // Обновляет положение примитива в пространственном индексе после изменения его геометрии.
+    void updatePrimitive(Handle handle);
 
-    // Удаляет указанный примитив со сцены.
-    void removePrimitive(Object* primitiveToRemove);
+    // Возвращает примитив (или представление отрезка) по дескриптору, либо nullptr,
+    // если дескриптор устарел. Указатель действителен до удаления примитива со сцены.
+    Object* getPrimitive(Handle handle);
 
-    // Возвращает константную ссылку на вектор всех примитивов на сцене.
+    // Возвращает ограничивающий прямоугольник примитива (пустой для устаревшего дескриптора).
+    QRectF getBoundingBox(Handle handle) const;
+
+    // Возвращает тип примитива по дескриптору.
+    PrimitiveType getPrimitiveType(Handle handle) const;
+
+    // Возвращает отображаемый ID примитива (0 для устаревшего дескриптора).
+    unsigned getPrimitiveID(Handle handle) const;
+
+    // Возвращает дескриптор примитива по ID за O(1) (пустой, если примитива нет).
+    Handle findByID(unsigned id) const;
+
+    // Возвращает общее количество примитивов на сцене.
+    std::size_t getPrimitiveCount() const;
+
+    // Возвращает дескрипторы всех примитивов в порядке их создания.
+    std::vector<Handle> getPrimitiveHandles() const;
+
+    // Возвращает константную ссылку на вектор примитивов, хранящихся как отдельные объекты
+    // (все, кроме отрезков).
     const std::vector<std::unique_ptr<Object>>& getPrimitives() const;
 
+    // Возвращает хранилище отрезков.
+    const SegmentStore& getSegments() const;
+
+    // Заменяет все содержимое сцены отрезками из store (строка i получает дескриптор {i, g}, где
+    // поколение g больше поколений всех дескрипторов, выданных до замены),
+    // nextId - следующий выдаваемый ID, layers - слои (номера слоев строк должны быть меньше
+    // их количества; пустой список - один слой 0). Пространственные индексы строятся лениво
+    // при первом запросе, поэтому столбцы, отображенные в память, не читаются при загрузке целиком.
+    // Слушатели получают уведомление с флагом reset.
+    void replaceSegments(SegmentStore&& store, unsigned nextId, std::vector<Layer> layers = {},
+                         std::uint32_t currentLayer = 0);
+
+    // Строит пространственные индексы и таблицу ID, если они устарели после replaceSegments.
+    // Без явного вызова их строит первый запрос к сцене (например, первая отрисовка после загрузки).
+    void ensureLookups() const;
+
+    // Возвращает следующий выдаваемый ID.
+    unsigned getNextID() const;
+
+    // Возвращает строку отрезка в хранилище по дескриптору или SegmentStore::npos.
+    std::size_t getSegmentRow(Handle handle) const;
+
+    // Изменяют отрезок в хранилище и поддерживают актуальность пространственного индекса.
+    void setSegmentStart(Handle handle, const Point& point);
+    void setSegmentEnd(Handle handle, const Point& point);
+    void setSegmentColor(Handle handle, const QColor& color);
+
+    // Применяет аффинное преобразование к набору отрезков (перенос, поворот, масштаб, отражение).
+    // Концы отрезков преобразуются векторизованными ядрами параллельно на всех ядрах; в том же
+    // проходе вычисляются новые прямоугольники. Все изменения - одна транзакция: одно уведомление
+    // и один шаг отмены. Прочие примитивы, устаревшие дескрипторы и отрезки скрытых или
+    // заблокированных слоев пропускаются.
+    void transformPrimitives(const std::vector<Handle>& handles, const Affine2D& transform);
+
+    // Возвращает все поля отрезка (включая ID) или запись с нулевым ID для устаревшего дескриптора.
+    SegmentRecord getSegmentRecord(Handle handle) const;
+
+    // Устанавливает координаты и цвет отрезка за одно изменение (ID записи не используется).
+    void setSegmentRecord(Handle handle, const SegmentRecord& record);
+
+    // Добавляет в result дескрипторы примитивов видимых слоев, ограничивающие прямоугольники
+    // которых пересекают area (слой за слоем, в порядке слоев).
+    void queryPrimitives(const QRectF& area, std::vector<Handle>& result) const;
+
+    // Добавляет в result дескрипторы примитивов одного слоя (независимо от его видимости),
+    // ограничивающие прямоугольники которых пересекают area.
+    void queryLayer(std::uint32_t layer, const QRectF& area, std::vector<Handle>& result) const;
+
+    // Возвращает ближайший к точке примитив видимого незаблокированного слоя на расстоянии
+    // не больше tolerance (пустой дескриптор, если такого нет). Кандидаты отбираются индексами слоев.
+    Handle pick(const QPointF& point, double tolerance) const;
+
+    // Добавляет в result примитивы видимых незаблокированных слоев, выделяемые рамкой area:
+    // в режиме Window - целиком лежащие в рамке, в режиме Crossing - касающиеся ее. Кандидаты
+    // отбираются индексами слоев, а точная проверка кандидатов распределяется по ядрам процессора.
+    void selectInRect(const QRectF& area, SelectionMode mode, std::vector<Handle>& result) const;
+
+    // Возвращает количество слоев.
+    std::size_t getLayerCount() const;
+
+    // Возвращает свойства слоя.
+    const Layer& getLayer(std::uint32_t layer) const;
+
+    // Добавляет слой и возвращает его номер.
+    std::uint32_t addLayer(const Layer& layer);
+
+    // Возвращает номер слоя по имени или Layer::npos.
+    std::uint32_t findLayer(const QString& name) const;
+
+    // Изменяет свойства слоя. Слушатели получают уведомление с номером слоя; примитивы
+    // слоя не перебираются, поэтому скрытие и показ слоя не зависят от числа его объектов.
+    void setLayer(std::uint32_t layer, const Layer& properties);
+    void setLayerVisible(std::uint32_t layer, bool visible);
+    void setLayerLocked(std::uint32_t layer, bool locked);
+
+    // Текущий слой, на который добавляются новые примитивы.
+    void setCurrentLayer(std::uint32_t layer);
+    std::uint32_t getCurrentLayer() const;
+
+    // Возвращает количество примитивов на слое.
+    std::size_t getLayerPrimitiveCount(std::uint32_t layer) const;
+
+    // Возвращает номер слоя примитива (Layer::npos для устаревшего дескриптора).
+    std::uint32_t getPrimitiveLayer(Handle handle) const;
+
+    // Переносит примитивы на слой одной транзакцией (одно уведомление и один шаг отмены).
+    void setPrimitivesLayer(const std::vector<Handle>& handles, std::uint32_t layer);
+
+    // Возвращает true, если слой примитива видим.
+    bool isPrimitiveVisible(Handle handle) const;
+
+    // Возвращает true, если примитив можно выбрать и изменить (его слой видим и не заблокирован).
+    bool isPrimitiveEditable(Handle handle) const;
+
+    // Подключает журнал отмены (сцена не владеет журналом; nullptr - отключить).
+    void setUndoJournal(UndoJournal* journal);
+
+    // Регистрирует слушателя изменений сцены (сцена не владеет слушателем).
+    void addListener(SceneListener* listener);
+
+    // Удаляет слушателя изменений сцены.
+    void removeListener(SceneListener* listener);
+
+    // Начинает транзакцию. Транзакции могут быть вложенными: уведомление отправляется
+    // после завершения самой внешней из них.
+    void beginTransaction();
+
+    // Завершает транзакцию и уведомляет слушателей о накопленных изменениях.
+    void commitTransaction();
+
 private:
-    // Вектор умных указателей на все примитивы, находящиеся на сцене.
+    // Значение Slot::pending, означающее, что изменений примитива в текущей транзакции нет.
+    static constexpr std::uint32_t kNoPending = 0xFFFFFFFFu;
+
+    // Ячейка таблицы дескрипторов.
+    struct Slot
+    {
+        std::uint32_t generation = 0;       // Текущее поколение ячейки.
+        std::uint32_t location = 0;         // Строка в хранилище отрезков или индекс в m_primitives.
+        std::uint32_t pending = kNoPending; // Запись в m_pendingChanges для текущей транзакции.
+        bool occupied = false;              // Занята ли ячейка живым примитивом.
+        bool isSegment = false;             // Где хранится примитив.
+    };
+
+    // Вид изменения примитива.
+    enum class ChangeKind { None, Added, Removed, Modified };
+
+    // Изменение, накопленное в текущей транзакции.
+    struct PendingChange
+    {
+        ChangeKind kind;
+        SceneChange::Entry entry;
+    };
+
+    // Запоминает изменение примитива, объединяя его с предыдущими изменениями в транзакции.
+    void recordChange(ChangeKind kind, Handle handle, const QRectF& oldBox, const QRectF& newBox);
+
+    // Точно проверяет, выделяется ли примитив рамкой (кандидат уже отобран индексом).
+    bool isSelectedByRect(Handle handle, const QRectF& area, SelectionMode mode) const;
+
+    // Отправляет слушателям накопленные изменения.
+    void flushChanges();
+
+    // Передает уведомление всем слушателям.
+    void notifyListeners(const SceneChange& change);
+
+    // Возвращает номер слоя примитива в ячейке.
+    std::uint32_t layerOf(const Slot& slot) const;
+
+    // Возвращает пространственный индекс слоя примитива.
+    SpatialIndex& indexOf(Handle handle) const;
+
+    // Добавляет в candidates примитивы из области area на видимых (и, если editableOnly, незаблокированных) слоях.
+    void queryLayers(const QRectF& area, bool editableOnly, std::vector<Handle>& candidates) const;
+
+    // Запоминает изменение свойств слоя (объединяется с прочими изменениями транзакции).
+    void recordLayerChange(std::uint32_t layer);
+
+    // Заменяет слои (пустой список - один слой 0) и создает для каждого слоя пустой индекс.
+    void resetLayers(std::vector<Layer> layers);
+
+    // Запоминает, что примитив с ID id находится под дескриптором handle.
+    void registerID(unsigned id, Handle handle);
+
+    // Передает журналу отмены состояние отрезка до изменения.
+    void recordUndo(UndoJournal::Action action, std::size_t row);
+
+    // Выделяет ячейку для нового примитива и возвращает ее дескриптор.
+    Handle allocateSlot(bool isSegment, std::uint32_t location);
+
+    // Возвращает ячейку по дескриптору или nullptr, если дескриптор устарел.
+    const Slot* findSlot(Handle handle) const;
+
+    // Освобождает ячейку: поколение увеличивается, старые дескрипторы становятся устаревшими.
+    void releaseSlot(Handle handle);
+
+    // Удаляет примитив без изменения пространственного индекса.
+    void removeFromStorage(Handle handle);
+
+    // Таблица дескрипторов и список свободных ячеек.
+    std::vector<Slot> m_slots;
+
+    // Поколение новых ячеек: после replaceSegments оно выше всех прежних поколений.
+    std::uint32_t m_firstGeneration = 0;
+    std::vector<std::uint32_t> m_freeSlots;
+
+    // Хранилище всех отрезков сцены.
+    SegmentStore m_segments;
+
+    // Представления отрезков, выданные панелям интерфейса (создаются по запросу).
+    std::unordered_map<Handle, std::unique_ptr<Segment>> m_segmentViews;
+
+    // Вектор умных указателей на прочие примитивы, находящиеся на сцене.
     std::vector<std::unique_ptr<Object>> m_primitives;
 
+    // Слои сцены и текущий слой для новых примитивов.
+    std::vector<Layer> m_layers;
+    std::uint32_t m_currentLayer = 0;
+
+    // Пространственные индексы слоев для быстрого отсечения по видимой области. Индексы
+    // пользуются одной таблицей узлов (примитив лежит ровно на одном слое).
+    // Изменяем в константных запросах, т.к. после загрузки сцены строятся лениво.
+    std::shared_ptr<SpatialIndex::LocationTable> m_indexLocations;
+    mutable std::vector<std::unique_ptr<SpatialIndex>> m_layerIndices;
+
+    // Дескрипторы примитивов по ID (пустой дескриптор - ID свободен); строится лениво, как и индекс.
+    mutable std::vector<Handle> m_handleById;
+    mutable bool m_lookupsStale = false;
+
     // Счетчик для генерации уникальных ID.
     unsigned int m_nextId;
+
+    // Слушатели изменений сцены.
+    std::vector<SceneListener*> m_listeners;
+
+    // Журнал отмены (nullptr - изменения не записываются).
+    UndoJournal* m_journal = nullptr;
+
+    // Изменения текущей транзакции и глубина вложенности транзакций.
+    std::vector<PendingChange> m_pendingChanges;
+    std::vector<std::uint32_t> m_pendingLayers;
+    int m_transactionDepth = 0;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Handle.h"
+
+#include <QRectF>
+
+#include <vector>
+#include <cstdint>
+
+// Описание изменений сцены, накопленных за одну транзакцию.
+// Для каждого затронутого примитива известны его прямоугольники до и после изменения,
+// поэтому слушатели могут обновлять только затронутые области и строки.
+struct SceneChange
+{
+    // Запись об изменении одного примитива.
+    struct Entry
+    {
+        Handle handle;
+        QRectF oldBox; // Прямоугольник до изменения (пустой для добавленных).
+        QRectF newBox; // Прямоугольник после изменения (пустой для удаленных).
+    };
+
+    std::vector<Entry> added;
+    std::vector<Entry> removed;
+    std::vector<Entry> modified;
+
+    // Номера добавленных слоев и слоев, свойства которых изменились (имя, цвет, видимость, блокировка).
+    std::vector<std::uint32_t> layers;
+
+    // Содержимое сцены заменено целиком (например, загружено из файла): списки пусты,
+    // все ранее выданные дескрипторы устарели, и слушатели перестраивают свои данные полностью.
+    bool reset = false;
+
+    // Возвращает true, если изменений нет.
+    bool isEmpty() const { return !reset && added.empty() && removed.empty() && modified.empty() && layers.empty(); }
+
+    // Возвращает общее количество затронутых примитивов (без слоев).
+    std::size_t size() const { return added.size() + removed.size() + modified.size(); }
+
+    // Очищает все списки.
+    void clear()
+    {
+        added.clear();
+        removed.clear();
+        modified.clear();
+        layers.clear();
+        reset = false;
+    }
+};
+
+// Интерфейс слушателя изменений сцены.
+class SceneListener
+{
+public:
+    // Виртуальный деструктор.
+    virtual ~SceneListener() = default;
+
+    // Вызывается один раз после завершения каждой транзакции, изменившей сцену.
+    virtual void onSceneChanged(const SceneChange& change) = 0;
+};
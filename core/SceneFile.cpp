@@ -0,0 +1,378 @@
+#include "SceneFile.h"
+#include "Scene.h"
+#include "SegmentStore.h"
+#include "Column.h"
+#include "Trace.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QColor>
+#include <QByteArray>
+
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace {
+
+// Сигнатура файла сцены.
+constexpr char kMagic[8] = {'U', 'C', 'A', 'D', 'S', 'C', 'N', '\0'};
+
+// Метка порядка байтов: читается как то же число только на машине с тем же порядком.
+constexpr std::uint32_t kByteOrderMark = 0x01020304u;
+
+// Текущая версия формата (версия 2 добавила слои).
+constexpr std::uint32_t kVersion = 2;
+
+// Первая версия формата (без слоев; по-прежнему читается).
+constexpr std::uint32_t kVersion1 = 1;
+
+// Выравнивание начала каждого столбца (строка кэша; отображение файла выровнено по странице).
+constexpr std::uint64_t kColumnAlignment = 64;
+
+// Столбцы файла в порядке их расположения. Столбцы версии 1 - начало этого списка.
+enum ColumnIndex { Styles, X0, Y0, X1, Y1, Style, Id, LayerId, LayerTable, LayerNames, ColumnCount };
+
+// Количество столбцов в файле версии 1.
+constexpr int kColumnCountV1 = Id + 1;
+
+// Наибольший разрыв между следующим ID и количеством отрезков: таблица ID сцены занимает
+// память по наибольшему ID, поэтому файл с гораздо большим nextId считается поврежденным.
+constexpr std::uint64_t kMaxIdGap = 1u << 24;
+
+// Заголовок файла.
+struct Header
+{
+    char magic[8];
+    std::uint32_t byteOrder;
+    std::uint32_t version;
+    std::uint32_t headerSize;
+    std::uint32_t styleCount;
+    std::uint32_t nextId;
+    std::uint32_t layerCount;
+    std::uint32_t currentLayer;
+    std::uint32_t layerNamesSize; // Размер блока имен слоев (UTF-8) в байтах.
+    std::uint64_t segmentCount;
+    std::uint64_t offsets[ColumnCount];
+    std::uint64_t fileSize;
+};
+
+// Заголовок файла версии 1.
+struct HeaderV1
+{
+    char magic[8];
+    std::uint32_t byteOrder;
+    std::uint32_t version;
+    std::uint32_t headerSize;
+    std::uint32_t styleCount;
+    std::uint32_t nextId;
+    std::uint32_t reserved;
+    std::uint64_t segmentCount;
+    std::uint64_t offsets[kColumnCountV1];
+    std::uint64_t fileSize;
+};
+
+// Запись таблицы слоев; имя хранится в блоке имен по смещению nameOffset.
+struct LayerRecord
+{
+    QRgb color;
+    std::uint32_t flags;
+    std::uint32_t nameOffset;
+    std::uint32_t nameSize;
+};
+
+// Флаги записи слоя.
+constexpr std::uint32_t kLayerHidden = 1u << 0;
+constexpr std::uint32_t kLayerLocked = 1u << 1;
+
+static_assert(std::is_trivially_copyable<Header>::value, "Header is written as raw bytes");
+static_assert(sizeof(double) == 8 && sizeof(unsigned) == 4, "Column element sizes are part of the format");
+static_assert(sizeof(LayerRecord) == 16, "Layer record size is part of the format");
+
+// Возвращает размер элемента столбца в байтах.
+std::uint64_t elementSize(int column)
+{
+    switch (column) {
+    case Styles: return sizeof(QRgb);
+    case X0: case Y0: case X1: case Y1: return sizeof(double);
+    case Style: case LayerId: return sizeof(std::uint32_t);
+    case Id: return sizeof(unsigned);
+    case LayerTable: return sizeof(LayerRecord);
+    case LayerNames: return 1;
+    }
+    return 0;
+}
+
+// Возвращает количество элементов столбца.
+std::uint64_t elementCount(const Header& header, int column)
+{
+    switch (column) {
+    case Styles: return header.styleCount;
+    case LayerTable: return header.layerCount;
+    case LayerNames: return header.layerNamesSize;
+    }
+    return header.segmentCount;
+}
+
+// Округляет смещение вверх до границы выравнивания столбцов.
+std::uint64_t alignOffset(std::uint64_t offset)
+{
+    return (offset + kColumnAlignment - 1) / kColumnAlignment * kColumnAlignment;
+}
+
+// Заполняет смещения первых columnCount столбцов и размер файла по количеству элементов
+// (headerSize - размер заголовка версии, по которой раскладываются столбцы).
+void layoutColumns(Header& header, int columnCount = ColumnCount, std::uint64_t headerSize = sizeof(Header))
+{
+    std::uint64_t offset = headerSize;
+    for (int column = 0; column < columnCount; ++column) {
+        offset = alignOffset(offset);
+        header.offsets[column] = offset;
+        offset += elementCount(header, column) * elementSize(column);
+    }
+    header.fileSize = offset;
+}
+
+// Переводит заголовок версии 1 в текущий вид (столбцов слоев в таком файле нет).
+Header upgradeHeader(const HeaderV1& old)
+{
+    Header header{};
+    std::memcpy(header.magic, old.magic, sizeof(header.magic));
+    header.byteOrder = old.byteOrder;
+    header.version = old.version;
+    header.headerSize = old.headerSize;
+    header.styleCount = old.styleCount;
+    header.nextId = old.nextId;
+    header.segmentCount = old.segmentCount;
+    std::memcpy(header.offsets, old.offsets, sizeof(old.offsets));
+    header.fileSize = old.fileSize;
+    return header;
+}
+
+// Записывает описание ошибки, если оно запрошено.
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+} // namespace
+
+// Возвращает расширение файлов сцены.
+const char* SceneFile::extension()
+{
+    return "ucad";
+}
+
+// Сохраняет отрезки сцены в файл.
+bool SceneFile::save(const Scene& scene, const QString& path, QString* error)
+{
+    UCAD_TRACE_SCOPE("SceneFile::save");
+    const SegmentStore& segments = scene.getSegments();
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.byteOrder = kByteOrderMark;
+    header.version = kVersion;
+    header.headerSize = sizeof(Header);
+    header.styleCount = static_cast<std::uint32_t>(segments.getStyles().size());
+    header.nextId = scene.getNextID();
+    header.segmentCount = segments.size();
+
+    std::vector<QRgb> styles;
+    styles.reserve(segments.getStyles().size());
+    for (const QColor& color : segments.getStyles()) {
+        styles.push_back(color.rgba());
+    }
+
+    // Таблица слоев и общий блок их имен.
+    std::vector<LayerRecord> layers;
+    QByteArray layerNames;
+    layers.reserve(scene.getLayerCount());
+    for (std::uint32_t i = 0; i < scene.getLayerCount(); ++i) {
+        const Layer& layer = scene.getLayer(i);
+        const QByteArray name = layer.name.toUtf8();
+        layers.push_back(LayerRecord{layer.color.rgba(),
+                                     (layer.visible ? 0u : kLayerHidden) | (layer.locked ? kLayerLocked : 0u),
+                                     static_cast<std::uint32_t>(layerNames.size()),
+                                     static_cast<std::uint32_t>(name.size())});
+        layerNames.append(name);
+    }
+    header.layerCount = static_cast<std::uint32_t>(layers.size());
+    header.currentLayer = scene.getCurrentLayer();
+    header.layerNamesSize = static_cast<std::uint32_t>(layerNames.size());
+    layoutColumns(header);
+
+    const void* columns[ColumnCount] = {
+        styles.data(), segments.x0Data(), segments.y0Data(), segments.x1Data(), segments.y1Data(),
+        segments.styleData(), segments.idData(), segments.layerData(), layers.data(), layerNames.constData()
+    };
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(error, QString("Не удалось открыть файл для записи: %1").arg(file.errorString()));
+    }
+
+    // Заголовок, затем каждый столбец одной записью; промежутки выравнивания заполняются нулями.
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) == sizeof(Header);
+    std::uint64_t position = sizeof(Header);
+    const char padding[kColumnAlignment] = {};
+    for (int column = 0; ok && column < ColumnCount; ++column) {
+        const auto gap = static_cast<qint64>(header.offsets[column] - position);
+        const auto bytes = static_cast<qint64>(elementCount(header, column) * elementSize(column));
+        ok = file.write(padding, gap) == gap &&
+             (bytes == 0 || file.write(static_cast<const char*>(columns[column]), bytes) == bytes);
+        position = header.offsets[column] + static_cast<std::uint64_t>(bytes);
+    }
+
+    if (!ok) {
+        file.cancelWriting();
+        return fail(error, QString("Ошибка записи файла: %1").arg(file.errorString()));
+    }
+    if (!file.commit()) {
+        return fail(error, QString("Не удалось сохранить файл: %1").arg(file.errorString()));
+    }
+    return true;
+}
+
+// Загружает сцену из файла, отображая его в память.
+bool SceneFile::load(Scene& scene, const QString& path, QString* error)
+{
+    UCAD_TRACE_SCOPE("SceneFile::load");
+    // Файл живет, пока на его отображение ссылается хотя бы один столбец хранилища.
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        return fail(error, QString("Не удалось открыть файл: %1").arg(file->errorString()));
+    }
+
+    const qint64 fileSize = file->size();
+    if (fileSize < static_cast<qint64>(sizeof(HeaderV1))) {
+        return fail(error, "Файл не является файлом сцены UniversityCAD.");
+    }
+
+    const uchar* base = file->map(0, fileSize);
+    if (!base) {
+        return fail(error, QString("Не удалось отобразить файл в память: %1").arg(file->errorString()));
+    }
+
+    // Общее начало заголовков всех версий определяет, какой из них записан в файле.
+    HeaderV1 prefix;
+    std::memcpy(&prefix, base, sizeof(HeaderV1));
+    if (std::memcmp(prefix.magic, kMagic, sizeof(kMagic)) != 0) {
+        return fail(error, "Файл не является файлом сцены UniversityCAD.");
+    }
+    if (prefix.byteOrder != kByteOrderMark) {
+        return fail(error, "Файл сцены записан на машине с другим порядком байтов.");
+    }
+
+    Header header;
+    int columnCount = ColumnCount;
+    if (prefix.version == kVersion1 && prefix.headerSize == sizeof(HeaderV1)) {
+        header = upgradeHeader(prefix);
+        columnCount = kColumnCountV1;
+    } else if (prefix.version == kVersion && prefix.headerSize == sizeof(Header) &&
+               fileSize >= static_cast<qint64>(sizeof(Header))) {
+        std::memcpy(&header, base, sizeof(Header));
+    } else {
+        return fail(error, QString("Неподдерживаемая версия файла сцены: %1.").arg(prefix.version));
+    }
+
+    // Смещения должны совпадать с раскладкой, вычисленной по заголовку: это проверяет
+    // и выравнивание, и то, что все столбцы помещаются в файл.
+    Header expected = header;
+    if (header.segmentCount > static_cast<std::uint64_t>(fileSize) / sizeof(double)) {
+        return fail(error, "Файл сцены поврежден: неверное количество отрезков.");
+    }
+    layoutColumns(expected, columnCount, header.headerSize);
+    if (expected.fileSize != header.fileSize || header.fileSize != static_cast<std::uint64_t>(fileSize) ||
+        std::memcmp(expected.offsets, header.offsets, sizeof(header.offsets)) != 0) {
+        return fail(error, "Файл сцены поврежден: неверная раскладка столбцов.");
+    }
+
+    const auto count = static_cast<std::size_t>(header.segmentCount);
+    const std::shared_ptr<const void> owner = file;
+    const auto* styleIndices = reinterpret_cast<const std::uint32_t*>(base + header.offsets[Style]);
+
+    // Индексы стилей проверяются заранее: обращение по неверному индексу было бы выходом
+    // за пределы таблицы. Столбец стилей вчетверо меньше координат, поэтому проверка дешева.
+    for (std::size_t row = 0; row < count; ++row) {
+        if (styleIndices[row] >= header.styleCount) {
+            return fail(error, "Файл сцены поврежден: неверный индекс стиля.");
+        }
+    }
+
+    // Слои: в файле версии 1 их нет, и все отрезки попадают на слой по умолчанию.
+    std::vector<Layer> layers;
+    Column<std::uint32_t> layerIds;
+    if (columnCount > LayerId) {
+        if (header.layerCount == 0 || header.currentLayer >= header.layerCount) {
+            return fail(error, "Файл сцены поврежден: неверная таблица слоев.");
+        }
+        const auto* records = reinterpret_cast<const LayerRecord*>(base + header.offsets[LayerTable]);
+        const auto* names = reinterpret_cast<const char*>(base + header.offsets[LayerNames]);
+        layers.reserve(header.layerCount);
+        for (std::uint32_t i = 0; i < header.layerCount; ++i) {
+            const LayerRecord& record = records[i];
+            if (record.nameOffset > header.layerNamesSize ||
+                record.nameSize > header.layerNamesSize - record.nameOffset) {
+                return fail(error, "Файл сцены поврежден: неверное имя слоя.");
+            }
+            Layer layer;
+            layer.name = QString::fromUtf8(names + record.nameOffset, static_cast<int>(record.nameSize));
+            layer.color = QColor::fromRgba(record.color);
+            layer.visible = (record.flags & kLayerHidden) == 0;
+            layer.locked = (record.flags & kLayerLocked) != 0;
+            layers.push_back(layer);
+        }
+
+        const auto* layerIndices = reinterpret_cast<const std::uint32_t*>(base + header.offsets[LayerId]);
+        for (std::size_t row = 0; row < count; ++row) {
+            if (layerIndices[row] >= header.layerCount) {
+                return fail(error, "Файл сцены поврежден: неверный номер слоя.");
+            }
+        }
+        layerIds = Column<std::uint32_t>::borrow(layerIndices, count, owner);
+    } else {
+        layerIds.reserve(count);
+        for (std::size_t row = 0; row < count; ++row) {
+            layerIds.push_back(0);
+        }
+    }
+
+    // ID проверяются одним проходом: каждый должен лежать в [1, nextId) и встречаться один раз,
+    // иначе поиск по ID и выдача новых ID сцены работали бы неверно.
+    if (header.nextId == 0 || header.nextId > count + kMaxIdGap) {
+        return fail(error, "Файл сцены поврежден: неверный следующий ID.");
+    }
+    const auto* ids = reinterpret_cast<const unsigned*>(base + header.offsets[Id]);
+    std::vector<bool> usedIds(header.nextId, false);
+    for (std::size_t row = 0; row < count; ++row) {
+        const unsigned id = ids[row];
+        if (id == 0 || id >= header.nextId || usedIds[id]) {
+            return fail(error, "Файл сцены поврежден: неверный или повторяющийся ID.");
+        }
+        usedIds[id] = true;
+    }
+
+    std::vector<QColor> styles;
+    styles.reserve(header.styleCount);
+    const auto* rgba = reinterpret_cast<const QRgb*>(base + header.offsets[Styles]);
+    for (std::uint32_t i = 0; i < header.styleCount; ++i) {
+        styles.push_back(QColor::fromRgba(rgba[i]));
+    }
+
+    auto doubles = [&](int column) {
+        return Column<double>::borrow(reinterpret_cast<const double*>(base + header.offsets[column]), count, owner);
+    };
+
+    SegmentStore store;
+    store.assign(std::move(styles), doubles(X0), doubles(Y0), doubles(X1), doubles(Y1),
+                 Column<std::uint32_t>::borrow(styleIndices, count, owner),
+                 Column<unsigned>::borrow(ids, count, owner),
+                 std::move(layerIds));
+
+    scene.replaceSegments(std::move(store), header.nextId, std::move(layers), header.currentLayer);
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QString>
+
+class Scene;
+
+// Собственный двоичный формат файла сцены (*.ucad).
+// Файл повторяет раскладку SegmentStore: за заголовком следуют таблица стилей и столбцы
+// координат, индексов стилей, ID и номеров слоев, каждый - непрерывным массивом, выровненным
+// по 64 байтам, а за ними - таблица слоев. Файлы версии 1 (без слоев) по-прежнему читаются.
+// При загрузке файл отображается в память, и хранилище ссылается на его столбцы напрямую:
+// координаты не разбираются и не копируются, а страницы подгружаются системой по мере обращения.
+// Первое изменение столбца копирует его в память процесса (см. Column).
+// Загрузка все же выполняет работу O(n): проверяет столбцы индексов стилей, слоев и ID
+// и заполняет таблицу дескрипторов сцены, а пространственные индексы слоев и таблица ID
+// строятся одним проходом по координатам при первом запросе к сцене.
+// Числа хранятся в порядке байтов машины; файл с другим порядком байтов отвергается.
+class SceneFile
+{
+public:
+    // Расширение файлов сцены (без точки).
+    static const char* extension();
+
+    // Сохраняет отрезки сцены в файл (других примитивов сцена пока не создает).
+    // Каждый столбец записывается одной последовательной операцией, а файл заменяется
+    // атомарно (QSaveFile). При ошибке возвращает false и описание ошибки в error.
+    static bool save(const Scene& scene, const QString& path, QString* error = nullptr);
+
+    // Загружает сцену из файла, заменяя ее содержимое (см. Scene::replaceSegments).
+    // Проверяются заголовок, размеры столбцов, индексы стилей и слоев и ID (каждый в [1, nextId)
+    // и без повторов); координаты не читаются.
+    // При ошибке сцена не изменяется, возвращается false и описание ошибки в error.
+    static bool load(Scene& scene, const QString& path, QString* error = nullptr);
+};
@@ -0,0 +1,148 @@
+#include "SegmentStore.h"
+
+#include <algorithm>
+#include <utility>
+
+// Добавляет отрезок в конец хранилища.
+std::size_t SegmentStore::append(Handle handle, unsigned id, double x0, double y0, double x1, double y1, const QColor& color,
+                                 std::uint32_t layer)
+{
+    m_x0.push_back(x0);
+    m_y0.push_back(y0);
+    m_x1.push_back(x1);
+    m_y1.push_back(y1);
+    m_style.push_back(internStyle(color));
+    m_layer.push_back(layer);
+    m_id.push_back(id);
+    m_handle.push_back(handle);
+    return m_id.size() - 1;
+}
+
+// Удаляет строку обменом с последней (O(1), порядок строк не сохраняется).
+void SegmentStore::removeRow(std::size_t row)
+{
+    const std::size_t last = m_id.size() - 1;
+    if (row != last) {
+        m_x0.set(row, m_x0[last]);
+        m_y0.set(row, m_y0[last]);
+        m_x1.set(row, m_x1[last]);
+        m_y1.set(row, m_y1[last]);
+        m_style.set(row, m_style[last]);
+        m_layer.set(row, m_layer[last]);
+        m_id.set(row, m_id[last]);
+        m_handle.set(row, m_handle[last]);
+    }
+    m_x0.pop_back();
+    m_y0.pop_back();
+    m_x1.pop_back();
+    m_y1.pop_back();
+    m_style.pop_back();
+    m_layer.pop_back();
+    m_id.pop_back();
+    m_handle.pop_back();
+}
+
+// Резервирует память во всех столбцах.
+void SegmentStore::reserve(std::size_t count)
+{
+    m_x0.reserve(count);
+    m_y0.reserve(count);
+    m_x1.reserve(count);
+    m_y1.reserve(count);
+    m_style.reserve(count);
+    m_layer.reserve(count);
+    m_id.reserve(count);
+    m_handle.reserve(count);
+}
+
+// Очищает все столбцы.
+void SegmentStore::clear()
+{
+    m_x0.clear();
+    m_y0.clear();
+    m_x1.clear();
+    m_y1.clear();
+    m_style.clear();
+    m_layer.clear();
+    m_id.clear();
+    m_handle.clear();
+}
+
+// Возвращает ограничивающий прямоугольник отрезка.
+QRectF SegmentStore::getBoundingBox(std::size_t row) const
+{
+    return QRectF(QPointF(std::min(m_x0[row], m_x1[row]), std::min(m_y0[row], m_y1[row])),
+                  QPointF(std::max(m_x0[row], m_x1[row]), std::max(m_y0[row], m_y1[row])));
+}
+
+// Устанавливает начальную точку отрезка.
+void SegmentStore::setStart(std::size_t row, double x, double y)
+{
+    m_x0.set(row, x);
+    m_y0.set(row, y);
+}
+
+// Устанавливает конечную точку отрезка.
+void SegmentStore::setEnd(std::size_t row, double x, double y)
+{
+    m_x1.set(row, x);
+    m_y1.set(row, y);
+}
+
+// Устанавливает цвет отрезка.
+void SegmentStore::setColor(std::size_t row, const QColor& color)
+{
+    m_style.set(row, internStyle(color));
+}
+
+// Устанавливает номер слоя отрезка.
+void SegmentStore::setLayer(std::size_t row, std::uint32_t layer)
+{
+    m_layer.set(row, layer);
+}
+
+// Возвращает индекс стиля для цвета (повторяющиеся цвета хранятся один раз).
+std::uint32_t SegmentStore::internStyle(const QColor& color)
+{
+    auto it = m_styleLookup.find(color.rgba());
+    if (it != m_styleLookup.end()) {
+        return it->second;
+    }
+
+    const auto index = static_cast<std::uint32_t>(m_styles.size());
+    m_styles.push_back(color);
+    m_styleLookup.emplace(color.rgba(), index);
+    return index;
+}
+
+// Заменяет содержимое хранилища готовыми столбцами.
+void SegmentStore::assign(std::vector<QColor> styles,
+                          Column<double> x0, Column<double> y0, Column<double> x1, Column<double> y1,
+                          Column<std::uint32_t> style, Column<unsigned> id, Column<std::uint32_t> layer)
+{
+    m_x0 = std::move(x0);
+    m_y0 = std::move(y0);
+    m_x1 = std::move(x1);
+    m_y1 = std::move(y1);
+    m_style = std::move(style);
+    m_id = std::move(id);
+    m_layer = std::move(layer);
+
+    m_handle.clear();
+
+    m_styles = std::move(styles);
+    m_styleLookup.clear();
+    for (std::size_t i = 0; i < m_styles.size(); ++i) {
+        m_styleLookup.emplace(m_styles[i].rgba(), static_cast<std::uint32_t>(i));
+    }
+}
+
+// Назначает строкам дескрипторы {row, generation}.
+void SegmentStore::resetHandles(std::uint32_t generation)
+{
+    m_handle.clear();
+    m_handle.reserve(m_id.size());
+    for (std::size_t row = 0; row < m_id.size(); ++row) {
+        m_handle.push_back(Handle{static_cast<std::uint32_t>(row), generation});
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Handle.h"
+#include "Column.h"
+
+#include <QColor>
+#include <QRectF>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+// Данные одного отрезка для пакетного добавления на сцену (см. Scene::addSegments)
+// и для записи его состояния в журнал отмены.
+struct SegmentRecord
+{
+    double x0, y0, x1, y1;
+    QRgb color;
+    unsigned id = 0;         // ID отрезка (0 - выдать новый при добавлении).
+    std::uint32_t layer = 0; // Номер слоя сцены.
+};
+
+// Компактное хранилище отрезков в виде структуры массивов (Structure of Arrays).
+// Координаты концов, индекс стиля, номер слоя и ID каждого отрезка лежат в отдельных непрерывных
+// массивах, что позволяет отрисовке, поиску и массовым преобразованиям
+// последовательно проходить по памяти без обращения к отдельным объектам в куче.
+// Строки не стабильны: при удалении на место удаленной строки переносится последняя.
+// Столбцы могут ссылаться на отображенный в память файл сцены без копирования (см. SceneFile).
+class SegmentStore
+{
+public:
+    // Значение, обозначающее отсутствующую строку.
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Добавляет отрезок в конец хранилища и возвращает номер его строки.
+    std::size_t append(Handle handle, unsigned id, double x0, double y0, double x1, double y1, const QColor& color,
+                       std::uint32_t layer);
+
+    // Удаляет строку, перенося на ее место последнюю строку хранилища.
+    void removeRow(std::size_t row);
+
+    // Резервирует память под указанное количество отрезков.
+    void reserve(std::size_t count);
+
+    // Удаляет все отрезки (таблица стилей сохраняется).
+    void clear();
+
+    // Возвращает количество отрезков.
+    std::size_t size() const { return m_id.size(); }
+
+    // Доступ к отдельным полям строки.
+    double getX0(std::size_t row) const { return m_x0[row]; }
+    double getY0(std::size_t row) const { return m_y0[row]; }
+    double getX1(std::size_t row) const { return m_x1[row]; }
+    double getY1(std::size_t row) const { return m_y1[row]; }
+    unsigned getID(std::size_t row) const { return m_id[row]; }
+    Handle getHandle(std::size_t row) const { return m_handle[row]; }
+    std::uint32_t getStyle(std::size_t row) const { return m_style[row]; }
+    std::uint32_t getLayer(std::size_t row) const { return m_layer[row]; }
+
+    // Возвращает цвет отрезка через таблицу стилей.
+    QColor getColor(std::size_t row) const { return m_styles[m_style[row]]; }
+
+    // Возвращает ограничивающий прямоугольник отрезка.
+    QRectF getBoundingBox(std::size_t row) const;
+
+    // Устанавливает начальную точку отрезка.
+    void setStart(std::size_t row, double x, double y);
+
+    // Устанавливает конечную точку отрезка.
+    void setEnd(std::size_t row, double x, double y);
+
+    // Устанавливает цвет отрезка.
+    void setColor(std::size_t row, const QColor& color);
+
+    // Устанавливает номер слоя отрезка.
+    void setLayer(std::size_t row, std::uint32_t layer);
+
+    // Непосредственный доступ к столбцам для потоковой обработки.
+    const double* x0Data() const { return m_x0.data(); }
+    const double* y0Data() const { return m_y0.data(); }
+    const double* x1Data() const { return m_x1.data(); }
+    const double* y1Data() const { return m_y1.data(); }
+    const std::uint32_t* styleData() const { return m_style.data(); }
+    const std::uint32_t* layerData() const { return m_layer.data(); }
+    const unsigned* idData() const { return m_id.data(); }
+    const Handle* handleData() const { return m_handle.data(); }
+
+    // Изменяемый доступ к столбцам координат для массовых преобразований
+    // (столбцы, ссылающиеся на файл, предварительно копируются в память).
+    double* mutableX0Data() { return m_x0.mutableData(); }
+    double* mutableY0Data() { return m_y0.mutableData(); }
+    double* mutableX1Data() { return m_x1.mutableData(); }
+    double* mutableY1Data() { return m_y1.mutableData(); }
+
+    // Возвращает таблицу стилей (цветов), на которую ссылаются индексы стилей.
+    const std::vector<QColor>& getStyles() const { return m_styles; }
+
+    // Возвращает индекс стиля для цвета, добавляя его в таблицу при необходимости.
+    std::uint32_t internStyle(const QColor& color);
+
+    // Заменяет содержимое хранилища готовыми столбцами (например, ссылающимися на файл).
+    // Все столбцы должны иметь одинаковую длину, а индексы стилей - указывать в styles.
+    // Дескрипторы строкам назначает владелец (см. resetHandles).
+    void assign(std::vector<QColor> styles,
+                Column<double> x0, Column<double> y0, Column<double> x1, Column<double> y1,
+                Column<std::uint32_t> style, Column<unsigned> id, Column<std::uint32_t> layer);
+
+    // Назначает строке row дескриптор {row, generation} (после assign).
+    void resetHandles(std::uint32_t generation);
+
+private:
+    // Столбцы координат концов отрезков.
+    Column<double> m_x0, m_y0, m_x1, m_y1;
+
+    // Столбец индексов в таблице стилей.
+    Column<std::uint32_t> m_style;
+
+    // Столбец номеров слоев.
+    Column<std::uint32_t> m_layer;
+
+    // Столбец стабильных ID отрезков (номера, отображаемые пользователю).
+    Column<unsigned> m_id;
+
+    // Столбец дескрипторов сцены (нужен, чтобы обновить таблицу дескрипторов при переносе строки).
+    Column<Handle> m_handle;
+
+    // Таблица стилей и обратный поиск индекса по цвету.
+    std::vector<QColor> m_styles;
+    std::unordered_map<QRgb, std::uint32_t> m_styleLookup;
+};
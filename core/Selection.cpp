@@ -0,0 +1,80 @@
+#include "Selection.h"
+
+// Добавляет примитив в выделение.
+void Selection::add(Handle handle)
+{
+    if (!handle.isValid() || contains(handle)) return;
+
+    if (handle.index >= m_positions.size()) {
+        m_positions.resize(handle.index + 1, kNotSelected);
+    }
+    m_positions[handle.index] = static_cast<std::uint32_t>(m_handles.size());
+    m_handles.push_back(handle);
+}
+
+// Удаляет примитив из выделения обменом с последним элементом.
+void Selection::remove(Handle handle)
+{
+    if (!contains(handle)) return;
+
+    const std::uint32_t position = m_positions[handle.index];
+    const Handle last = m_handles.back();
+    m_handles[position] = last;
+    m_positions[last.index] = position;
+    m_handles.pop_back();
+    m_positions[handle.index] = kNotSelected;
+}
+
+// Переключает выделение примитива.
+void Selection::toggle(Handle handle)
+{
+    if (contains(handle)) {
+        remove(handle);
+    } else {
+        add(handle);
+    }
+}
+
+// Заменяет выделение указанным набором; таблица позиций переиспользуется, а не создается заново.
+void Selection::assign(const std::vector<Handle>& handles, std::vector<Handle>* changed)
+{
+    if (changed) {
+        for (const Handle& handle : handles) {
+            if (handle.isValid() && !contains(handle)) changed->push_back(handle);
+        }
+    }
+
+    std::vector<Handle> previous;
+    previous.swap(m_handles);
+    for (const Handle& handle : previous) {
+        m_positions[handle.index] = kNotSelected;
+    }
+    m_handles.reserve(handles.size());
+    for (const Handle& handle : handles) {
+        add(handle);
+    }
+
+    if (changed) {
+        for (const Handle& handle : previous) {
+            if (!contains(handle)) changed->push_back(handle);
+        }
+    }
+}
+
+// Снимает выделение (сбрасываются только занятые позиции).
+void Selection::clear()
+{
+    for (const Handle& handle : m_handles) {
+        m_positions[handle.index] = kNotSelected;
+    }
+    m_handles.clear();
+}
+
+// Проверяет, выделен ли примитив (с учетом поколения дескриптора).
+bool Selection::contains(Handle handle) const
+{
+    if (!handle.isValid() || handle.index >= m_positions.size()) return false;
+
+    const std::uint32_t position = m_positions[handle.index];
+    return position != kNotSelected && m_handles[position] == handle;
+}
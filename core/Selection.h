@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Handle.h"
+
+#include <vector>
+#include <cstdint>
+
+// Набор выделенных примитивов сцены.
+// Добавление, удаление и проверка принадлежности выполняются за O(1):
+// для каждой ячейки дескриптора хранится позиция в плотном списке выделенных.
+class Selection
+{
+public:
+    // Добавляет примитив в выделение (повторное добавление игнорируется).
+    void add(Handle handle);
+
+    // Удаляет примитив из выделения.
+    void remove(Handle handle);
+
+    // Добавляет примитив, если его нет в выделении, иначе удаляет.
+    void toggle(Handle handle);
+
+    // Заменяет выделение указанным набором примитивов за O(старое + новое выделение).
+    // Если задан changed, в него добавляются примитивы, чье выделение изменилось.
+    void assign(const std::vector<Handle>& handles, std::vector<Handle>* changed = nullptr);
+
+    // Снимает выделение со всех примитивов.
+    void clear();
+
+    // Возвращает true, если примитив выделен.
+    bool contains(Handle handle) const;
+
+    // Возвращает выделенные примитивы (в порядке добавления, пока ничего не удалялось).
+    const std::vector<Handle>& getHandles() const { return m_handles; }
+
+    // Возвращает количество выделенных примитивов.
+    std::size_t size() const { return m_handles.size(); }
+
+    // Возвращает true, если выделение пусто.
+    bool isEmpty() const { return m_handles.empty(); }
+
+    // Возвращает единственный выделенный примитив или пустой дескриптор, если выделено не ровно один.
+    Handle single() const { return m_handles.size() == 1 ? m_handles.front() : Handle(); }
+
+private:
+    // Значение позиции для невыделенной ячейки.
+    static constexpr std::uint32_t kNotSelected = 0xFFFFFFFFu;
+
+    // Выделенные примитивы.
+    std::vector<Handle> m_handles;
+
+    // Позиция в m_handles по номеру ячейки дескриптора.
+    std::vector<std::uint32_t> m_positions;
+};
@@ -0,0 +1,497 @@
+#include "SnapIndex.h"
+#include "Scene.h"
+#include "SegmentStore.h"
+#include "Geometry.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// Сторона ячейки для пустой сцены (мировые единицы).
+constexpr double kDefaultCellSize = 64.0;
+
+// Среднее число точек в занятой области на ячейку, по которому подбирается размер ячейки.
+constexpr double kPointsPerCell = 4.0;
+
+// Наибольшее число ячеек сетки на точку (сверх kMinGridCells): ячейка укрупняется,
+// пока сетка разреженной сцены (например, с далекими выбросами) не уложится в предел.
+constexpr double kMaxCellsPerPoint = 2.0;
+constexpr double kMinGridCells = 1024.0;
+
+// Наибольшее число ячеек, просматриваемых при поиске; при большем радиусе (сильно уменьшенный вид)
+// точки берутся у кандидатов из пространственного индекса сцены.
+constexpr std::int64_t kMaxQueryCells = 64;
+
+// Наибольшее число изменений, применяемых к индексу по одному; при большем индекс строится заново.
+constexpr std::size_t kMaxIncrementalChanges = 16384;
+
+// Наибольшее число точек в массиве дополнений; при большем индекс строится заново.
+constexpr std::size_t kMaxExtraPoints = 3 * kMaxIncrementalChanges;
+
+// Число строк, обрабатываемых построением между проверками времени.
+constexpr std::size_t kBuildChunk = 4096;
+
+// Время построения, которое поиск тратит за вызов, пока индекс не построен (мс).
+constexpr double kQueryBuildBudgetMs = 2.0;
+
+// Наибольшее число отрезков у курсора, попарно проверяемых на пересечение.
+constexpr std::size_t kMaxIntersectionCandidates = 64;
+
+} // namespace
+
+// Помечает индекс устаревшим.
+void SnapIndex::invalidate()
+{
+    m_ready = false;
+    m_phase = BuildPhase::Bounds;
+    m_buildRow = 0;
+    m_cellOffsets.clear();
+    m_entries.clear();
+    m_extra.clear();
+    m_fillCursor.clear();
+    m_pointCount = 0;
+    m_removedCount = 0;
+}
+
+// Продолжает построение индекса порциями строк, пока не истечет бюджет времени.
+bool SnapIndex::build(const Scene& scene, double budgetMs)
+{
+    if (m_ready) return true;
+    UCAD_TRACE_SCOPE("SnapIndex::build");
+
+    const SegmentStore& segments = scene.getSegments();
+    const std::size_t count = segments.size();
+    // Построение обрабатывает строки по порядку; если сцена изменилась без уведомления,
+    // начатые проходы недействительны.
+    if (m_buildRow > count) invalidate();
+
+    const auto start = std::chrono::steady_clock::now();
+    auto inBudget = [&]() {
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() < budgetMs;
+    };
+
+    // Точки строки: два конца и середина.
+    auto forEachPoint = [&](std::size_t row, auto&& visit) {
+        const double x0 = segments.getX0(row);
+        const double y0 = segments.getY0(row);
+        const double x1 = segments.getX1(row);
+        const double y1 = segments.getY1(row);
+        visit(x0, y0, SnapKind::Endpoint);
+        visit(x1, y1, SnapKind::Endpoint);
+        visit((x0 + x1) * 0.5, (y0 + y1) * 0.5, SnapKind::Midpoint);
+    };
+
+    // Смена этапа без обработки строк не расходует бюджет.
+    bool idle = false;
+    do {
+        const std::size_t end = std::min(count, m_buildRow + kBuildChunk);
+        idle = end == m_buildRow;
+        switch (m_phase) {
+        case BuildPhase::Bounds:
+            if (m_buildRow == 0) {
+                m_minX = std::numeric_limits<double>::max();
+                m_minY = std::numeric_limits<double>::max();
+                m_maxX = std::numeric_limits<double>::lowest();
+                m_maxY = std::numeric_limits<double>::lowest();
+            }
+            // Охват конечных концов отрезков (бесконечные точки попадают в крайние ячейки).
+            for (std::size_t row = m_buildRow; row < end; ++row) {
+                forEachPoint(row, [&](double x, double y, SnapKind) {
+                    if (!std::isfinite(x) || !std::isfinite(y)) return;
+                    m_minX = std::min(m_minX, x);
+                    m_maxX = std::max(m_maxX, x);
+                    m_minY = std::min(m_minY, y);
+                    m_maxY = std::max(m_maxY, y);
+                });
+            }
+            m_buildRow = end;
+            if (m_buildRow == count) {
+                layoutGrid(3 * count);
+                m_cellOffsets.assign(static_cast<std::size_t>(m_gridWidth * m_gridHeight) + 1, 0);
+                m_phase = BuildPhase::Count;
+                m_buildRow = 0;
+            }
+            break;
+
+        case BuildPhase::Count:
+            // Число точек в каждой ячейке (в m_cellOffsets[cell + 1]).
+            for (std::size_t row = m_buildRow; row < end; ++row) {
+                forEachPoint(row, [&](double x, double y, SnapKind) { ++m_cellOffsets[gridCellOf(x, y) + 1]; });
+            }
+            m_buildRow = end;
+            if (m_buildRow == count) {
+                std::partial_sum(m_cellOffsets.begin(), m_cellOffsets.end(), m_cellOffsets.begin());
+                m_entries.resize(m_cellOffsets.back());
+                m_fillCursor.assign(m_cellOffsets.begin(), m_cellOffsets.end() - 1);
+                m_phase = BuildPhase::Fill;
+                m_buildRow = 0;
+            }
+            break;
+
+        case BuildPhase::Fill:
+            // Раскладка точек по ячейкам.
+            for (std::size_t row = m_buildRow; row < end; ++row) {
+                const Handle handle = segments.getHandle(row);
+                forEachPoint(row, [&](double x, double y, SnapKind kind) {
+                    m_entries[m_fillCursor[gridCellOf(x, y)]++] = Entry{handle, kind};
+                });
+            }
+            m_buildRow = end;
+            if (m_buildRow == count) {
+                m_fillCursor.clear();
+                m_fillCursor.shrink_to_fit();
+                m_pointCount = m_entries.size();
+                m_removedCount = 0;
+                m_buildRow = 0;
+                m_ready = true;
+            }
+            break;
+        }
+    } while (!m_ready && (idle || inBudget()));
+    return m_ready;
+}
+
+// Возвращает true, если индекс построен.
+bool SnapIndex::isReady() const
+{
+    return m_ready;
+}
+
+// Помечает удаленными точки прежнего положения измененных отрезков и добавляет точки нового.
+void SnapIndex::applyChange(const Scene& scene, const SceneChange& change)
+{
+    UCAD_TRACE_SCOPE("SnapIndex::applyChange");
+    // Незавершенное построение прочитало часть прежних строк - оно начинается заново.
+    if (!m_ready) {
+        m_phase = BuildPhase::Bounds;
+        m_buildRow = 0;
+        return;
+    }
+
+    if (change.reset || change.size() > kMaxIncrementalChanges) {
+        invalidate();
+        return;
+    }
+
+    // Сначала удаляются все прежние точки, затем добавляются новые: массив дополнений
+    // упорядочивается один раз на уведомление.
+    for (const auto& entry : change.removed) removeSegment(entry.handle, entry.oldBox);
+    for (const auto& entry : change.modified) removeSegment(entry.handle, entry.oldBox);
+    m_extra.erase(std::remove_if(m_extra.begin(), m_extra.end(),
+                                 [](const ExtraEntry& extra) { return !extra.entry.handle.isValid(); }),
+                  m_extra.end());
+
+    const std::size_t sorted = m_extra.size();
+    for (const auto& entry : change.modified) insertSegment(scene, entry.handle);
+    for (const auto& entry : change.added) insertSegment(scene, entry.handle);
+    auto byKey = [](const ExtraEntry& a, const ExtraEntry& b) { return a.key < b.key; };
+    std::sort(m_extra.begin() + static_cast<std::ptrdiff_t>(sorted), m_extra.end(), byKey);
+    std::inplace_merge(m_extra.begin(), m_extra.begin() + static_cast<std::ptrdiff_t>(sorted), m_extra.end(), byKey);
+
+    compactIfNeeded();
+}
+
+// Ищет точку привязки рядом с курсором.
+SnapResult SnapIndex::findSnap(const Scene& scene, const QPointF& point, double radius, double gridStep,
+                               unsigned modes)
+{
+    UCAD_TRACE_SCOPE("SnapIndex::findSnap");
+    SnapResult best;
+    if (!(radius > 0.0)) return best;
+    if (!m_ready) build(scene, kQueryBuildBudgetMs);
+
+    const SegmentStore& segments = scene.getSegments();
+    const double px = point.x();
+    const double py = point.y();
+    double bestDistance = radius * radius;
+
+    // Кандидат принимается, если он не дальше радиуса и ближе текущего лучшего.
+    auto consider = [&](SnapKind kind, double x, double y, Handle handle) {
+        const double dx = x - px;
+        const double dy = y - py;
+        const double distance = dx * dx + dy * dy;
+        if (distance < bestDistance || (distance == bestDistance && !best.isValid())) {
+            bestDistance = distance;
+            best.kind = kind;
+            best.point = QPointF(x, y);
+            best.handle = handle;
+        }
+    };
+
+    // Концы и середина отрезка в строке row.
+    auto considerRow = [&](std::size_t row, Handle handle) {
+        const double x0 = segments.getX0(row);
+        const double y0 = segments.getY0(row);
+        const double x1 = segments.getX1(row);
+        const double y1 = segments.getY1(row);
+        if (modes & Endpoints) {
+            consider(SnapKind::Endpoint, x0, y0, handle);
+            consider(SnapKind::Endpoint, x1, y1, handle);
+        }
+        if (modes & Midpoints) consider(SnapKind::Midpoint, (x0 + x1) * 0.5, (y0 + y1) * 0.5, handle);
+    };
+
+    const QRectF area(px - radius, py - radius, 2.0 * radius, 2.0 * radius);
+    const std::int64_t left = cellCoord(area.left());
+    const std::int64_t right = cellCoord(area.right());
+    const std::int64_t top = cellCoord(area.top());
+    const std::int64_t bottom = cellCoord(area.bottom());
+    const bool useCells = m_ready && (right - left + 1) * (bottom - top + 1) <= kMaxQueryCells;
+    const bool needSegments = (modes & (Intersections | Nearest)) != 0;
+
+    // Кандидаты из индекса сцены нужны для пересечений и ближайших точек,
+    // а при слишком крупном радиусе или непостроенном индексе - и для концов и середин.
+    m_candidates.clear();
+    if (needSegments || !useCells) scene.queryPrimitives(area, m_candidates);
+
+    if (modes & (Endpoints | Midpoints)) {
+        if (useCells) {
+            auto considerEntry = [&](const Entry& entry) {
+                // Удаленная точка.
+                if (!entry.handle.isValid()) return;
+                const std::size_t row = scene.getSegmentRow(entry.handle);
+                if (row == SegmentStore::npos) return;
+                // Точки скрытых слоев остаются в индексе, но не привязывают.
+                if (!scene.getLayer(segments.getLayer(row)).visible) return;
+                if (entry.kind == SnapKind::Endpoint && (modes & Endpoints)) {
+                    consider(SnapKind::Endpoint, segments.getX0(row), segments.getY0(row), entry.handle);
+                    consider(SnapKind::Endpoint, segments.getX1(row), segments.getY1(row), entry.handle);
+                } else if (entry.kind == SnapKind::Midpoint && (modes & Midpoints)) {
+                    consider(SnapKind::Midpoint, (segments.getX0(row) + segments.getX1(row)) * 0.5,
+                             (segments.getY0(row) + segments.getY1(row)) * 0.5, entry.handle);
+                }
+            };
+            auto byKey = [](const ExtraEntry& extra, std::uint64_t key) { return extra.key < key; };
+            for (std::int64_t cy = top; cy <= bottom; ++cy) {
+                for (std::int64_t cx = left; cx <= right; ++cx) {
+                    const std::int64_t cell = gridCell(cx, cy);
+                    if (cell >= 0) {
+                        const std::uint32_t first = m_cellOffsets[static_cast<std::size_t>(cell)];
+                        const std::uint32_t last = m_cellOffsets[static_cast<std::size_t>(cell) + 1];
+                        for (std::uint32_t i = first; i < last; ++i) considerEntry(m_entries[i]);
+                    }
+                    if (m_extra.empty()) continue;
+                    const std::uint64_t key = cellKey(cx, cy);
+                    for (auto extra = std::lower_bound(m_extra.begin(), m_extra.end(), key, byKey);
+                         extra != m_extra.end() && extra->key == key; ++extra) {
+                        considerEntry(extra->entry);
+                    }
+                }
+            }
+        } else {
+            for (const Handle& handle : m_candidates) {
+                const std::size_t row = scene.getSegmentRow(handle);
+                if (row != SegmentStore::npos) considerRow(row, handle);
+            }
+        }
+    }
+
+    if (needSegments) {
+        // Отрезки, проходящие в пределах радиуса от курсора.
+        m_nearRows.clear();
+        for (const Handle& handle : m_candidates) {
+            const std::size_t row = scene.getSegmentRow(handle);
+            if (row == SegmentStore::npos) continue;
+            const double distance = distanceToSegmentSquared(px, py, segments.getX0(row), segments.getY0(row),
+                                                             segments.getX1(row), segments.getY1(row));
+            if (distance <= radius * radius) m_nearRows.push_back(row);
+        }
+
+        // Пересечения - только среди ближайших к курсору отрезков, чтобы поиск оставался дешевым.
+        if ((modes & Intersections) && m_nearRows.size() >= 2) {
+            const std::size_t count = std::min(m_nearRows.size(), kMaxIntersectionCandidates);
+            for (std::size_t i = 0; i < count; ++i) {
+                const std::size_t a = m_nearRows[i];
+                for (std::size_t j = i + 1; j < count; ++j) {
+                    const std::size_t b = m_nearRows[j];
+                    double x = 0.0;
+                    double y = 0.0;
+                    if (intersectSegments(segments.getX0(a), segments.getY0(a), segments.getX1(a), segments.getY1(a),
+                                          segments.getX0(b), segments.getY0(b), segments.getX1(b), segments.getY1(b),
+                                          x, y)) {
+                        consider(SnapKind::Intersection, x, y, segments.getHandle(a));
+                    }
+                }
+            }
+        }
+
+        // Ближайшая точка отрезка - только если рядом нет характерных точек.
+        if ((modes & Nearest) && !best.isValid()) {
+            for (const std::size_t row : m_nearRows) {
+                const double x0 = segments.getX0(row);
+                const double y0 = segments.getY0(row);
+                const double dx = segments.getX1(row) - x0;
+                const double dy = segments.getY1(row) - y0;
+                const double lengthSquared = dx * dx + dy * dy;
+                const double t = lengthSquared > 0.0
+                    ? std::clamp(((px - x0) * dx + (py - y0) * dy) / lengthSquared, 0.0, 1.0) : 0.0;
+                consider(SnapKind::Nearest, x0 + t * dx, y0 + t * dy, segments.getHandle(row));
+            }
+        }
+    }
+
+    // Узел сетки - если курсор не у объектов.
+    if ((modes & GridNodes) && !best.isValid() && gridStep > 0.0) {
+        consider(SnapKind::Grid, std::round(px / gridStep) * gridStep, std::round(py / gridStep) * gridStep, Handle());
+    }
+    return best;
+}
+
+// Возвращает сторону ячейки сетки.
+double SnapIndex::getCellSize() const
+{
+    return m_cellSize;
+}
+
+// Возвращает количество точек в индексе.
+std::size_t SnapIndex::getPointCount() const
+{
+    return m_pointCount;
+}
+
+// Выбирает размер ячейки и охват сетки по охвату точек (m_minX..m_maxY).
+void SnapIndex::layoutGrid(std::size_t pointCount)
+{
+    if (pointCount == 0 || !(m_minX <= m_maxX) || !(m_minY <= m_maxY)) {
+        m_cellSize = kDefaultCellSize;
+        m_gridLeft = m_gridTop = 0;
+        m_gridWidth = m_gridHeight = pointCount == 0 ? 0 : 1;
+        return;
+    }
+
+    // Ячейка подбирается так, чтобы в среднем на нее приходилось несколько точек;
+    // для вытянутой в линию сцены площадь заменяется длиной охвата.
+    const double points = static_cast<double>(pointCount);
+    const double width = m_maxX - m_minX;
+    const double height = m_maxY - m_minY;
+    double cellSize = std::max(std::sqrt(width * height * kPointsPerCell / points),
+                               std::max(width, height) * kPointsPerCell / points);
+    if (!(cellSize > 0.0) || !std::isfinite(cellSize)) cellSize = kDefaultCellSize;
+    m_cellSize = std::exp2(std::ceil(std::log2(cellSize)));
+
+    // Плотная таблица смещений покрывает весь охват, поэтому ее размер ограничивается.
+    const double maxCells = points * kMaxCellsPerPoint + kMinGridCells;
+    for (;;) {
+        m_gridLeft = cellCoord(m_minX);
+        m_gridTop = cellCoord(m_minY);
+        m_gridWidth = cellCoord(m_maxX) - m_gridLeft + 1;
+        m_gridHeight = cellCoord(m_maxY) - m_gridTop + 1;
+        if (static_cast<double>(m_gridWidth) * static_cast<double>(m_gridHeight) <= maxCells) break;
+        m_cellSize *= 2.0;
+    }
+}
+
+// Возвращает номер ячейки сетки или -1 для ячейки вне сетки.
+std::int64_t SnapIndex::gridCell(std::int64_t cx, std::int64_t cy) const
+{
+    cx -= m_gridLeft;
+    cy -= m_gridTop;
+    if (cx < 0 || cx >= m_gridWidth || cy < 0 || cy >= m_gridHeight) return -1;
+    return cy * m_gridWidth + cx;
+}
+
+// Возвращает номер ячейки сетки для точки построения.
+std::size_t SnapIndex::gridCellOf(double x, double y) const
+{
+    // Точки лежат в охвате; ограничение защищает от нечисловых координат.
+    const std::int64_t cx = std::clamp<std::int64_t>(cellCoord(x) - m_gridLeft, 0, m_gridWidth - 1);
+    const std::int64_t cy = std::clamp<std::int64_t>(cellCoord(y) - m_gridTop, 0, m_gridHeight - 1);
+    return static_cast<std::size_t>(cy * m_gridWidth + cx);
+}
+
+// Добавляет концы и середину отрезка.
+void SnapIndex::insertSegment(const Scene& scene, Handle handle)
+{
+    const std::size_t row = scene.getSegmentRow(handle);
+    if (row == SegmentStore::npos) return;
+
+    const SegmentStore& segments = scene.getSegments();
+    const double x0 = segments.getX0(row);
+    const double y0 = segments.getY0(row);
+    const double x1 = segments.getX1(row);
+    const double y1 = segments.getY1(row);
+    insertPoint(x0, y0, Entry{handle, SnapKind::Endpoint});
+    insertPoint(x1, y1, Entry{handle, SnapKind::Endpoint});
+    insertPoint((x0 + x1) * 0.5, (y0 + y1) * 0.5, Entry{handle, SnapKind::Midpoint});
+}
+
+// Удаляет точки отрезка по его прежнему прямоугольнику.
+void SnapIndex::removeSegment(Handle handle, const QRectF& box)
+{
+    // Концы отрезка лежат в противоположных углах прямоугольника (неизвестно, в каких),
+    // поэтому проверяются все четыре угла.
+    removePoints(handle, box.left(), box.top());
+    removePoints(handle, box.right(), box.top());
+    removePoints(handle, box.left(), box.bottom());
+    removePoints(handle, box.right(), box.bottom());
+    removePoints(handle, box.center().x(), box.center().y());
+}
+
+// Добавляет точку в конец массива дополнений (applyChange упорядочивает его).
+void SnapIndex::insertPoint(double x, double y, const Entry& entry)
+{
+    m_extra.push_back(ExtraEntry{cellKey(cellCoord(x), cellCoord(y)), entry});
+    ++m_pointCount;
+}
+
+// Помечает удаленными точки отрезка в ячейках около (x, y).
+void SnapIndex::removePoints(Handle handle, double x, double y)
+{
+    // Углы и центр прямоугольника могут отличаться от точек отрезка на ошибку округления,
+    // поэтому просматриваются все ячейки в малой окрестности.
+    const double epsilon = 1e-9 * std::max({std::abs(x), std::abs(y), m_cellSize});
+    auto byKey = [](const ExtraEntry& extra, std::uint64_t key) { return extra.key < key; };
+    for (std::int64_t cy = cellCoord(y - epsilon); cy <= cellCoord(y + epsilon); ++cy) {
+        for (std::int64_t cx = cellCoord(x - epsilon); cx <= cellCoord(x + epsilon); ++cx) {
+            const std::int64_t cell = gridCell(cx, cy);
+            if (cell >= 0) {
+                const std::uint32_t first = m_cellOffsets[static_cast<std::size_t>(cell)];
+                const std::uint32_t last = m_cellOffsets[static_cast<std::size_t>(cell) + 1];
+                for (std::uint32_t i = first; i < last; ++i) {
+                    if (m_entries[i].handle != handle) continue;
+                    m_entries[i].handle = Handle();
+                    ++m_removedCount;
+                    --m_pointCount;
+                }
+            }
+
+            // Точки из массива дополнений удаляются в applyChange после всех пометок.
+            const std::uint64_t key = cellKey(cx, cy);
+            for (auto extra = std::lower_bound(m_extra.begin(), m_extra.end(), key, byKey);
+                 extra != m_extra.end() && extra->key == key; ++extra) {
+                if (extra->entry.handle != handle) continue;
+                extra->entry.handle = Handle();
+                --m_pointCount;
+            }
+        }
+    }
+}
+
+// Строит индекс заново, если поиск стал бы просматривать слишком много лишних точек.
+void SnapIndex::compactIfNeeded()
+{
+    if (m_extra.size() > kMaxExtraPoints || m_removedCount > std::max(kMaxExtraPoints, m_entries.size() / 4)) {
+        invalidate();
+    }
+}
+
+// Возвращает координату ячейки (ограничена диапазоном 32-битных чисел).
+std::int64_t SnapIndex::cellCoord(double value) const
+{
+    const double cell = std::floor(value / m_cellSize);
+    if (!(cell > std::numeric_limits<std::int32_t>::min())) return std::numeric_limits<std::int32_t>::min();
+    if (cell > std::numeric_limits<std::int32_t>::max()) return std::numeric_limits<std::int32_t>::max();
+    return static_cast<std::int64_t>(cell);
+}
+
+// Упаковывает координаты ячейки в ключ.
+std::uint64_t SnapIndex::cellKey(std::int64_t cx, std::int64_t cy)
+{
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) | static_cast<std::uint32_t>(cy);
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Enums.h"
+#include "Handle.h"
+#include "SceneChange.h"
+
+#include <QPointF>
+#include <QRectF>
+
+#include <vector>
+#include <cstdint>
+
+class Scene;
+
+// Найденная точка привязки.
+struct SnapResult
+{
+    SnapKind kind = SnapKind::None;
+    QPointF point;  // Точка привязки в мировых координатах.
+    Handle handle;  // Отрезок, к которому выполнена привязка (пустой для узла сетки).
+
+    // Возвращает true, если привязка найдена.
+    bool isValid() const { return kind != SnapKind::None; }
+};
+
+// Индекс точек привязки: концы и середины отрезков в пространственной сетке
+// с квадратными ячейками. Поиск точек рядом с курсором просматривает несколько ячеек,
+// поэтому выполняется на каждое движение мыши независимо от размера сцены.
+// Ячейки хранятся плоско: точки всех ячеек лежат в одном массиве, упорядоченном по ячейкам,
+// а смещения ячеек - в плотной таблице по охвату сцены. Полное построение (после загрузки
+// или массового изменения) выполняется порциями с ограничением времени (build), а пока
+// оно не завершено, концы и середины берутся у кандидатов из пространственного индекса сцены.
+// Построенный индекс обновляется по уведомлениям сцены (SceneChange): точки прежнего
+// положения отрезка помечаются удаленными, а точки нового добавляются в небольшой
+// упорядоченный по ячейкам массив дополнений; когда он разрастается, индекс строится заново.
+// Пересечения и ближайшие точки отрезков вычисляются при поиске по кандидатам
+// из пространственного индекса сцены, узлы сетки - арифметически. Объекты скрытых слоев
+// не привязывают: их точки остаются в индексе и отбрасываются при поиске.
+class SnapIndex
+{
+public:
+    // Режимы привязки (битовая маска).
+    enum Mode : unsigned
+    {
+        Endpoints = 1u << 0,
+        Midpoints = 1u << 1,
+        Intersections = 1u << 2,
+        Nearest = 1u << 3,
+        GridNodes = 1u << 4,
+        AllModes = Endpoints | Midpoints | Intersections | Nearest | GridNodes
+    };
+
+    // Помечает индекс устаревшим: он будет построен заново (см. build).
+    void invalidate();
+
+    // Продолжает построение индекса не дольше budgetMs миллисекунд.
+    // Возвращает true, если индекс построен. Изменение сцены во время построения начинает его заново.
+    bool build(const Scene& scene, double budgetMs);
+
+    // Возвращает true, если индекс построен.
+    bool isReady() const;
+
+    // Обновляет индекс по изменениям сцены (вызывается после уведомления сцены).
+    void applyChange(const Scene& scene, const SceneChange& change);
+
+    // Возвращает точку привязки для курсора point в пределах radius (мировые единицы).
+    // Приоритет: ближайший конец, середина или пересечение; затем ближайшая точка отрезка;
+    // затем узел сетки с шагом gridStep (0 - без сетки). Если индекс не построен, поиск
+    // продолжает его построение коротким шагом, а точки берет из индекса сцены.
+    SnapResult findSnap(const Scene& scene, const QPointF& point, double radius, double gridStep,
+                        unsigned modes = AllModes);
+
+    // Возвращает сторону ячейки сетки в мировых единицах.
+    double getCellSize() const;
+
+    // Возвращает количество точек в индексе.
+    std::size_t getPointCount() const;
+
+private:
+    // Точка привязки в ячейке: координаты читаются из хранилища отрезков по дескриптору.
+    // Удаленная точка помечается пустым дескриптором.
+    struct Entry
+    {
+        Handle handle;
+        SnapKind kind;
+    };
+
+    // Точка, добавленная после построения, с ключом ее ячейки.
+    struct ExtraEntry
+    {
+        std::uint64_t key;
+        Entry entry;
+    };
+
+    // Этап построения индекса.
+    enum class BuildPhase { Bounds, Count, Fill };
+
+    // Выбирает размер ячейки и охват сетки по охвату точек сцены.
+    void layoutGrid(std::size_t pointCount);
+
+    // Возвращает номер ячейки сетки по координатам ячейки или -1, если ячейка вне сетки.
+    std::int64_t gridCell(std::int64_t cx, std::int64_t cy) const;
+
+    // Возвращает номер ячейки сетки для точки (точка построения всегда лежит в сетке).
+    std::size_t gridCellOf(double x, double y) const;
+
+    // Добавляет точки отрезка (в массив дополнений).
+    void insertSegment(const Scene& scene, Handle handle);
+
+    // Удаляет точки отрезка, занимавшего прямоугольник box (концы - в его углах, середина - в центре).
+    void removeSegment(Handle handle, const QRectF& box);
+
+    // Добавляет точку в массив дополнений.
+    void insertPoint(double x, double y, const Entry& entry);
+
+    // Удаляет точки отрезка из ячеек около (x, y).
+    void removePoints(Handle handle, double x, double y);
+
+    // Строит индекс заново, если дополнений или удаленных точек стало слишком много.
+    void compactIfNeeded();
+
+    // Возвращает координату ячейки по мировой координате.
+    std::int64_t cellCoord(double value) const;
+
+    // Возвращает ключ ячейки.
+    static std::uint64_t cellKey(std::int64_t cx, std::int64_t cy);
+
+    double m_cellSize = 64.0;
+
+    // Сетка построения: первая ячейка, размеры в ячейках, смещения ячеек в m_entries
+    // (ячейка i занимает [m_cellOffsets[i], m_cellOffsets[i + 1])) и точки по ячейкам.
+    std::int64_t m_gridLeft = 0;
+    std::int64_t m_gridTop = 0;
+    std::int64_t m_gridWidth = 0;
+    std::int64_t m_gridHeight = 0;
+    std::vector<std::uint32_t> m_cellOffsets;
+    std::vector<Entry> m_entries;
+
+    // Точки, добавленные после построения, упорядоченные по ключу ячейки.
+    std::vector<ExtraEntry> m_extra;
+
+    std::size_t m_pointCount = 0;   // Живые точки.
+    std::size_t m_removedCount = 0; // Удаленные точки, оставшиеся в m_entries.
+
+    // Состояние построения: готовность, этап, следующая строка хранилища, охват точек
+    // и позиции записи в ячейки на этапе заполнения.
+    bool m_ready = false;
+    BuildPhase m_phase = BuildPhase::Bounds;
+    std::size_t m_buildRow = 0;
+    double m_minX = 0.0;
+    double m_minY = 0.0;
+    double m_maxX = 0.0;
+    double m_maxY = 0.0;
+    std::vector<std::uint32_t> m_fillCursor;
+
+    // Буферы поиска (переиспользуются между движениями мыши).
+    std::vector<Handle> m_candidates;
+    std::vector<std::size_t> m_nearRows;
+};
@@ -0,0 +1,341 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Максимальное число записей в листе до его разделения.
+constexpr std::size_t kNodeCapacity = 16;
+
+// Максимальная глубина дерева (защита от бесконечного деления совпадающих объектов).
+constexpr int kMaxDepth = 24;
+
+// Минимальный размер корня при создании индекса.
+constexpr double kInitialRootSize = 1024.0;
+
+// Проверяет, что прямоугольник outer полностью содержит inner (границы включительно).
+bool containsBox(const QRectF& outer, const QRectF& inner)
+{
+    return outer.left() <= inner.left() && inner.right() <= outer.right() &&
+           outer.top() <= inner.top() && inner.bottom() <= outer.bottom();
+}
+
+// Проверяет пересечение прямоугольников. В отличие от QRectF::intersects
+// корректно работает с вырожденными (нулевой ширины или высоты) прямоугольниками,
+// например, с рамкой горизонтального отрезка.
+bool overlapsBox(const QRectF& a, const QRectF& b)
+{
+    return a.left() <= b.right() && b.left() <= a.right() &&
+           a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+// Проверяет, что все координаты прямоугольника конечны.
+bool isFiniteBox(const QRectF& box)
+{
+    return std::isfinite(box.left()) && std::isfinite(box.right()) &&
+           std::isfinite(box.top()) && std::isfinite(box.bottom());
+}
+
+} // namespace
+
+// Узел квадродерева: либо лист, либо узел с четырьмя потомками.
+// Объект хранится в самом глубоком узле, который целиком его покрывает.
+struct SpatialIndex::Node
+{
+    Node(const SpatialIndex* ownerIndex, const QRectF& nodeBounds, int nodeDepth, Node* parentNode)
+        : owner(ownerIndex), bounds(nodeBounds), depth(nodeDepth), parent(parentNode) {}
+
+    // Возвращает true, если у узла нет потомков.
+    bool isLeaf() const { return !children[0]; }
+
+    // Возвращает границы дочернего квадранта (бит 0 - правая половина, бит 1 - нижняя).
+    QRectF quadrant(int index) const
+    {
+        const double halfWidth = bounds.width() / 2.0;
+        const double halfHeight = bounds.height() / 2.0;
+        return QRectF(bounds.left() + ((index & 1) ? halfWidth : 0.0),
+                      bounds.top() + ((index & 2) ? halfHeight : 0.0),
+                      halfWidth, halfHeight);
+    }
+
+    const SpatialIndex* owner; // Индекс, которому принадлежит узел (таблица узлов может быть общей).
+    QRectF bounds;
+    int depth;
+    Node* parent;
+    std::vector<Entry> entries;
+    std::unique_ptr<Node> children[4];
+};
+
+// Конструктор пустого индекса.
+SpatialIndex::SpatialIndex() : m_locations(std::make_shared<LocationTable>()) {}
+
+// Конструктор пустого индекса с общей таблицей узлов.
+SpatialIndex::SpatialIndex(std::shared_ptr<LocationTable> locations) : m_locations(std::move(locations)) {}
+
+// Деструктор.
+SpatialIndex::~SpatialIndex() = default;
+
+// Добавляет объект в индекс.
+void SpatialIndex::insert(Handle handle, const QRectF& box)
+{
+    // Объекты с некорректными координатами не индексируются (их невозможно найти по области).
+    if (!isFiniteBox(box)) return;
+
+    if (findNode(handle)) {
+        update(handle, box);
+        return;
+    }
+
+    growToContain(box);
+    insertEntry(m_root.get(), Entry{box, handle});
+}
+
+// Удаляет объект из индекса.
+void SpatialIndex::remove(Handle handle)
+{
+    Node* node = findNode(handle);
+    if (!node) return;
+
+    auto& entries = node->entries;
+    auto it = std::find_if(entries.begin(), entries.end(),
+                           [handle](const Entry& entry) { return entry.handle == handle; });
+    // Ячейка могла быть занята другим поколением - тогда дескриптор устарел.
+    if (it == entries.end()) return;
+
+    // Порядок записей внутри узла не важен, поэтому удаляем обменом с последней.
+    *it = entries.back();
+    entries.pop_back();
+    (*m_locations)[handle.index] = nullptr;
+    --m_size;
+
+    if (node->parent) {
+        tryMerge(node->parent);
+    }
+}
+
+// Обновляет прямоугольник объекта.
+void SpatialIndex::update(Handle handle, const QRectF& box)
+{
+    Node* node = findNode(handle);
+    if (node && isFiniteBox(box)) {
+        // Если объект остается в пределах своего узла и не может опуститься ниже,
+        // достаточно обновить прямоугольник на месте.
+        if (containsBox(node->bounds, box) && node->isLeaf()) {
+            for (auto& entry : node->entries) {
+                if (entry.handle == handle) {
+                    entry.box = box;
+                    return;
+                }
+            }
+        }
+    }
+
+    remove(handle);
+    insert(handle, box);
+}
+
+// Возвращает прямоугольник объекта, сохраненный в индексе.
+QRectF SpatialIndex::getBoundingBox(Handle handle) const
+{
+    const Node* node = findNode(handle);
+    if (!node) return QRectF();
+
+    for (const auto& entry : node->entries) {
+        if (entry.handle == handle) {
+            return entry.box;
+        }
+    }
+    return QRectF();
+}
+
+// Выполняет поиск объектов, пересекающих область.
+void SpatialIndex::query(const QRectF& area, std::vector<Handle>& result) const
+{
+    if (!m_root) return;
+
+    // Обход в глубину с явным стеком, чтобы не зависеть от глубины рекурсии.
+    std::vector<const Node*> stack;
+    stack.push_back(m_root.get());
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+
+        if (!overlapsBox(node->bounds, area)) continue;
+
+        // Если область целиком покрывает узел, все его записи заведомо попадают в результат.
+        const bool fullyCovered = containsBox(area, node->bounds);
+        for (const auto& entry : node->entries) {
+            if (fullyCovered || overlapsBox(entry.box, area)) {
+                result.push_back(entry.handle);
+            }
+        }
+
+        if (!node->isLeaf()) {
+            for (const auto& child : node->children) {
+                stack.push_back(child.get());
+            }
+        }
+    }
+}
+
+// Очищает индекс.
+void SpatialIndex::clear()
+{
+    // Общая таблица хранит и узлы других индексов - стираются только свои записи.
+    if (m_locations.use_count() > 1 && m_root) {
+        std::vector<const Node*> stack{m_root.get()};
+        while (!stack.empty()) {
+            const Node* node = stack.back();
+            stack.pop_back();
+            for (const auto& entry : node->entries) (*m_locations)[entry.handle.index] = nullptr;
+            if (!node->isLeaf()) {
+                for (const auto& child : node->children) stack.push_back(child.get());
+            }
+        }
+    } else {
+        m_locations->clear();
+    }
+    m_root.reset();
+    m_size = 0;
+}
+
+// Возвращает количество объектов в индексе.
+std::size_t SpatialIndex::size() const
+{
+    return m_size;
+}
+
+// Расширяет корень, пока он не покроет прямоугольник.
+void SpatialIndex::growToContain(const QRectF& box)
+{
+    if (!m_root) {
+        // Первый объект: создаем корень с центром в центре объекта.
+        const double size = std::max({box.width(), box.height(), kInitialRootSize}) * 2.0;
+        const QPointF center = box.center();
+        m_root = std::make_unique<Node>(
+            this, QRectF(center.x() - size / 2.0, center.y() - size / 2.0, size, size), 0, nullptr);
+        return;
+    }
+
+    while (!containsBox(m_root->bounds, box)) {
+        // Удваиваем корень в сторону объекта; старый корень становится одним из квадрантов.
+        const QRectF bounds = m_root->bounds;
+        const bool growLeft = box.left() < bounds.left();
+        const bool growUp = box.top() < bounds.top();
+        const QRectF newBounds(growLeft ? bounds.left() - bounds.width() : bounds.left(),
+                               growUp ? bounds.top() - bounds.height() : bounds.top(),
+                               bounds.width() * 2.0, bounds.height() * 2.0);
+
+        auto newRoot = std::make_unique<Node>(this, newBounds, m_root->depth - 1, nullptr);
+        const int oldIndex = (growLeft ? 1 : 0) | (growUp ? 2 : 0);
+        for (int i = 0; i < 4; ++i) {
+            if (i == oldIndex) {
+                m_root->parent = newRoot.get();
+                newRoot->children[i] = std::move(m_root);
+            } else {
+                newRoot->children[i] =
+                    std::make_unique<Node>(this, newRoot->quadrant(i), newRoot->depth + 1, newRoot.get());
+            }
+        }
+        m_root = std::move(newRoot);
+    }
+}
+
+// Сохраняет запись в самом глубоком узле, который целиком покрывает ее прямоугольник.
+void SpatialIndex::insertEntry(Node* node, const Entry& entry)
+{
+    while (!node->isLeaf()) {
+        Node* target = nullptr;
+        for (const auto& child : node->children) {
+            if (containsBox(child->bounds, entry.box)) {
+                target = child.get();
+                break;
+            }
+        }
+        // Объект пересекает границу квадрантов - остается в текущем узле.
+        if (!target) break;
+        node = target;
+    }
+
+    node->entries.push_back(entry);
+    setNode(entry.handle, node);
+    ++m_size;
+
+    if (node->isLeaf() && node->entries.size() > kNodeCapacity && node->depth < kMaxDepth) {
+        split(node);
+    }
+}
+
+// Делит лист на четыре квадранта.
+void SpatialIndex::split(Node* node)
+{
+    for (int i = 0; i < 4; ++i) {
+        node->children[i] = std::make_unique<Node>(this, node->quadrant(i), node->depth + 1, node);
+    }
+
+    // Переносим в потомков все записи, которые помещаются в один квадрант целиком.
+    std::vector<Entry> remaining;
+    for (const auto& entry : node->entries) {
+        Node* target = nullptr;
+        for (const auto& child : node->children) {
+            if (containsBox(child->bounds, entry.box)) {
+                target = child.get();
+                break;
+            }
+        }
+        if (target) {
+            target->entries.push_back(entry);
+            setNode(entry.handle, target);
+        } else {
+            remaining.push_back(entry);
+        }
+    }
+    node->entries = std::move(remaining);
+
+    // Потомки могли сами переполниться (например, все объекты в одном квадранте).
+    for (const auto& child : node->children) {
+        if (child->entries.size() > kNodeCapacity && child->depth < kMaxDepth) {
+            split(child.get());
+        }
+    }
+}
+
+// Сливает потомков узла, если их записи помещаются в один лист.
+void SpatialIndex::tryMerge(Node* node)
+{
+    while (node) {
+        std::size_t total = node->entries.size();
+        for (const auto& child : node->children) {
+            if (!child || !child->isLeaf()) return;
+            total += child->entries.size();
+        }
+        if (total > kNodeCapacity) return;
+
+        for (auto& child : node->children) {
+            for (const auto& entry : child->entries) {
+                node->entries.push_back(entry);
+                setNode(entry.handle, node);
+            }
+            child.reset();
+        }
+        node = node->parent;
+    }
+}
+
+// Возвращает узел этого индекса, в котором хранится объект.
+SpatialIndex::Node* SpatialIndex::findNode(Handle handle) const
+{
+    if (handle.index >= m_locations->size()) return nullptr;
+    Node* node = (*m_locations)[handle.index];
+    return (node && node->owner == this) ? node : nullptr;
+}
+
+// Запоминает узел, в котором хранится объект.
+void SpatialIndex::setNode(Handle handle, Node* node)
+{
+    if (handle.index >= m_locations->size()) {
+        m_locations->resize(handle.index + 1, nullptr);
+    }
+    (*m_locations)[handle.index] = node;
+}
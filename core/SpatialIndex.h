@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Handle.h"
+
+#include <QRectF>
+
+#include <vector>
+#include <memory>
+
+// Пространственный индекс (квадродерево) по ограничивающим прямоугольникам объектов.
+// Позволяет быстро находить объекты, попадающие в заданную область (например, видимую часть сцены).
+// Несколько индексов с непересекающимися наборами объектов (например, слои сцены) могут
+// пользоваться общей таблицей узлов, чтобы ее размер не умножался на количество индексов.
+class SpatialIndex
+{
+public:
+    // Узел квадродерева.
+    struct Node;
+
+    // Узел, в котором хранится каждый объект, по номеру ячейки дескриптора (для быстрого удаления).
+    // Дескрипторы сцены плотно нумеруются, поэтому вместо хеш-таблицы используется вектор.
+    using LocationTable = std::vector<Node*>;
+
+    // Конструктор пустого индекса с собственной таблицей узлов.
+    SpatialIndex();
+
+    // Конструктор пустого индекса, хранящего узлы объектов в общей таблице locations.
+    explicit SpatialIndex(std::shared_ptr<LocationTable> locations);
+
+    // Деструктор (определен в .cpp, т.к. узел дерева объявлен только там).
+    ~SpatialIndex();
+
+    // Добавляет объект с указанным ограничивающим прямоугольником.
+    void insert(Handle handle, const QRectF& box);
+
+    // Удаляет объект из индекса.
+    void remove(Handle handle);
+
+    // Обновляет ограничивающий прямоугольник уже добавленного объекта.
+    void update(Handle handle, const QRectF& box);
+
+    // Возвращает прямоугольник, под которым объект хранится в индексе (пустой, если объекта нет).
+    QRectF getBoundingBox(Handle handle) const;
+
+    // Добавляет в result все объекты, прямоугольники которых пересекают area.
+    void query(const QRectF& area, std::vector<Handle>& result) const;
+
+    // Удаляет все объекты из индекса.
+    void clear();
+
+    // Возвращает количество объектов в индексе.
+    std::size_t size() const;
+
+private:
+    // Запись индекса: объект и его ограничивающий прямоугольник.
+    struct Entry
+    {
+        QRectF box;
+        Handle handle;
+    };
+
+    // Расширяет корень дерева, пока он не покроет прямоугольник box.
+    void growToContain(const QRectF& box);
+
+    // Спускается от узла node вниз и сохраняет запись в подходящем узле.
+    void insertEntry(Node* node, const Entry& entry);
+
+    // Делит лист на четыре дочерних узла и перераспределяет его записи.
+    void split(Node* node);
+
+    // Сливает дочерние узлы обратно в родителя, если в них осталось мало записей.
+    void tryMerge(Node* node);
+
+    // Корневой узел дерева (nullptr, пока индекс пуст).
+    std::unique_ptr<Node> m_root;
+
+    // Возвращает узел этого индекса, в котором хранится объект, или nullptr.
+    Node* findNode(Handle handle) const;
+
+    // Запоминает узел, в котором хранится объект.
+    void setNode(Handle handle, Node* node);
+
+    // Таблица узлов объектов (собственная или общая с другими индексами).
+    std::shared_ptr<LocationTable> m_locations;
+
+    // Количество объектов в индексе.
+    std::size_t m_size = 0;
+};
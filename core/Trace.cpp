@@ -0,0 +1,267 @@
+#include "Trace.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QSaveFile>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Емкость кольцевого буфера одного потока (событий).
+constexpr std::uint64_t kBufferCapacity = 1u << 16;
+
+// Наибольшее число завершившихся потоков, события которых хранятся до выгрузки.
+constexpr std::size_t kMaxRetiredThreads = 64;
+
+// Завершенный участок.
+struct Event
+{
+    const char* name;
+    std::int64_t start;
+    std::int64_t end;
+};
+
+// Кольцевой буфер событий. Пишет только владеющий поток; выгрузка читает
+// события до счетчика written, опубликованного с барьером release. Признак writing
+// поднят на время записи события: выгрузка после остановки записи ждет его снятия,
+// иначе поток, успевший проверить признак записи, писал бы в читаемую ячейку кольца.
+struct ThreadBuffer
+{
+    std::unique_ptr<Event[]> events{new Event[kBufferCapacity]};
+    std::atomic<std::uint64_t> written{0};
+    std::atomic<bool> writing{false};
+    std::uint32_t id = 0; // Номер потока в трассе (новый для каждого потока-владельца).
+    QString name;         // Защищено мьютексом реестра.
+};
+
+// События завершившегося потока с его номером и именем.
+struct RetiredThread
+{
+    std::uint32_t id = 0;
+    QString name;
+    std::vector<Event> events;
+};
+
+// Реестр буферов. Рабочие потоки parallelFor постоянны, но другие потоки (например,
+// чтение DXF через std::async) создаются на каждую операцию, поэтому буфер завершившегося
+// потока возвращается в пул и достается следующему: число буферов не превышает
+// наибольшего числа одновременно живых потоков. События завершившегося потока
+// переносятся в список retired под его номером и именем, а буфер очищается.
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> freeBuffers;
+    std::vector<RetiredThread> retired;
+    std::uint32_t nextId = 0;
+
+    ThreadBuffer* acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ThreadBuffer* buffer = nullptr;
+        if (!freeBuffers.empty()) {
+            buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        } else {
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            buffer = buffers.back().get();
+        }
+        buffer->id = ++nextId;
+        return buffer;
+    }
+
+    void release(ThreadBuffer* buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+        if (written > 0) {
+            if (retired.size() == kMaxRetiredThreads) retired.erase(retired.begin());
+            RetiredThread thread;
+            thread.id = buffer->id;
+            thread.name = buffer->name;
+            const std::uint64_t begin = written > kBufferCapacity ? written - kBufferCapacity : 0;
+            thread.events.reserve(static_cast<std::size_t>(written - begin));
+            for (std::uint64_t i = begin; i < written; ++i) {
+                thread.events.push_back(buffer->events[i % kBufferCapacity]);
+            }
+            retired.push_back(std::move(thread));
+        }
+        buffer->written.store(0, std::memory_order_relaxed);
+        buffer->name.clear();
+        freeBuffers.push_back(buffer);
+    }
+};
+
+// Реестр не уничтожается: буферы потоков освобождаются при их завершении,
+// в том числе после выхода из main.
+Registry& registry()
+{
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+// Буфер текущего потока (выдается при первом событии, возвращается в пул при завершении потока).
+struct BufferOwner
+{
+    ThreadBuffer* buffer = nullptr;
+
+    ThreadBuffer* get()
+    {
+        if (!buffer) buffer = registry().acquire();
+        return buffer;
+    }
+
+    ~BufferOwner()
+    {
+        if (buffer) registry().release(buffer);
+    }
+};
+
+thread_local BufferOwner t_buffer;
+
+// Начало отсчета времени и начало текущей записи.
+const std::chrono::steady_clock::time_point kEpoch = std::chrono::steady_clock::now();
+std::atomic<std::int64_t> s_sessionStart{0};
+
+// Дописывает строку JSON с экранированием кавычек и обратной косой черты.
+void appendEscaped(QByteArray& out, const QByteArray& text)
+{
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+}
+
+// Переводит наносекунды в микросекунды формата trace-event.
+QByteArray micros(std::int64_t ns)
+{
+    return QByteArray::number(ns / 1000.0, 'f', 3);
+}
+
+} // namespace
+
+namespace Trace {
+
+namespace detail {
+std::atomic<bool> recording{false};
+} // namespace detail
+
+// Начинает запись событий.
+void start()
+{
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().retired.clear();
+    }
+    s_sessionStart.store(now(), std::memory_order_relaxed);
+    detail::recording.store(true, std::memory_order_release);
+}
+
+// Останавливает запись событий.
+void stop()
+{
+    detail::recording.store(false, std::memory_order_seq_cst);
+}
+
+// Задает имя текущего потока в трассе.
+void setThreadName(const QString& name)
+{
+    ThreadBuffer* buffer = t_buffer.get();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer->name = name;
+}
+
+// Возвращает монотонное время в наносекундах от запуска программы.
+std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - kEpoch).count();
+}
+
+// Записывает завершенный участок в буфер текущего потока.
+void record(const char* name, std::int64_t startNs, std::int64_t endNs)
+{
+    if (!isRecording()) return;
+
+    // Признак writing поднимается до повторной проверки записи (оба - seq_cst): либо поток
+    // увидит остановку записи, либо выгрузка увидит признак и дождется конца записи.
+    ThreadBuffer* buffer = t_buffer.get();
+    buffer->writing.store(true, std::memory_order_seq_cst);
+    if (detail::recording.load(std::memory_order_seq_cst)) {
+        const std::uint64_t index = buffer->written.load(std::memory_order_relaxed);
+        buffer->events[index % kBufferCapacity] = Event{name, startNs, endNs};
+        buffer->written.store(index + 1, std::memory_order_release);
+    }
+    buffer->writing.store(false, std::memory_order_release);
+}
+
+// Выгружает события всех потоков в формате Chrome trace-event JSON.
+bool writeJson(const QString& path, QString* error)
+{
+    const bool wasRecording = isRecording();
+    stop();
+
+    const std::int64_t sessionStart = s_sessionStart.load(std::memory_order_relaxed);
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    QByteArray json;
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&] {
+        if (!first) json += ",\n";
+        first = false;
+    };
+
+    // Имя потока и его события.
+    auto appendThreadName = [&](const QByteArray& tid, const QString& name) {
+        separator();
+        json += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":\"";
+        appendEscaped(json, name.toUtf8());
+        json += "\"}}";
+    };
+    auto appendEvent = [&](const QByteArray& tid, const Event& event) {
+        if (event.start < sessionStart) return;
+        separator();
+        json += "{\"ph\":\"X\",\"name\":\"";
+        appendEscaped(json, QByteArray(event.name));
+        json += "\",\"pid\":" + pid + ",\"tid\":" + tid;
+        json += ",\"ts\":" + micros(event.start - sessionStart);
+        json += ",\"dur\":" + micros(event.end - event.start) + "}";
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        // Завершившиеся потоки - под своими номерами и именами.
+        for (const RetiredThread& thread : registry().retired) {
+            const QByteArray tid = QByteArray::number(thread.id);
+            appendThreadName(tid, thread.name.isEmpty() ? QString("Thread %1").arg(thread.id) : thread.name);
+            for (const Event& event : thread.events) appendEvent(tid, event);
+        }
+
+        for (const auto& buffer : registry().buffers) {
+            // Поток, начавший запись события до остановки, дописывает его до чтения буфера.
+            while (buffer->writing.load(std::memory_order_seq_cst)) std::this_thread::yield();
+
+            const QByteArray tid = QByteArray::number(buffer->id);
+            appendThreadName(tid, buffer->name.isEmpty() ? QString("Thread %1").arg(buffer->id) : buffer->name);
+            const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+            const std::uint64_t begin = written > kBufferCapacity ? written - kBufferCapacity : 0;
+            for (std::uint64_t i = begin; i < written; ++i) appendEvent(tid, buffer->events[i % kBufferCapacity]);
+        }
+    }
+    json += "]}\n";
+
+    QSaveFile file(path);
+    bool ok = file.open(QIODevice::WriteOnly) && file.write(json) == json.size() && file.commit();
+    if (!ok && error) *error = QString("Не удалось записать трассу: %1").arg(file.errorString());
+
+    // Запись продолжается с сохранением уже собранных событий.
+    if (wasRecording) detail::recording.store(true, std::memory_order_release);
+    return ok;
+}
+
+} // namespace Trace
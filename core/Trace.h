@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+// Трассировка горячих участков кода с выгрузкой в формат Chrome trace-event JSON
+// (открывается в chrome://tracing и Perfetto).
+//
+// Участок отмечается макросом UCAD_TRACE_SCOPE("Имя") в начале блока: время от макроса
+// до выхода из блока записывается как событие. Каждый поток пишет события в собственный
+// кольцевой буфер без блокировок; при переполнении затираются самые старые события.
+// Пока запись не включена (Trace::start), участок стоит одной атомарной загрузки.
+// При сборке с -DUNIVERSITYCAD_ENABLE_TRACING=OFF макрос не порождает кода вовсе.
+namespace Trace {
+
+// Возвращает true, если программа собрана с трассировкой.
+constexpr bool isAvailable()
+{
+#if defined(UCAD_ENABLE_TRACING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Начинает запись событий (ранее записанные события отбрасываются).
+void start();
+
+// Останавливает запись событий.
+void stop();
+
+namespace detail {
+// Признак записи событий (читается каждым участком).
+extern std::atomic<bool> recording;
+} // namespace detail
+
+// Возвращает true, если идет запись событий.
+inline bool isRecording()
+{
+    return detail::recording.load(std::memory_order_relaxed);
+}
+
+// Задает имя текущего потока в трассе (например, "GUI").
+void setThreadName(const QString& name);
+
+// Записывает собранные события в JSON-файл. Запись событий на время выгрузки останавливается.
+// При ошибке возвращает false и описание в error.
+bool writeJson(const QString& path, QString* error = nullptr);
+
+// Возвращает монотонное время в наносекундах от запуска программы.
+std::int64_t now();
+
+// Записывает завершенный участок в буфер текущего потока. name должен жить до выгрузки
+// (строковый литерал). Участки, завершившиеся после остановки записи, отбрасываются.
+void record(const char* name, std::int64_t startNs, std::int64_t endNs);
+
+// Участок трассировки: время жизни объекта записывается как событие.
+class Zone
+{
+public:
+    explicit Zone(const char* name) : m_name(isRecording() ? name : nullptr)
+    {
+        if (m_name) m_start = now();
+    }
+
+    ~Zone()
+    {
+        if (m_name) record(m_name, m_start, now());
+    }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* m_name;
+    std::int64_t m_start = 0;
+};
+
+} // namespace Trace
+
+#define UCAD_TRACE_CONCAT_IMPL(a, b) a##b
+#define UCAD_TRACE_CONCAT(a, b) UCAD_TRACE_CONCAT_IMPL(a, b)
+
+#if defined(UCAD_ENABLE_TRACING)
+#define UCAD_TRACE_SCOPE(name) ::Trace::Zone UCAD_TRACE_CONCAT(ucadTraceZone, __LINE__)(name)
+#else
+#define UCAD_TRACE_SCOPE(name) do {} while (false)
+#endif
@@ -0,0 +1,72 @@
+#include "TransformKernels.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define UCAD_TRANSFORM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UCAD_TRANSFORM_SSE2 1
+#endif
+
+namespace {
+
+// Скалярная обработка хвоста массивов (и всего массива без SIMD).
+void transformScalar(const Affine2D& m, double* x, double* y, std::size_t begin, std::size_t end)
+{
+    for (std::size_t i = begin; i < end; ++i) {
+        const double px = x[i];
+        const double py = y[i];
+        x[i] = (m.m11 * px + m.m12 * py) + m.dx;
+        y[i] = (m.m21 * px + m.m22 * py) + m.dy;
+    }
+}
+
+} // namespace
+
+// Преобразует массив точек на месте.
+void transformPoints(const Affine2D& m, double* x, double* y, std::size_t count)
+{
+    std::size_t i = 0;
+
+#if defined(UCAD_TRANSFORM_AVX)
+    const __m256d m11 = _mm256_set1_pd(m.m11);
+    const __m256d m12 = _mm256_set1_pd(m.m12);
+    const __m256d m21 = _mm256_set1_pd(m.m21);
+    const __m256d m22 = _mm256_set1_pd(m.m22);
+    const __m256d dx = _mm256_set1_pd(m.dx);
+    const __m256d dy = _mm256_set1_pd(m.dy);
+    for (; i + 4 <= count; i += 4) {
+        const __m256d px = _mm256_loadu_pd(x + i);
+        const __m256d py = _mm256_loadu_pd(y + i);
+        _mm256_storeu_pd(x + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m11, px), _mm256_mul_pd(m12, py)), dx));
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m21, px), _mm256_mul_pd(m22, py)), dy));
+    }
+#elif defined(UCAD_TRANSFORM_SSE2)
+    const __m128d m11 = _mm_set1_pd(m.m11);
+    const __m128d m12 = _mm_set1_pd(m.m12);
+    const __m128d m21 = _mm_set1_pd(m.m21);
+    const __m128d m22 = _mm_set1_pd(m.m22);
+    const __m128d dx = _mm_set1_pd(m.dx);
+    const __m128d dy = _mm_set1_pd(m.dy);
+    for (; i + 2 <= count; i += 2) {
+        const __m128d px = _mm_loadu_pd(x + i);
+        const __m128d py = _mm_loadu_pd(y + i);
+        _mm_storeu_pd(x + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(m11, px), _mm_mul_pd(m12, py)), dx));
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(m21, px), _mm_mul_pd(m22, py)), dy));
+    }
+#endif
+
+    transformScalar(m, x, y, i, count);
+}
+
+// Возвращает название набора инструкций ядер.
+const char* transformKernelName()
+{
+#if defined(UCAD_TRANSFORM_AVX)
+    return "AVX";
+#elif defined(UCAD_TRANSFORM_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
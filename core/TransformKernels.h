@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Affine2D.h"
+
+#include <cstddef>
+
+// Векторизованные ядра аффинного преобразования массивов координат.
+// Набор инструкций выбирается при сборке: AVX (опция UNIVERSITYCAD_ENABLE_AVX),
+// SSE2 (базовый для x86-64) или скалярный код для остальных архитектур.
+// Все варианты дают одинаковый результат: умножения и сложения выполняются
+// в одном и том же порядке без слияния в FMA.
+
+// Преобразует count точек (x[i], y[i]) на месте. Массивы не обязаны быть выровнены.
+void transformPoints(const Affine2D& m, double* x, double* y, std::size_t count);
+
+// Возвращает название набора инструкций, которым собраны ядра ("AVX", "SSE2" или "scalar").
+const char* transformKernelName();
@@ -0,0 +1,195 @@
+#include "UndoJournal.h"
+#include "Scene.h"
+#include "Trace.h"
+
+#include <utility>
+
+namespace {
+
+// Ограничение объема журнала по умолчанию.
+constexpr std::size_t kDefaultMemoryLimit = 64u << 20;
+
+} // namespace
+
+// Создает журнал с ограничением объема по умолчанию.
+UndoJournal::UndoJournal() : m_memoryLimit(kDefaultMemoryLimit)
+{
+}
+
+// Записывает изменение текущего шага.
+void UndoJournal::record(Action action, const SegmentRecord& record)
+{
+    if (m_applying) return;
+
+    // Повторные изменения одного отрезка подряд (например, правка нескольких полей
+    // в панели свойств) хранятся одной записью: достаточно самого раннего состояния.
+    if (action == Action::Modified && !m_current.deltas.empty()) {
+        const Delta& last = m_current.deltas.back();
+        if (last.action == Action::Modified && last.record.id == record.id) return;
+    }
+    m_current.deltas.push_back(Delta{action, record});
+}
+
+// Завершает текущий шаг и помещает его в историю.
+void UndoJournal::commitEntry()
+{
+    if (m_applying || m_current.deltas.empty()) return;
+
+    clearRedo();
+    m_current.deltas.shrink_to_fit();
+    m_memoryUsage += entryBytes(m_current);
+    m_undo.push_back(std::move(m_current));
+    m_current = Entry();
+    enforceLimit();
+}
+
+// Возвращает true, если есть шаги для отмены.
+bool UndoJournal::canUndo() const
+{
+    return !m_undo.empty();
+}
+
+// Возвращает true, если есть шаги для повтора.
+bool UndoJournal::canRedo() const
+{
+    return !m_redo.empty();
+}
+
+// Отменяет последний шаг.
+bool UndoJournal::undo(Scene& scene)
+{
+    UCAD_TRACE_SCOPE("UndoJournal::undo");
+    if (m_undo.empty()) return false;
+
+    Entry entry = std::move(m_undo.back());
+    m_undo.pop_back();
+    apply(scene, entry, true);
+    m_redo.push_back(std::move(entry));
+    return true;
+}
+
+// Повторяет последний отмененный шаг.
+bool UndoJournal::redo(Scene& scene)
+{
+    UCAD_TRACE_SCOPE("UndoJournal::redo");
+    if (m_redo.empty()) return false;
+
+    Entry entry = std::move(m_redo.back());
+    m_redo.pop_back();
+    apply(scene, entry, false);
+    m_undo.push_back(std::move(entry));
+    return true;
+}
+
+// Очищает историю.
+void UndoJournal::clear()
+{
+    m_undo.clear();
+    m_redo.clear();
+    m_current = Entry();
+    m_memoryUsage = 0;
+}
+
+// Устанавливает ограничение объема журнала.
+void UndoJournal::setMemoryLimit(std::size_t bytes)
+{
+    m_memoryLimit = bytes;
+    enforceLimit();
+}
+
+// Возвращает ограничение объема журнала.
+std::size_t UndoJournal::getMemoryLimit() const
+{
+    return m_memoryLimit;
+}
+
+// Возвращает текущий объем журнала.
+std::size_t UndoJournal::getMemoryUsage() const
+{
+    return m_memoryUsage;
+}
+
+// Применяет шаг к сцене. Подряд идущие добавления и удаления собираются в пакеты
+// (Scene::addSegments и Scene::removePrimitives), чтобы массовые шаги выполнялись
+// за линейное время без выделения памяти на каждый объект.
+void UndoJournal::apply(Scene& scene, Entry& entry, bool undo)
+{
+    m_applying = true;
+    {
+        Scene::Transaction transaction(scene);
+        std::vector<SegmentRecord> additions;
+        std::vector<Handle> removals;
+        auto flushAdditions = [&] {
+            if (!additions.empty()) scene.addSegments(additions);
+            additions.clear();
+        };
+        auto flushRemovals = [&] {
+            if (!removals.empty()) scene.removePrimitives(removals);
+            removals.clear();
+        };
+
+        const std::size_t count = entry.deltas.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            Delta& delta = entry.deltas[undo ? count - 1 - i : i];
+
+            if (delta.action == Action::Modified) {
+                flushAdditions();
+                flushRemovals();
+                const Handle handle = scene.findByID(delta.record.id);
+                if (!handle.isValid()) continue;
+
+                // Сохраненное состояние обменивается с текущим: так одна запись служит и отмене, и повтору.
+                const SegmentRecord current = scene.getSegmentRecord(handle);
+                scene.setSegmentRecord(handle, delta.record);
+                delta.record = current;
+                continue;
+            }
+
+            // Отмена добавления и повтор удаления убирают отрезок, остальное возвращает его.
+            const bool remove = (delta.action == Action::Added) == undo;
+            if (remove) {
+                flushAdditions();
+                const Handle handle = scene.findByID(delta.record.id);
+                if (!handle.isValid()) continue;
+                delta.record = scene.getSegmentRecord(handle);
+                if (removals.empty()) removals.reserve(count - i);
+                removals.push_back(handle);
+            } else {
+                flushRemovals();
+                if (additions.empty()) additions.reserve(count - i);
+                additions.push_back(delta.record);
+            }
+        }
+        flushAdditions();
+        flushRemovals();
+    }
+    m_applying = false;
+}
+
+// Возвращает объем памяти, занимаемый шагом.
+std::size_t UndoJournal::entryBytes(const Entry& entry)
+{
+    return sizeof(Entry) + entry.deltas.capacity() * sizeof(Delta);
+}
+
+// Вытесняет самые старые шаги отмены, а затем самые дальние шаги повтора.
+void UndoJournal::enforceLimit()
+{
+    while (m_memoryUsage > m_memoryLimit && !m_undo.empty()) {
+        m_memoryUsage -= entryBytes(m_undo.front());
+        m_undo.pop_front();
+    }
+    while (m_memoryUsage > m_memoryLimit && !m_redo.empty()) {
+        m_memoryUsage -= entryBytes(m_redo.front());
+        m_redo.erase(m_redo.begin());
+    }
+}
+
+// Очищает стек повтора.
+void UndoJournal::clearRedo()
+{
+    for (const Entry& entry : m_redo) {
+        m_memoryUsage -= entryBytes(entry);
+    }
+    m_redo.clear();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "SegmentStore.h"
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+
+class Scene;
+
+// Журнал отмены и повтора изменений сцены.
+// Вместо снимков объектов хранятся компактные записи: действие, ID отрезка и его поля.
+// Все изменения одной транзакции сцены образуют один шаг (например, удаление тысяч
+// объектов отменяется одним действием), а записи шага лежат в одном непрерывном массиве,
+// поэтому отмена массового удаления не создает отдельных объектов в куче.
+// Изменение хранит лишь одно состояние отрезка: при отмене и повторе оно обменивается
+// с текущим. Объем журнала ограничен; при превышении вытесняются самые старые шаги.
+class UndoJournal
+{
+public:
+    // Вид записанного изменения.
+    enum class Action { Added, Removed, Modified };
+
+    // Создает журнал с ограничением объема по умолчанию.
+    UndoJournal();
+
+    // Записывает изменение текущего шага: для Added - отрезок после добавления,
+    // для Removed и Modified - состояние до изменения. Вызывается сценой.
+    void record(Action action, const SegmentRecord& record);
+
+    // Завершает текущий шаг (вызывается сценой после самой внешней транзакции).
+    void commitEntry();
+
+    // Возвращает true, если есть шаги для отмены или повтора.
+    bool canUndo() const;
+    bool canRedo() const;
+
+    // Отменяет последний шаг. Возвращает false, если отменять нечего.
+    bool undo(Scene& scene);
+
+    // Повторяет последний отмененный шаг. Возвращает false, если повторять нечего.
+    bool redo(Scene& scene);
+
+    // Очищает историю (например, после загрузки другой сцены).
+    void clear();
+
+    // Устанавливает ограничение объема журнала в байтах и при необходимости вытесняет старые шаги.
+    void setMemoryLimit(std::size_t bytes);
+
+    // Возвращает ограничение и текущий объем журнала в байтах.
+    std::size_t getMemoryLimit() const;
+    std::size_t getMemoryUsage() const;
+
+private:
+    // Одна запись шага.
+    struct Delta
+    {
+        Action action;
+        SegmentRecord record;
+    };
+
+    // Шаг истории: все изменения одной транзакции.
+    struct Entry
+    {
+        std::vector<Delta> deltas;
+    };
+
+    // Применяет шаг к сцене: при отмене - записи в обратном порядке, при повторе - в прямом.
+    void apply(Scene& scene, Entry& entry, bool undo);
+
+    // Возвращает объем памяти, занимаемый шагом.
+    static std::size_t entryBytes(const Entry& entry);
+
+    // Вытесняет старые шаги, пока объем журнала превышает ограничение.
+    void enforceLimit();
+
+    // Очищает стек повтора.
+    void clearRedo();
+
+    std::deque<Entry> m_undo; // Шаги для отмены (в конце - последний).
+    std::vector<Entry> m_redo; // Отмененные шаги (в конце - следующий для повтора).
+    Entry m_current;           // Шаг, записываемый в текущей транзакции.
+
+    std::size_t m_memoryLimit;
+    std::size_t m_memoryUsage = 0;
+
+    // Журнал сам изменяет сцену - записи не ведутся.
+    bool m_applying = false;
+};
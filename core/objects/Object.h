@@ -1,8 +1,14 @@
 #pragma once
 
 #include "Enums.h"
+#include "Handle.h"
+#include "Geometry.h"
 
 #include <QColor>
+#include <QRectF>
+#include <QPointF>
+
+#include <cstdint>
 
 // Абстрактный базовый класс для всех геометрических объектов.
 class Object
@@ -20,16 +26,44 @@ public:
     // Возвращает уникальный идентификатор объекта.
     unsigned int getID() const { return m_id; }
 
+    // Устанавливает дескриптор объекта в сцене.
+    void setHandle(Handle handle) { m_handle = handle; }
+
+    // Возвращает дескриптор объекта в сцене (пустой, если объект не добавлен на сцену).
+    Handle getHandle() const { return m_handle; }
+
+    // Устанавливает номер слоя объекта (управляется Сценой).
+    void setLayer(std::uint32_t layer) { m_layer = layer; }
+
+    // Возвращает номер слоя объекта.
+    std::uint32_t getLayer() const { return m_layer; }
+
     // Устанавливает цвет объекта.
     virtual void setColor(const QColor& color) { m_color = color; }
 
     // Возвращает текущий цвет объекта.
     virtual QColor getColor() const { return m_color; }
 
+    // Возвращает ограничивающий прямоугольник объекта в мировых координатах.
+    virtual QRectF getBoundingBox() const { return QRectF(); }
+
+    // Возвращает квадрат расстояния от точки до объекта (по умолчанию - до его ограничивающего прямоугольника).
+    virtual double distanceSquaredTo(const QPointF& point) const
+    {
+        const QRectF box = getBoundingBox();
+        return distanceToRectSquared(point.x(), point.y(), box.left(), box.top(), box.right(), box.bottom());
+    }
+
 private:
     // Цвет объекта по умолчанию (белый).
     QColor m_color = Qt::white;
 
     // Уникальный идентификатор объекта (управляется Сценой).
     unsigned int m_id = 0;
+
+    // Дескриптор объекта в сцене (управляется Сценой).
+    Handle m_handle;
+
+    // Номер слоя объекта (управляется Сценой).
+    std::uint32_t m_layer = 0;
 };
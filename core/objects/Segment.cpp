@@ -1,16 +1,99 @@
 #include "Segment.h"
+#include "Scene.h"
 
-// Конструктор класса Segment.
+#include <algorithm>
+
+// Конструктор самостоятельного отрезка.
 Segment::Segment(const Point& start, const Point& end) : m_start(start), m_end(end) {}
 
+// Конструктор представления отрезка, хранящегося в сцене.
+Segment::Segment(Scene* scene, Handle handle) : m_scene(scene)
+{
+    setHandle(handle);
+    setID(scene->getPrimitiveID(handle));
+}
+
 // Возвращает начальную точку отрезка.
-const Point& Segment::getStart() const { return m_start; }
+Point Segment::getStart() const
+{
+    if (m_scene) {
+        const std::size_t row = m_scene->getSegmentRow(getHandle());
+        if (row != SegmentStore::npos) {
+            const SegmentStore& segments = m_scene->getSegments();
+            return Point(segments.getX0(row), segments.getY0(row));
+        }
+    }
+    return m_start;
+}
 
 // Устанавливает начальную точку отрезка.
-void Segment::setStart(const Point& point) { m_start = point; }
+void Segment::setStart(const Point& point)
+{
+    if (m_scene) {
+        m_scene->setSegmentStart(getHandle(), point);
+    } else {
+        m_start = point;
+    }
+}
 
 // Возвращает конечную точку отрезка.
-const Point& Segment::getEnd() const { return m_end; }
+Point Segment::getEnd() const
+{
+    if (m_scene) {
+        const std::size_t row = m_scene->getSegmentRow(getHandle());
+        if (row != SegmentStore::npos) {
+            const SegmentStore& segments = m_scene->getSegments();
+            return Point(segments.getX1(row), segments.getY1(row));
+        }
+    }
+    return m_end;
+}
 
 // Устанавливает конечную точку отрезка.
-void Segment::setEnd(const Point& point) { m_end = point; }
+void Segment::setEnd(const Point& point)
+{
+    if (m_scene) {
+        m_scene->setSegmentEnd(getHandle(), point);
+    } else {
+        m_end = point;
+    }
+}
+
+// Устанавливает цвет отрезка.
+void Segment::setColor(const QColor& color)
+{
+    if (m_scene) {
+        m_scene->setSegmentColor(getHandle(), color);
+    } else {
+        Object::setColor(color);
+    }
+}
+
+// Возвращает цвет отрезка.
+QColor Segment::getColor() const
+{
+    if (m_scene) {
+        const std::size_t row = m_scene->getSegmentRow(getHandle());
+        if (row != SegmentStore::npos) {
+            return m_scene->getSegments().getColor(row);
+        }
+    }
+    return Object::getColor();
+}
+
+// Возвращает ограничивающий прямоугольник отрезка.
+QRectF Segment::getBoundingBox() const
+{
+    const Point start = getStart();
+    const Point end = getEnd();
+    return QRectF(QPointF(std::min(start.getX(), end.getX()), std::min(start.getY(), end.getY())),
+                  QPointF(std::max(start.getX(), end.getX()), std::max(start.getY(), end.getY())));
+}
+
+// Возвращает квадрат расстояния от точки до отрезка.
+double Segment::distanceSquaredTo(const QPointF& point) const
+{
+    const Point start = getStart();
+    const Point end = getEnd();
+    return distanceToSegmentSquared(point.x(), point.y(), start.getX(), start.getY(), end.getX(), end.getY());
+}
@@ -3,33 +3,55 @@
 #include "Object.h"
 #include "Point.h"
 
+class Scene;
+
 // Класс для представления отрезка, определенного двумя точками.
+// Отрезок может быть самостоятельным (например, при создании нового объекта)
+// или служить легковесным представлением строки в хранилище отрезков сцены.
+// Во втором случае все чтения и изменения выполняются напрямую через сцену.
 class Segment : public Object
 {
 public:
-    // Конструктор, создающий отрезок по начальной и конечной точкам.
+    // Конструктор, создающий самостоятельный отрезок по начальной и конечной точкам.
     Segment(const Point& start, const Point& end);
 
+    // Конструктор представления отрезка, хранящегося в сцене под указанным дескриптором.
+    Segment(Scene* scene, Handle handle);
+
     // Возвращает тип примитива (отрезок).
     PrimitiveType getType() const override { return PrimitiveType::Segment; };
 
-    // Возвращает константную ссылку на начальную точку отрезка.
-    const Point& getStart() const;
+    // Возвращает начальную точку отрезка.
+    Point getStart() const;
 
     // Устанавливает начальную точку отрезка.
     void setStart(const Point& point);
 
-    // Возвращает константную ссылку на конечную точку отрезка.
-    const Point& getEnd() const;
+    // Возвращает конечную точку отрезка.
+    Point getEnd() const;
 
     // Устанавливает конечную точку отрезка.
     void setEnd(const Point& point);
 
+    // Устанавливает цвет отрезка.
+    void setColor(const QColor& color) override;
+
+    // Возвращает цвет отрезка.
+    QColor getColor() const override;
+
+    // Возвращает ограничивающий прямоугольник отрезка.
+    QRectF getBoundingBox() const override;
+
+    // Возвращает квадрат расстояния от точки до отрезка.
+    double distanceSquaredTo(const QPointF& point) const override;
+
 private:
-    // Начальная точка отрезка.
+    // Начальная точка самостоятельного отрезка.
     Point m_start;
 
-    // Конечная точка отрезка.
+    // Конечная точка самостоятельного отрезка.
     Point m_end;
-};
 
+    // Сцена, в которой хранится отрезок (nullptr для самостоятельного отрезка).
+    Scene* m_scene = nullptr;
+};
@@ -0,0 +1,172 @@
+#include "RenderStats.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Строки CSV сбрасываются на диск не реже, чем раз в столько кадров.
+constexpr std::uint64_t kCsvFlushInterval = 60;
+
+// Пустой кадр для getLastFrame до первого кадра.
+const FrameStats kEmptyFrame;
+
+} // namespace
+
+// Создает статистику с окном из window кадров.
+RenderStats::RenderStats(std::size_t window) : m_window(std::max<std::size_t>(window, 1))
+{
+    m_frames.resize(m_window);
+}
+
+// Закрывает CSV-файл.
+RenderStats::~RenderStats()
+{
+    stopCsv();
+}
+
+// Добавляет кадр в окно и в CSV.
+void RenderStats::addFrame(const FrameStats& frame)
+{
+    m_frames[m_next] = frame;
+    m_next = (m_next + 1) % m_window;
+    m_count = std::min(m_count + 1, m_window);
+
+    if (m_csv) {
+        // Для кадров без ввода столбец задержки остается пустым.
+        const QString latency = frame.inputLatencyMs >= 0.0 ? QString::number(frame.inputLatencyMs, 'f', 3) : QString();
+        const QString line = QString("%1,%2,%3,%4,%5,%6,%7,%8\n")
+                                 .arg(m_csvFrame)
+                                 .arg(frame.frameMs, 0, 'f', 3)
+                                 .arg(frame.visited)
+                                 .arg(frame.culled)
+                                 .arg(frame.drawn)
+                                 .arg(frame.drawCalls)
+                                 .arg(frame.cacheHitRate, 0, 'f', 4)
+                                 .arg(latency);
+        m_csv->write(line.toUtf8());
+        if (++m_csvFrame % kCsvFlushInterval == 0) m_csv->flush();
+    }
+}
+
+// Возвращает последний добавленный кадр.
+const FrameStats& RenderStats::getLastFrame() const
+{
+    if (m_count == 0) return kEmptyFrame;
+    return m_frames[(m_next + m_window - 1) % m_window];
+}
+
+// Возвращает количество кадров в окне.
+std::size_t RenderStats::getFrameCount() const
+{
+    return m_count;
+}
+
+// Возвращает среднее время кадра в окне.
+double RenderStats::getAverageFrameMs() const
+{
+    if (m_count == 0) return 0.0;
+    double total = 0.0;
+    for (std::size_t i = 0; i < m_count; ++i) total += m_frames[i].frameMs;
+    return total / m_count;
+}
+
+// Возвращает процентиль времени кадра в окне (ближайший ранг).
+double RenderStats::getPercentileFrameMs(double percentile) const
+{
+    std::vector<double> times(m_count);
+    for (std::size_t i = 0; i < m_count; ++i) times[i] = m_frames[i].frameMs;
+    return percentileOf(times, percentile);
+}
+
+// Возвращает количество кадров в окне, которые показали результат ввода.
+std::size_t RenderStats::getInputFrameCount() const
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < m_count; ++i) count += m_frames[i].inputLatencyMs >= 0.0;
+    return count;
+}
+
+// Возвращает среднюю задержку от ввода до вывода кадра (только кадры с вводом).
+double RenderStats::getAverageInputLatencyMs() const
+{
+    double total = 0.0;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < m_count; ++i) {
+        if (m_frames[i].inputLatencyMs < 0.0) continue;
+        total += m_frames[i].inputLatencyMs;
+        ++count;
+    }
+    return count == 0 ? 0.0 : total / count;
+}
+
+// Возвращает процентиль задержки от ввода до вывода кадра (только кадры с вводом).
+double RenderStats::getPercentileInputLatencyMs(double percentile) const
+{
+    std::vector<double> latencies;
+    latencies.reserve(m_count);
+    for (std::size_t i = 0; i < m_count; ++i) {
+        if (m_frames[i].inputLatencyMs >= 0.0) latencies.push_back(m_frames[i].inputLatencyMs);
+    }
+    return percentileOf(latencies, percentile);
+}
+
+// Возвращает среднюю долю попаданий в кэш слоя.
+double RenderStats::getAverageCacheHitRate() const
+{
+    if (m_count == 0) return 1.0;
+    double total = 0.0;
+    for (std::size_t i = 0; i < m_count; ++i) total += m_frames[i].cacheHitRate;
+    return total / m_count;
+}
+
+// Возвращает процентиль значений (ближайший ранг); пустой набор дает 0.
+double RenderStats::percentileOf(std::vector<double>& values, double percentile)
+{
+    if (values.empty()) return 0.0;
+    const std::size_t count = values.size();
+    const double rank = std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * count);
+    const std::size_t index = std::min(count - 1, static_cast<std::size_t>(std::max(rank, 1.0)) - 1);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Очищает окно кадров.
+void RenderStats::clear()
+{
+    m_next = 0;
+    m_count = 0;
+}
+
+// Начинает запись в CSV.
+bool RenderStats::startCsv(const QString& path, QString* error)
+{
+    stopCsv();
+
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        if (error) *error = QString("Не удалось открыть файл: %1").arg(file->errorString());
+        return false;
+    }
+    file->write("frame,frame_ms,visited,culled,drawn,draw_calls,cache_hit_rate,input_latency_ms\n");
+    m_csv = std::move(file);
+    m_csvFrame = 0;
+    return true;
+}
+
+// Завершает запись в CSV.
+void RenderStats::stopCsv()
+{
+    if (!m_csv) return;
+    m_csv->flush();
+    m_csv->close();
+    m_csv.reset();
+}
+
+// Возвращает true, если ведется запись в CSV.
+bool RenderStats::isRecordingCsv() const
+{
+    return m_csv != nullptr;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class QFile;
+
+// Показатели одного кадра отрисовки.
+struct FrameStats
+{
+    double frameMs = 0.0;        // Время кадра, мс.
+    std::size_t visited = 0;     // Примитивы, которые рассмотрел отрисовщик (кандидаты от индекса).
+    std::size_t culled = 0;      // Примитивы сцены, которые не пришлось рассматривать (отсечены индексом или кэшем).
+    std::size_t drawn = 0;       // Примитивы, переданные стратегиям отрисовки.
+    std::size_t drawCalls = 0;   // Вызовы рисования QPainter (пакеты линий, точек, вывод плиток).
+    double cacheHitRate = 1.0;   // Доля пикселей кадра, взятых из кэшированного слоя без перерисовки.
+    double inputLatencyMs = -1.0; // Время от самого раннего показанного ввода до вывода кадра, мс (отрицательно, если ввода не было).
+};
+
+// Статистика отрисовки за скользящее окно последних кадров.
+// Хранит кольцевой буфер кадров, считает среднее и процентили времени кадра
+// и при необходимости пишет показатели каждого кадра в CSV-файл.
+class RenderStats
+{
+public:
+    // Создает статистику с окном из window кадров.
+    explicit RenderStats(std::size_t window = 240);
+
+    // Закрывает CSV-файл, если запись велась.
+    ~RenderStats();
+
+    // Добавляет кадр в окно (и строку в CSV, если запись включена).
+    void addFrame(const FrameStats& frame);
+
+    // Возвращает последний добавленный кадр.
+    const FrameStats& getLastFrame() const;
+
+    // Возвращает количество кадров в окне.
+    std::size_t getFrameCount() const;
+
+    // Возвращает среднее время кадра в окне, мс.
+    double getAverageFrameMs() const;
+
+    // Возвращает процентиль времени кадра в окне (percentile от 0 до 100), мс.
+    double getPercentileFrameMs(double percentile) const;
+
+    // Возвращает количество кадров в окне, которые показали результат ввода.
+    std::size_t getInputFrameCount() const;
+
+    // Возвращает среднюю задержку от ввода до вывода кадра за окно (только кадры с вводом), мс.
+    double getAverageInputLatencyMs() const;
+
+    // Возвращает процентиль задержки от ввода до вывода кадра за окно (только кадры с вводом), мс.
+    double getPercentileInputLatencyMs(double percentile) const;
+
+    // Возвращает среднюю долю попаданий в кэш слоя за окно.
+    double getAverageCacheHitRate() const;
+
+    // Очищает окно кадров.
+    void clear();
+
+    // Начинает запись показателей каждого кадра в CSV-файл. При ошибке возвращает false и описание в error.
+    bool startCsv(const QString& path, QString* error = nullptr);
+
+    // Завершает запись в CSV.
+    void stopCsv();
+
+    // Возвращает true, если ведется запись в CSV.
+    bool isRecordingCsv() const;
+
+private:
+    // Возвращает процентиль значений values (ближайший ранг); values переупорядочивается.
+    static double percentileOf(std::vector<double>& values, double percentile);
+
+    std::vector<FrameStats> m_frames; // Кольцевой буфер кадров.
+    std::size_t m_window;
+    std::size_t m_next = 0;
+    std::size_t m_count = 0;
+
+    std::unique_ptr<QFile> m_csv;
+    std::uint64_t m_csvFrame = 0; // Номер кадра с начала записи.
+};
@@ -1,9 +1,17 @@
 #include "SegmentDraw.h"
 #include "Segment.h"
+#include "SegmentStore.h"
+#include "Trace.h"
 
 #include <QPainter>
 #include <QPen>
 
+#include <QLineF>
+#include <QPointF>
+
+#include <cmath>
+#include <vector>
+
 //Метод отрисовки отрезка
 void SegmentDraw::draw(QPainter& painter, Object* primitive, bool isSelected) const
 {
@@ -28,3 +36,106 @@ void SegmentDraw::draw(QPainter& painter, Object* primitive, bool isSelected) co
         painter.drawLine(start, end);
     }
 }
+
+namespace {
+
+// Толщина основной линии отрезка.
+constexpr double kLineWidth = 1.5;
+
+// Толщина и прозрачность подсветки выбранного отрезка.
+constexpr double kHighlightWidth = 6.0;
+constexpr int kHighlightAlpha = 100;
+
+// Буферы пакетной отрисовки, сгруппированные по индексу стиля.
+// У каждого потока свои буферы: плитки кадра рисуются параллельно (TileRenderer),
+// а между кадрами выделенная память переиспользуется.
+struct BatchBuffers
+{
+    std::vector<std::vector<QLineF>> lines;    // Линии отрезков.
+    std::vector<std::vector<QPointF>> splats;  // Точки для отрезков короче пикселя.
+    std::vector<std::vector<QLineF>> selected; // Подсветка выбранных отрезков.
+};
+
+thread_local BatchBuffers t_batches;
+
+} // namespace
+
+// Пакетная отрисовка отрезков, сгруппированных по стилю.
+std::size_t SegmentDraw::drawBatch(QPainter& painter, const SegmentStore& segments,
+                                   const std::vector<std::size_t>& rows, const std::vector<std::size_t>& selectedRows,
+                                   double lodPixelSize) const
+{
+    UCAD_TRACE_SCOPE("SegmentDraw::drawBatch");
+    const std::vector<QColor>& styles = segments.getStyles();
+    BatchBuffers& buffers = t_batches;
+    if (buffers.lines.size() < styles.size()) {
+        buffers.lines.resize(styles.size());
+        buffers.selected.resize(styles.size());
+        buffers.splats.resize(styles.size());
+    }
+    for (auto& batch : buffers.lines) batch.clear();
+    for (auto& batch : buffers.selected) batch.clear();
+    for (auto& batch : buffers.splats) batch.clear();
+
+    // 1. Раскладываем отрезки по буферам их стилей.
+    const double* x0 = segments.x0Data();
+    const double* y0 = segments.y0Data();
+    const double* x1 = segments.x1Data();
+    const double* y1 = segments.y1Data();
+    const std::uint32_t* style = segments.styleData();
+    for (std::size_t row : rows) {
+        const QLineF line(x0[row], y0[row], x1[row], y1[row]);
+
+        // Отрезок меньше пикселя по обеим осям заменяется точкой в его середине.
+        if (std::abs(x1[row] - x0[row]) < lodPixelSize && std::abs(y1[row] - y0[row]) < lodPixelSize) {
+            buffers.splats[style[row]].push_back(line.center());
+        } else {
+            buffers.lines[style[row]].push_back(line);
+        }
+    }
+
+    for (std::size_t row : selectedRows) {
+        buffers.selected[style[row]].push_back(QLineF(x0[row], y0[row], x1[row], y1[row]));
+    }
+
+    std::size_t drawCalls = 0;
+
+    // 2. Выводим каждую группу одним вызовом с одной сменой пера.
+    for (std::size_t i = 0; i < styles.size(); ++i) {
+        const auto& batch = buffers.lines[i];
+        if (batch.empty()) continue;
+        painter.setPen(QPen(styles[i], kLineWidth));
+        painter.drawLines(batch.data(), static_cast<int>(batch.size()));
+        ++drawCalls;
+    }
+
+    // 3. Точки для субпиксельных отрезков: косметическое перо в 1 пиксель без сглаживания.
+    bool hasSplats = false;
+    for (const auto& batch : buffers.splats) hasSplats = hasSplats || !batch.empty();
+    if (hasSplats) {
+        painter.save();
+        painter.setRenderHint(QPainter::Antialiasing, false);
+        for (std::size_t i = 0; i < styles.size(); ++i) {
+            const auto& batch = buffers.splats[i];
+            if (batch.empty()) continue;
+            QPen splatPen(styles[i], 0.0);
+            splatPen.setCosmetic(true);
+            painter.setPen(splatPen);
+            painter.drawPoints(batch.data(), static_cast<int>(batch.size()));
+            ++drawCalls;
+        }
+        painter.restore();
+    }
+
+    // 4. Подсветка выбранных отрезков поверх основных линий.
+    for (std::size_t i = 0; i < styles.size(); ++i) {
+        const auto& batch = buffers.selected[i];
+        if (batch.empty()) continue;
+        QColor highlightColor = styles[i];
+        highlightColor.setAlpha(kHighlightAlpha);
+        painter.setPen(QPen(highlightColor, kHighlightWidth, Qt::SolidLine, Qt::RoundCap));
+        painter.drawLines(batch.data(), static_cast<int>(batch.size()));
+        ++drawCalls;
+    }
+    return drawCalls;
+}
@@ -2,6 +2,11 @@
 
 #include "Draw.h"
 
+#include <vector>
+#include <cstddef>
+
+class SegmentStore;
+
 // Класс, отвечающий за отрисовку примитива "Отрезок".
 class SegmentDraw : public Draw
 {
@@ -9,4 +14,15 @@ class SegmentDraw : public Draw
 public:
     // Реализует метод отрисовки для отрезка.
     void draw(QPainter& painter, Object* primitive, bool isSelected = false) const override;
+
+    // Пакетная отрисовка строк хранилища отрезков. Отрезки группируются по стилю
+    // (цвет и состояние выделения), и каждая группа выводится одним вызовом drawLines
+    // с однократной установкой пера. selectedRows - строки выделенных отрезков (подсвечиваются поверх).
+    // Если задан lodPixelSize (размер пикселя в мировых единицах), отрезки короче пикселя
+    // не обводятся пером, а выводятся точками одним вызовом drawPoints на стиль.
+    // Метод можно вызывать одновременно из нескольких потоков (буферы у каждого потока свои).
+    // Возвращает количество выполненных вызовов рисования QPainter.
+    std::size_t drawBatch(QPainter& painter, const SegmentStore& segments,
+                          const std::vector<std::size_t>& rows, const std::vector<std::size_t>& selectedRows,
+                          double lodPixelSize = 0.0) const;
 };
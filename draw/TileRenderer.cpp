@@ -0,0 +1,191 @@
+#include "TileRenderer.h"
+#include "Scene.h"
+#include "Selection.h"
+#include "Segment.h"
+#include "SegmentDraw.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// Запас на толщину пера подсветки в мировых единицах (как у слоя сцены во вьюпорте).
+constexpr double kWorldMargin = 3.0;
+
+// Наименьшая допустимая сторона плитки в логических пикселях.
+constexpr int kMinTileSize = 16;
+
+} // namespace
+
+// Устанавливает сторону плитки.
+void TileRenderer::setTileSize(int size)
+{
+    m_tileSize = std::max(size, kMinTileSize);
+}
+
+// Возвращает сторону плитки.
+int TileRenderer::getTileSize() const
+{
+    return m_tileSize;
+}
+
+// Рисует область сцены по плиткам на рабочих потоках и выводит плитки на painter.
+TileRenderer::Counters TileRenderer::render(QPainter& painter, const QRect& screenRect, Scene& scene,
+                                            const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                                            const Selection* selection, const View& view)
+{
+    if (screenRect.isEmpty()) return Counters();
+
+    const QRectF worldRect = view.worldToScreen.inverted().mapRect(QRectF(screenRect))
+                                 .adjusted(-kWorldMargin, -kWorldMargin, kWorldMargin, kWorldMargin);
+    m_visibleHandles.clear();
+    scene.queryPrimitives(worldRect, m_visibleHandles);
+    return renderPrimitives(painter, screenRect, scene, strategies, selection, view, m_visibleHandles);
+}
+
+// Рисует указанные примитивы по плиткам на рабочих потоках и выводит плитки на painter.
+TileRenderer::Counters TileRenderer::renderPrimitives(QPainter& painter, const QRect& screenRect, Scene& scene,
+                                                      const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                                                      const Selection* selection, const View& view,
+                                                      const std::vector<Handle>& handles)
+{
+    UCAD_TRACE_SCOPE("TileRenderer::renderPrimitives");
+    if (screenRect.isEmpty() || handles.empty()) return Counters();
+
+    const int columns = (screenRect.width() + m_tileSize - 1) / m_tileSize;
+    const int rows = (screenRect.height() + m_tileSize - 1) / m_tileSize;
+    const std::size_t tileCount = static_cast<std::size_t>(columns) * rows;
+    if (m_tiles.size() < tileCount) m_tiles.resize(tileCount);
+
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            Tile& tile = m_tiles[row * columns + column];
+            const QRect cell(screenRect.left() + column * m_tileSize, screenRect.top() + row * m_tileSize,
+                             m_tileSize, m_tileSize);
+            tile.rect = cell & screenRect;
+            tile.rows.clear();
+            tile.selectedRows.clear();
+            tile.others.clear();
+            tile.drawCalls = 0;
+        }
+    }
+
+    Counters counters;
+    counters.drawn = assignPrimitives(scene, selection, view, screenRect, columns, rows, handles);
+
+    // Плитки разной плотности рисуются разное время, поэтому потоки берут их по одной
+    // из общего счетчика, а не делят диапазон поровну заранее.
+    std::atomic<std::size_t> nextTile{0};
+    parallelFor(std::min<std::size_t>(parallelThreadCount(), tileCount), 1, [&](std::size_t, std::size_t) {
+        for (std::size_t i = nextTile++; i < tileCount; i = nextTile++) {
+            if (hasContent(m_tiles[i])) renderTile(m_tiles[i], scene, strategies, view);
+        }
+    });
+
+    // Плитки не пересекаются и выводятся в вызывающем потоке.
+    for (std::size_t i = 0; i < tileCount; ++i) {
+        const Tile& tile = m_tiles[i];
+        if (!hasContent(tile)) continue;
+        painter.drawImage(tile.rect.topLeft(), tile.image);
+        counters.drawCalls += tile.drawCalls + 1;
+    }
+    return counters;
+}
+
+// Раскладывает примитивы по плиткам, которые задевают их прямоугольники.
+std::size_t TileRenderer::assignPrimitives(Scene& scene, const Selection* selection, const View& view,
+                                           const QRect& screenRect, int columns, int rows,
+                                           const std::vector<Handle>& handles)
+{
+    std::size_t assigned = 0;
+    const SegmentStore& segments = scene.getSegments();
+    for (const Handle& handle : handles) {
+        if (!scene.contains(handle)) continue;
+        const std::size_t segmentRow = scene.getSegmentRow(handle);
+        const QRectF box = (segmentRow != SegmentStore::npos) ? segments.getBoundingBox(segmentRow)
+                                                              : scene.getBoundingBox(handle);
+        const QRect screenBox = view.worldToScreen
+                                    .mapRect(box.adjusted(-kWorldMargin, -kWorldMargin, kWorldMargin, kWorldMargin))
+                                    .toAlignedRect().adjusted(-1, -1, 1, 1) & screenRect;
+        if (screenBox.isEmpty()) continue;
+        ++assigned;
+
+        const int firstColumn = (screenBox.left() - screenRect.left()) / m_tileSize;
+        const int lastColumn = std::min(columns - 1, (screenBox.right() - screenRect.left()) / m_tileSize);
+        const int firstRow = (screenBox.top() - screenRect.top()) / m_tileSize;
+        const int lastRow = std::min(rows - 1, (screenBox.bottom() - screenRect.top()) / m_tileSize);
+
+        const bool isSelected = selection && selection->contains(handle);
+        Object* primitive = (segmentRow == SegmentStore::npos) ? scene.getPrimitive(handle) : nullptr;
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                Tile& tile = m_tiles[row * columns + column];
+                if (segmentRow != SegmentStore::npos) {
+                    tile.rows.push_back(segmentRow);
+                    if (isSelected) tile.selectedRows.push_back(segmentRow);
+                } else if (primitive) {
+                    tile.others.emplace_back(primitive, isSelected);
+                }
+            }
+        }
+    }
+    return assigned;
+}
+
+// Рисует примитивы плитки в ее собственный растр.
+void TileRenderer::renderTile(Tile& tile, Scene& scene, const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                              const View& view) const
+{
+    UCAD_TRACE_SCOPE("TileRenderer::renderTile");
+    const QSize pixelSize = tile.rect.size() * view.pixelRatio;
+    if (tile.image.size() != pixelSize) {
+        tile.image = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+    }
+    tile.image.setDevicePixelRatio(view.pixelRatio);
+    tile.image.fill(Qt::transparent);
+
+    QPainter painter(&tile.image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-tile.rect.topLeft());
+    painter.setTransform(view.worldToScreen, true);
+
+    auto segmentDraw = strategies.find(PrimitiveType::Segment);
+    if (segmentDraw != strategies.end() && !tile.rows.empty()) {
+        if (const auto* batchDraw = dynamic_cast<const SegmentDraw*>(segmentDraw->second.get())) {
+            tile.drawCalls += batchDraw->drawBatch(painter, scene.getSegments(), tile.rows, tile.selectedRows,
+                                                   view.lodPixelSize);
+        } else {
+            // Стратегия без пакетной отрисовки рисует отрезки по одному через представления.
+            // Выделенные строки записаны в том же порядке, что и все строки плитки,
+            // поэтому признак выделения читается одним проходом по обоим спискам.
+            const SegmentStore& segments = scene.getSegments();
+            std::size_t nextSelected = 0;
+            for (std::size_t row : tile.rows) {
+                Segment segmentView(&scene, segments.getHandle(row));
+                const bool isSelected =
+                    nextSelected < tile.selectedRows.size() && tile.selectedRows[nextSelected] == row;
+                if (isSelected) ++nextSelected;
+                segmentDraw->second->draw(painter, &segmentView, isSelected);
+                ++tile.drawCalls;
+            }
+        }
+    }
+
+    for (const auto& [primitive, isSelected] : tile.others) {
+        auto it = strategies.find(primitive->getType());
+        if (it != strategies.end()) {
+            it->second->draw(painter, primitive, isSelected);
+            ++tile.drawCalls;
+        }
+    }
+}
+
+// Возвращает true, если в плитке есть примитивы.
+bool TileRenderer::hasContent(const Tile& tile)
+{
+    return !tile.rows.empty() || !tile.others.empty();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Enums.h"
+#include "Handle.h"
+
+#include <QImage>
+#include <QRect>
+#include <QTransform>
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+class QPainter;
+class Scene;
+class Selection;
+class Draw;
+class Object;
+
+// Параллельная программная растеризация сцены по плиткам.
+// Область делится на квадратные плитки; видимые примитивы раскладываются по плиткам,
+// которые они задевают, и каждая плитка рисуется в собственный QImage на рабочем потоке
+// теми же стратегиями отрисовки (Draw). Готовые плитки выводятся на painter в вызывающем потоке.
+// Сцена читается только из вызывающего потока (запрос к индексу и раскладка),
+// рабочие потоки лишь читают столбцы хранилища отрезков.
+class TileRenderer
+{
+public:
+    // Параметры вида, для которого рисуется область.
+    struct View
+    {
+        QTransform worldToScreen; // Преобразование из мировых координат в логические пиксели.
+        double pixelRatio = 1.0;  // Плотность пикселей целевого изображения.
+        double lodPixelSize = 0.0; // Размер пикселя в мировых единицах для режима детализации (0 - выключен).
+    };
+
+    // Счетчики одного вызова отрисовки (для статистики кадра).
+    struct Counters
+    {
+        std::size_t drawn = 0;     // Примитивы, попавшие хотя бы в одну плитку.
+        std::size_t drawCalls = 0; // Вызовы рисования QPainter во всех плитках и при выводе плиток.
+    };
+
+    // Устанавливает сторону плитки в логических пикселях.
+    void setTileSize(int size);
+
+    // Возвращает сторону плитки в логических пикселях.
+    int getTileSize() const;
+
+    // Рисует примитивы сцены, попадающие в область screenRect (логические пиксели), на painter.
+    // painter должен быть направлен на изображение без собственного преобразования.
+    Counters render(QPainter& painter, const QRect& screenRect, Scene& scene,
+                    const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                    const Selection* selection, const View& view);
+
+    // Рисует в области screenRect только указанные примитивы (например, очередную порцию
+    // прогрессивной отрисовки). Примитивы вне области отсекаются.
+    Counters renderPrimitives(QPainter& painter, const QRect& screenRect, Scene& scene,
+                              const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                              const Selection* selection, const View& view, const std::vector<Handle>& handles);
+
+private:
+    // Плитка: область, собственный растр и примитивы, которые ее задевают.
+    struct Tile
+    {
+        QRect rect;
+        QImage image;
+        std::vector<std::size_t> rows;         // Строки видимых отрезков.
+        std::vector<std::size_t> selectedRows; // Строки выделенных отрезков (в порядке rows).
+        std::vector<std::pair<Object*, bool>> others; // Прочие примитивы и признак выделения.
+        std::size_t drawCalls = 0;             // Вызовы рисования при отрисовке плитки.
+    };
+
+    // Раскладывает примитивы по плиткам, которые задевают их прямоугольники.
+    // Возвращает количество примитивов, попавших хотя бы в одну плитку.
+    std::size_t assignPrimitives(Scene& scene, const Selection* selection, const View& view, const QRect& screenRect,
+                          int columns, int rows, const std::vector<Handle>& handles);
+
+    // Возвращает true, если плитку нужно вывести (в ней есть примитивы).
+    static bool hasContent(const Tile& tile);
+
+    // Рисует одну плитку (вызывается из рабочего потока).
+    void renderTile(Tile& tile, Scene& scene, const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                    const View& view) const;
+
+    int m_tileSize = 256;
+    std::vector<Tile> m_tiles; // Плитки (растры переиспользуются между кадрами).
+    std::vector<Handle> m_visibleHandles;
+};
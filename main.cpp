@@ -1,4 +1,5 @@
 #include "CadWindow.h"
+#include "Trace.h"
 
 #include <QApplication>
 #include <QFile>
@@ -8,6 +9,7 @@ int main(int argc, char *argv[])
 {
     // Инициализация приложения Qt.
     QApplication a(argc, argv);
+    Trace::setThreadName("GUI");
 
     // Загрузка и применение таблицы стилей QSS.
     QFile file(":/styles.qss");
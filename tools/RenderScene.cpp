@@ -0,0 +1,328 @@
+#include "Scene.h"
+#include "SegmentStore.h"
+#include "Segment.h"
+#include "SegmentDraw.h"
+#include "SceneFile.h"
+#include "DxfFile.h"
+#include "TileRenderer.h"
+#include "RenderStats.h"
+#include "Parallel.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+// Консольная отрисовка сцены в PNG без запуска интерфейса.
+// Сцена (*.ucad или *.dxf) рисуется теми же стратегиями отрисовки, что и во вьюпорте,
+// в QImage на платформе offscreen; время загрузки и отрисовки печатается в стандартный вывод.
+
+namespace {
+
+// Цвет фона вьюпорта.
+const char* const kDefaultBackground = "#1A1B26";
+
+// Доля размера изображения, оставляемая полями при вписывании сцены.
+constexpr double kFitMargin = 0.05;
+
+// Параметры отрисовки, заданные в командной строке.
+struct RenderConfig
+{
+    QSize size{1920, 1080};   // Размер изображения в пикселях.
+    QPointF center;           // Мировая точка в центре изображения.
+    double zoom = 1.0;        // Пикселей на мировую единицу.
+    QColor background;        // Цвет фона.
+    int repeats = 1;          // Число повторов отрисовки (в PNG пишется последний).
+    bool tiled = true;        // Параллельная отрисовка по плиткам.
+    bool levelOfDetail = false; // Субпиксельные отрезки выводятся точками.
+};
+
+// Разбирает список из count чисел через запятую. При ошибке возвращает false.
+bool parseNumbers(const QString& text, int count, std::vector<double>& values)
+{
+    const QStringList parts = text.split(',');
+    if (parts.size() != count) return false;
+
+    values.clear();
+    for (const QString& part : parts) {
+        bool ok = false;
+        values.push_back(part.trimmed().toDouble(&ok));
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Разбирает размер вида "ШИРИНАxВЫСОТА". При ошибке возвращает false.
+bool parseSize(const QString& text, QSize& size)
+{
+    const QStringList parts = text.toLower().split('x');
+    if (parts.size() != 2) return false;
+
+    bool okWidth = false;
+    bool okHeight = false;
+    size = QSize(parts[0].toInt(&okWidth), parts[1].toInt(&okHeight));
+    return okWidth && okHeight && size.width() > 0 && size.height() > 0;
+}
+
+// Загружает сцену из файла, формат выбирается по расширению.
+bool loadScene(Scene& scene, const QString& path, QString* error)
+{
+    if (QFileInfo(path).suffix().compare(DxfFile::extension(), Qt::CaseInsensitive) == 0) {
+        return DxfFile::importFrom(scene, path, error);
+    }
+    return SceneFile::load(scene, path, error);
+}
+
+// Возвращает прямоугольник, охватывающий все примитивы сцены (пустой для пустой сцены).
+QRectF getSceneBounds(const Scene& scene)
+{
+    // Один линейный проход по столбцам хранилища отрезков и по прочим примитивам.
+    // Границы накапливаются вручную: QRectF::united пропускает вырожденные прямоугольники точек.
+    double left = std::numeric_limits<double>::max();
+    double top = std::numeric_limits<double>::max();
+    double right = std::numeric_limits<double>::lowest();
+    double bottom = std::numeric_limits<double>::lowest();
+    const SegmentStore& segments = scene.getSegments();
+    for (std::size_t row = 0; row < segments.size(); ++row) {
+        left = std::min({left, segments.getX0(row), segments.getX1(row)});
+        right = std::max({right, segments.getX0(row), segments.getX1(row)});
+        top = std::min({top, segments.getY0(row), segments.getY1(row)});
+        bottom = std::max({bottom, segments.getY0(row), segments.getY1(row)});
+    }
+    for (const auto& primitive : scene.getPrimitives()) {
+        const QRectF box = primitive->getBoundingBox();
+        left = std::min(left, box.left());
+        right = std::max(right, box.right());
+        top = std::min(top, box.top());
+        bottom = std::max(bottom, box.bottom());
+    }
+    if (left > right || top > bottom) return QRectF();
+    return QRectF(QPointF(left, top), QPointF(right, bottom));
+}
+
+// Возвращает масштаб, при котором мировой прямоугольник area целиком помещается в изображение size.
+double fitZoom(const QRectF& area, const QSize& size, double margin)
+{
+    const double width = size.width() * (1.0 - 2.0 * margin);
+    const double height = size.height() * (1.0 - 2.0 * margin);
+    if (area.width() <= 0.0 && area.height() <= 0.0) return 1.0;
+    if (area.width() <= 0.0) return height / area.height();
+    if (area.height() <= 0.0) return width / area.width();
+    return std::min(width / area.width(), height / area.height());
+}
+
+// Рисует видимые примитивы сцены в одном потоке, как вьюпорт без плиток.
+TileRenderer::Counters renderSingleThread(QPainter& painter, const QRect& frame, Scene& scene,
+                                          const std::map<PrimitiveType, std::unique_ptr<Draw>>& strategies,
+                                          const TileRenderer::View& view, std::vector<Handle>& handles,
+                                          std::vector<std::size_t>& rows)
+{
+    TileRenderer::Counters counters;
+    handles.clear();
+    rows.clear();
+    scene.queryPrimitives(view.worldToScreen.inverted().mapRect(QRectF(frame)), handles);
+
+    auto segmentDraw = strategies.find(PrimitiveType::Segment);
+    const auto* segmentBatchDraw =
+        segmentDraw != strategies.end() ? dynamic_cast<const SegmentDraw*>(segmentDraw->second.get()) : nullptr;
+
+    painter.save();
+    painter.setTransform(view.worldToScreen);
+    for (const Handle& handle : handles) {
+        const std::size_t row = scene.getSegmentRow(handle);
+        if (row != SegmentStore::npos) {
+            if (segmentBatchDraw) rows.push_back(row);
+            continue;
+        }
+
+        Object* primitive = scene.getPrimitive(handle);
+        if (!primitive) continue;
+        auto it = strategies.find(primitive->getType());
+        if (it != strategies.end()) {
+            it->second->draw(painter, primitive);
+            ++counters.drawn;
+            ++counters.drawCalls;
+        }
+    }
+
+    if (segmentBatchDraw) {
+        counters.drawCalls += segmentBatchDraw->drawBatch(painter, scene.getSegments(), rows, {}, view.lodPixelSize);
+        counters.drawn += rows.size();
+    }
+    painter.restore();
+    return counters;
+}
+
+} // namespace
+
+// Точка входа консольной отрисовки.
+int main(int argc, char *argv[])
+{
+    // Отрисовка в QImage не требует дисплея.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders a UniversityCAD scene (.ucad or .dxf) to a PNG image without a display.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scene", "Scene file to render (.ucad or .dxf).");
+    QCommandLineOption outputOption({"o", "output"}, "Write the image to <file>.", "file", "render.png");
+    QCommandLineOption sizeOption("size", "Image size in pixels.", "WIDTHxHEIGHT", "1920x1080");
+    QCommandLineOption viewOption("view", "World rectangle to fit into the image.", "x0,y0,x1,y1");
+    QCommandLineOption centerOption("center", "World point at the image center (default: scene center).", "x,y");
+    QCommandLineOption zoomOption("zoom", "Pixels per world unit (default: fit the scene).", "factor");
+    QCommandLineOption backgroundOption("background", "Background color.", "color", kDefaultBackground);
+    QCommandLineOption repeatsOption("repeats", "Render the frame <count> times and report timing statistics.", "count", "1");
+    QCommandLineOption singleThreadOption("single-thread", "Render on the calling thread instead of parallel tiles.");
+    QCommandLineOption tileSizeOption("tile-size", "Tile side in pixels for parallel rendering.", "pixels", "256");
+    QCommandLineOption lodOption("lod", "Draw sub-pixel segments as points (viewport level of detail).");
+    parser.addOptions({outputOption, sizeOption, viewOption, centerOption, zoomOption, backgroundOption,
+                       repeatsOption, singleThreadOption, tileSizeOption, lodOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 1) {
+        err << "Expected exactly one scene file.\n";
+        parser.showHelp(1);
+    }
+
+    RenderConfig config;
+    config.repeats = std::max(1, parser.value(repeatsOption).toInt());
+    config.tiled = !parser.isSet(singleThreadOption);
+    config.levelOfDetail = parser.isSet(lodOption);
+    config.background = QColor(parser.value(backgroundOption));
+    if (!parseSize(parser.value(sizeOption), config.size)) {
+        err << "Invalid --size: " << parser.value(sizeOption) << "\n";
+        return 1;
+    }
+    if (!config.background.isValid()) {
+        err << "Invalid --background: " << parser.value(backgroundOption) << "\n";
+        return 1;
+    }
+
+    // Загрузка сцены.
+    Scene scene;
+    const QString scenePath = parser.positionalArguments().first();
+    QElapsedTimer timer;
+    timer.start();
+    QString error;
+    if (!loadScene(scene, scenePath, &error)) {
+        err << error << "\n";
+        return 1;
+    }
+    const double loadMs = timer.nsecsElapsed() / 1.0e6;
+
+    // Индексы слоев и таблица ID после загрузки *.ucad строятся лениво; их построение
+    // измеряется отдельно, чтобы не попасть во время первой отрисовки.
+    timer.restart();
+    scene.ensureLookups();
+    const double indexMs = timer.nsecsElapsed() / 1.0e6;
+
+    // Вид: явный прямоугольник, либо центр и масштаб, либо вся сцена.
+    std::vector<double> values;
+    if (parser.isSet(viewOption)) {
+        if (!parseNumbers(parser.value(viewOption), 4, values)) {
+            err << "Invalid --view: " << parser.value(viewOption) << "\n";
+            return 1;
+        }
+        const QRectF area = QRectF(QPointF(values[0], values[1]), QPointF(values[2], values[3])).normalized();
+        config.center = area.center();
+        config.zoom = fitZoom(area, config.size, 0.0);
+    } else {
+        const QRectF bounds = getSceneBounds(scene);
+        config.center = bounds.center();
+        config.zoom = fitZoom(bounds, config.size, kFitMargin);
+    }
+    if (parser.isSet(centerOption)) {
+        if (!parseNumbers(parser.value(centerOption), 2, values)) {
+            err << "Invalid --center: " << parser.value(centerOption) << "\n";
+            return 1;
+        }
+        config.center = QPointF(values[0], values[1]);
+    }
+    if (parser.isSet(zoomOption)) {
+        bool ok = false;
+        config.zoom = parser.value(zoomOption).toDouble(&ok);
+        if (!ok || config.zoom <= 0.0) {
+            err << "Invalid --zoom: " << parser.value(zoomOption) << "\n";
+            return 1;
+        }
+    }
+
+    // Ось Y сцены направлена вверх, как во вьюпорте.
+    TileRenderer::View view;
+    view.worldToScreen.translate(config.size.width() / 2.0, config.size.height() / 2.0);
+    view.worldToScreen.scale(config.zoom, -config.zoom);
+    view.worldToScreen.translate(-config.center.x(), -config.center.y());
+    view.lodPixelSize = config.levelOfDetail ? 1.0 / config.zoom : 0.0;
+
+    std::map<PrimitiveType, std::unique_ptr<Draw>> strategies;
+    strategies[PrimitiveType::Segment] = std::make_unique<SegmentDraw>();
+
+    TileRenderer renderer;
+    renderer.setTileSize(parser.value(tileSizeOption).toInt());
+
+    // Отрисовка; время каждого повтора попадает в статистику кадров.
+    QImage image(config.size, QImage::Format_ARGB32_Premultiplied);
+    const QRect frame = image.rect();
+    RenderStats stats(static_cast<std::size_t>(config.repeats));
+    std::vector<Handle> handles;
+    std::vector<std::size_t> rows;
+    for (int repeat = 0; repeat < config.repeats; ++repeat) {
+        timer.restart();
+        image.fill(config.background);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        const TileRenderer::Counters counters =
+            config.tiled ? renderer.render(painter, frame, scene, strategies, nullptr, view)
+                         : renderSingleThread(painter, frame, scene, strategies, view, handles, rows);
+        painter.end();
+
+        FrameStats frameStats;
+        frameStats.frameMs = timer.nsecsElapsed() / 1.0e6;
+        frameStats.drawn = counters.drawn;
+        frameStats.drawCalls = counters.drawCalls;
+        frameStats.culled = scene.getPrimitiveCount() - std::min(scene.getPrimitiveCount(), counters.drawn);
+        frameStats.cacheHitRate = 0.0;
+        stats.addFrame(frameStats);
+    }
+
+    timer.restart();
+    const QString outputPath = parser.value(outputOption);
+    if (!image.save(outputPath, "PNG")) {
+        err << "Cannot write " << outputPath << "\n";
+        return 1;
+    }
+    const double saveMs = timer.nsecsElapsed() / 1.0e6;
+
+    const FrameStats& last = stats.getLastFrame();
+    out << QString("scene:      %1 (%2 primitives)\n").arg(scenePath).arg(scene.getPrimitiveCount());
+    out << QString("view:       center (%1, %2), zoom %3, %4x%5 px\n")
+               .arg(config.center.x()).arg(config.center.y()).arg(config.zoom)
+               .arg(config.size.width()).arg(config.size.height());
+    out << QString("renderer:   %1\n").arg(config.tiled ? QString("tiles (%1 threads)").arg(parallelThreadCount())
+                                                         : QString("single thread"));
+    out << QString("load:       %1 ms\n").arg(loadMs, 0, 'f', 3);
+    out << QString("index:      %1 ms\n").arg(indexMs, 0, 'f', 3);
+    out << QString("render:     last %1 ms, avg %2 ms, p50 %3 ms, p99 %4 ms (%5 runs)\n")
+               .arg(last.frameMs, 0, 'f', 3)
+               .arg(stats.getAverageFrameMs(), 0, 'f', 3)
+               .arg(stats.getPercentileFrameMs(50.0), 0, 'f', 3)
+               .arg(stats.getPercentileFrameMs(99.0), 0, 'f', 3)
+               .arg(stats.getFrameCount());
+    out << QString("drawn:      %1 primitives, %2 draw calls\n").arg(last.drawn).arg(last.drawCalls);
+    out << QString("save:       %1 ms -> %2\n").arg(saveMs, 0, 'f', 3).arg(outputPath);
+    return 0;
+}
@@ -7,10 +7,24 @@
 #include "Segment.h"
 #include "Draw.h"
 #include "SegmentDraw.h"
+#include "SceneFile.h"
+#include "DxfFile.h"
+#include "Trace.h"
+#include "IntersectionFinder.h"
 
 #include <QSplitter>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QAction>
+#include <QKeySequence>
 #include <QScreen>
 #include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QInputDialog>
+#include <QLineEdit>
+
+#include <algorithm>
+#include <cmath>
 
 // Конструктор главного окна.
 CadWindow::CadWindow(QWidget *parent)
@@ -18,23 +32,71 @@ CadWindow::CadWindow(QWidget *parent)
     m_activePrimitiveType(PrimitiveType::Generic) // Инициализация
 {
     m_scene = new Scene();
+    m_scene->addListener(this);
+    m_scene->setUndoJournal(&m_undoJournal);
     setupDrawingStrategies();
     setupUi();
     createConnections();
+    createActions();
 
     m_viewportPanel->setScene(m_scene);
     m_viewportPanel->setDrawingStrategies(&m_drawingStrategies);
+    m_viewportPanel->setSelection(&m_selection);
+    m_propertiesPanel->setScene(m_scene);
 
-    // Первоначальное обновление списка объектов при запуске.
-    emit sceneChanged(m_scene);
+    // Первоначальное заполнение списка объектов при запуске.
+    m_controlPanel->setScene(m_scene);
 }
 
 // Деструктор.
 CadWindow::~CadWindow()
 {
+    m_scene->removeListener(this);
     delete m_scene;
 }
 
+// Пересылает уведомление сцены панелям и синхронизирует выбор.
+void CadWindow::onSceneChanged(const SceneChange& change)
+{
+    UCAD_TRACE_SCOPE("CadWindow::onSceneChanged");
+    if (change.reset) {
+        // Сцена заменена целиком: дескрипторы выделения устарели и могут совпасть с новыми.
+        m_selection.clear();
+        emit sceneChanged(change);
+        updatePropertiesForSelection();
+        return;
+    }
+
+    emit sceneChanged(change);
+
+    if (m_selection.isEmpty()) return;
+
+    // Объекты скрытого или заблокированного слоя нельзя выбирать и изменять.
+    if (!change.layers.empty()) dropUneditableFromSelection();
+
+    // Удаленные объекты исключаются из выделения.
+    bool selectionChanged = false;
+    for (const auto& entry : change.removed) {
+        if (m_selection.contains(entry.handle)) {
+            m_selection.remove(entry.handle);
+            selectionChanged = true;
+        }
+    }
+
+    // Единственный выделенный объект изменен - обновляем поля панели свойств.
+    const Handle single = m_selection.single();
+    for (const auto& entry : change.modified) {
+        if (single.isValid() && entry.handle == single) {
+            selectionChanged = true;
+            break;
+        }
+    }
+
+    if (selectionChanged) {
+        updatePropertiesForSelection();
+    }
+}
+
 // Создает и компонует основной пользовательский интерфейс.
 void CadWindow::setupUi()
 {
@@ -66,18 +128,71 @@ void CadWindow::createConnections()
     connect(m_controlPanel, &Control::angleUnitChanged, this, &CadWindow::onAngleUnitChanged);
     connect(m_controlPanel, &Control::coordinateSystemChanged, m_propertiesPanel, &Properties::setCoordinateSystem);
     connect(m_controlPanel, &Control::coordinateSystemChanged, m_viewportPanel, &Viewport::setCoordinateSystem);
+    connect(m_controlPanel, &Control::levelOfDetailChanged, m_viewportPanel, &Viewport::setLevelOfDetailEnabled);
+    connect(m_controlPanel, &Control::parallelRenderingChanged, m_viewportPanel, &Viewport::setParallelRenderingEnabled);
+    connect(m_controlPanel, &Control::snappingChanged, m_viewportPanel, &Viewport::setSnappingEnabled);
 
     // Соединение для создания объектов.
     connect(m_controlPanel, &Control::primitiveTypeSelected, this, &CadWindow::onPrimitiveTypeSelected);
     connect(m_propertiesPanel, &Properties::segmentCreateRequested, this, &CadWindow::createSegment);
+    connect(m_viewportPanel, &Viewport::segmentDrawn, this, &CadWindow::onSegmentDrawn);
 
     // Соединения для выбора, удаления и ИЗМЕНЕНИЯ объектов.
     connect(m_controlPanel, &Control::deleteRequested, this, &CadWindow::onDeleteRequested);
-    connect(m_controlPanel, &Control::objectSelected, this, &CadWindow::onObjectSelected);
-    connect(m_propertiesPanel, &Properties::objectModified, this, &CadWindow::onObjectModified);
+    connect(m_controlPanel, &Control::intersectionsRequested, this, &CadWindow::onIntersectionsRequested);
+    connect(m_controlPanel, &Control::addLayerRequested, this, &CadWindow::onAddLayerRequested);
+    connect(m_controlPanel, &Control::currentLayerRequested, this, &CadWindow::onCurrentLayerRequested);
+    connect(m_controlPanel, &Control::moveToLayerRequested, this, &CadWindow::onMoveToLayerRequested);
+    connect(m_controlPanel, &Control::layerVisibilityChanged, this, [this](std::uint32_t layer, bool visible) {
+        m_scene->setLayerVisible(layer, visible);
+    });
+    connect(m_controlPanel, &Control::layerLockChanged, this, [this](std::uint32_t layer, bool locked) {
+        m_scene->setLayerLocked(layer, locked);
+    });
+    connect(m_controlPanel, &Control::openRequested, this, &CadWindow::onOpenRequested);
+    connect(m_controlPanel, &Control::saveRequested, this, &CadWindow::onSaveRequested);
+    connect(m_controlPanel, &Control::importDxfRequested, this, &CadWindow::onImportDxfRequested);
+    connect(m_controlPanel, &Control::exportDxfRequested, this, &CadWindow::onExportDxfRequested);
+    connect(m_controlPanel, &Control::moveRequested, this, &CadWindow::onMoveRequested);
+    connect(m_controlPanel, &Control::rotateRequested, this, &CadWindow::onRotateRequested);
+    connect(m_controlPanel, &Control::scaleRequested, this, &CadWindow::onScaleRequested);
+    connect(m_controlPanel, &Control::mirrorRequested, this, &CadWindow::onMirrorRequested);
+    connect(m_controlPanel, &Control::objectsSelected, this, &CadWindow::onObjectsSelected);
+    connect(m_viewportPanel, &Viewport::objectsPicked, this, &CadWindow::onObjectsPicked);
+
+    // Соединения для точечного обновления списка объектов и вьюпорта при изменении сцены.
+    connect(this, &CadWindow::sceneChanged, m_controlPanel, &Control::applySceneChange);
+    connect(this, &CadWindow::sceneChanged, m_viewportPanel, &Viewport::applySceneChange);
+}
 
-    // Соединение для обновления списка объектов при изменении сцены.
-    connect(this, &CadWindow::sceneChanged, m_controlPanel, &Control::updateObjectList);
+// Создает действия окна. Действия добавлены в само окно, поэтому сокращения
+// работают независимо от того, какая панель в фокусе.
+void CadWindow::createActions()
+{
+    auto* undoAction = new QAction("Отменить", this);
+    undoAction->setShortcut(QKeySequence::Undo);
+    connect(undoAction, &QAction::triggered, this, &CadWindow::onUndoRequested);
+    addAction(undoAction);
+
+    auto* redoAction = new QAction("Повторить", this);
+    redoAction->setShortcuts({QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_Z), QKeySequence(QKeySequence::Redo)});
+    connect(redoAction, &QAction::triggered, this, &CadWindow::onRedoRequested);
+    addAction(redoAction);
+
+    auto* statsAction = new QAction("Статистика отрисовки", this);
+    statsAction->setShortcut(Qt::Key_F3);
+    connect(statsAction, &QAction::triggered, this, &CadWindow::onStatsOverlayToggled);
+    addAction(statsAction);
+
+    auto* statsCsvAction = new QAction("Запись статистики в CSV", this);
+    statsCsvAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F3));
+    connect(statsCsvAction, &QAction::triggered, this, &CadWindow::onStatsCsvRequested);
+    addAction(statsCsvAction);
+
+    auto* traceAction = new QAction("Запись трассы", this);
+    traceAction->setShortcut(Qt::Key_F4);
+    connect(traceAction, &QAction::triggered, this, &CadWindow::onTraceRequested);
+    addAction(traceAction);
 }
 
 // Инициализирует стратегии отрисовки для каждого типа примитива.
@@ -104,10 +219,11 @@ void CadWindow::onPrimitiveTypeSelected(PrimitiveType type)
 {
     // Сохраняем, какой инструмент "Создания" сейчас активен.
     m_activePrimitiveType = type;
+    m_viewportPanel->setCreationTool(type);
 
     // Показываем панель "Создания", ТОЛЬКО если сейчас не выбран объект.
     // Если объект выбран, приоритет у панели "Редактирования".
-    if (m_selectedObject == nullptr) {
+    if (m_selection.isEmpty()) {
         m_propertiesPanel->showCreationPropertiesFor(type);
     }
 }
@@ -117,54 +233,356 @@ void CadWindow::createSegment(const Point& start, const Point& end, const QColor
 {
     auto newSegment = std::make_unique<Segment>(start, end);
     newSegment->setColor(color);
-    m_scene->addPrimitive(std::move(newSegment));
+    m_scene->addPrimitive(std::move(newSegment)); // Панели обновятся по уведомлению сцены.
+}
 
-    m_viewportPanel->update();
-    emit sceneChanged(m_scene); // Испускаем сигнал для обновления списка объектов.
+// Слот для создания отрезка, концы которого заданы щелчками во вьюпорте.
+void CadWindow::onSegmentDrawn(const QPointF& start, const QPointF& end)
+{
+    createSegment(Point(start.x(), start.y()), Point(end.x(), end.y()), m_propertiesPanel->getSelectedColor());
 }
 
 // Слот, вызываемый при нажатии кнопки "Удалить".
 void CadWindow::onDeleteRequested()
 {
-    if (m_selectedObject) {
-        m_scene->removePrimitive(m_selectedObject);
-        m_selectedObject = nullptr; // Сбрасываем указатель.
+    UCAD_TRACE_SCOPE("CadWindow::onDeleteRequested");
+    if (!m_selection.isEmpty()) {
+        // Все выделенные объекты удаляются одной транзакцией;
+        // выделение во всех панелях сбросится по уведомлению сцены об удалении.
+        const std::vector<Handle> victims = m_selection.getHandles();
+        m_scene->removePrimitives(victims);
+    }
+}
 
-        // Синхронизируем состояние всех панелей
-        m_viewportPanel->setSelectedObject(nullptr); // Снимаем подсветку
-        // Возвращаем панель свойств в режим "Создание"
-        m_propertiesPanel->showCreationPropertiesFor(m_activePrimitiveType);
+// Загружает сцену из выбранного файла.
+void CadWindow::onOpenRequested()
+{
+    const QString filter = QString("Сцена UniversityCAD (*.%1)").arg(SceneFile::extension());
+    const QString path = QFileDialog::getOpenFileName(this, "Открыть сцену", QString(), filter);
+    if (path.isEmpty()) return;
 
-        m_viewportPanel->update();
-        emit sceneChanged(m_scene); // Обновляем список и вьюпорт.
+    // Панели перестроятся по уведомлению сцены о полной замене содержимого.
+    QString error;
+    if (!SceneFile::load(*m_scene, path, &error)) {
+        QMessageBox::warning(this, "Открыть сцену", error);
     }
 }
 
-// Слот, сохраняющий указатель на выбранный в списке объект.
-void CadWindow::onObjectSelected(Object* selectedObject)
+// Сохраняет сцену в выбранный файл.
+void CadWindow::onSaveRequested()
 {
-    m_selectedObject = selectedObject;
+    const QString filter = QString("Сцена UniversityCAD (*.%1)").arg(SceneFile::extension());
+    QString path = QFileDialog::getSaveFileName(this, "Сохранить сцену", QString(), filter);
+    if (path.isEmpty()) return;
+    if (!path.endsWith(QString(".") + SceneFile::extension())) {
+        path += QString(".") + SceneFile::extension();
+    }
 
-    // 1. Сообщаем Вьюпорту, какой объект подсветить.
-    m_viewportPanel->setSelectedObject(m_selectedObject);
+    QString error;
+    if (!SceneFile::save(*m_scene, path, &error)) {
+        QMessageBox::warning(this, "Сохранить сцену", error);
+    }
+}
+
+// Добавляет на сцену отрезки из выбранного файла DXF.
+void CadWindow::onImportDxfRequested()
+{
+    const QString filter = QString("Чертеж DXF (*.%1)").arg(DxfFile::extension());
+    const QString path = QFileDialog::getOpenFileName(this, "Импорт DXF", QString(), filter);
+    if (path.isEmpty()) return;
 
-    // 2. Сообщаем Панели свойств, какой объект редактировать.
-    if (m_selectedObject) {
-        // Если выбрали объект - показываем панель редактирования.
-        m_propertiesPanel->showEditingPropertiesFor(m_selectedObject);
+    // Импорт - одна транзакция сцены: панели обновляются одним уведомлением, а отменяется он одним шагом.
+    QString error;
+    if (!DxfFile::importFrom(*m_scene, path, &error)) {
+        QMessageBox::warning(this, "Импорт DXF", error);
+    }
+}
+
+// Экспортирует сцену в выбранный файл DXF.
+void CadWindow::onExportDxfRequested()
+{
+    const QString filter = QString("Чертеж DXF (*.%1)").arg(DxfFile::extension());
+    QString path = QFileDialog::getSaveFileName(this, "Экспорт DXF", QString(), filter);
+    if (path.isEmpty()) return;
+    if (!path.endsWith(QString(".") + DxfFile::extension())) {
+        path += QString(".") + DxfFile::extension();
+    }
+
+    QString error;
+    if (!DxfFile::exportTo(*m_scene, path, &error)) {
+        QMessageBox::warning(this, "Экспорт DXF", error);
+    }
+}
+
+// Переносит выделенные объекты на заданное смещение.
+void CadWindow::onMoveRequested(double dx, double dy)
+{
+    transformSelection(Affine2D::translation(dx, dy));
+}
+
+// Поворачивает выделенные объекты вокруг центра выделения (угол - в текущих единицах).
+void CadWindow::onRotateRequested(double angle)
+{
+    const double radians = (Point::getAngleUnit() == AngleUnit::Degrees) ? angle * M_PI / 180.0 : angle;
+    const QPointF center = getSelectionCenter();
+    transformSelection(Affine2D::rotation(radians, center.x(), center.y()));
+}
+
+// Масштабирует выделенные объекты относительно центра выделения.
+void CadWindow::onScaleRequested(double factor)
+{
+    const QPointF center = getSelectionCenter();
+    transformSelection(Affine2D::scaling(factor, factor, center.x(), center.y()));
+}
+
+// Отражает выделенные объекты относительно горизонтальной или вертикальной оси через центр выделения.
+void CadWindow::onMirrorRequested(Qt::Orientation axis)
+{
+    const QPointF center = getSelectionCenter();
+    if (axis == Qt::Horizontal) {
+        transformSelection(Affine2D::mirror(center.x() - 1.0, center.y(), center.x() + 1.0, center.y()));
     } else {
-        // Если выбор сброшен - возвращаем панель в режим "Создание".
-        m_propertiesPanel->showCreationPropertiesFor(m_activePrimitiveType);
+        transformSelection(Affine2D::mirror(center.x(), center.y() - 1.0, center.x(), center.y() + 1.0));
+    }
+}
+
+// Применяет преобразование к выделенным объектам; панели обновятся по одному уведомлению сцены.
+void CadWindow::transformSelection(const Affine2D& transform)
+{
+    UCAD_TRACE_SCOPE("CadWindow::transformSelection");
+    if (m_selection.isEmpty()) return;
+    m_scene->transformPrimitives(m_selection.getHandles(), transform);
+}
+
+// Возвращает центр прямоугольника, охватывающего выделенные объекты.
+QPointF CadWindow::getSelectionCenter() const
+{
+    // Границы накапливаются вручную: QRectF::united пропускает вырожденные прямоугольники точек.
+    double left = 0.0, top = 0.0, right = 0.0, bottom = 0.0;
+    bool first = true;
+    for (const Handle& handle : m_selection.getHandles()) {
+        const QRectF box = m_scene->getBoundingBox(handle);
+        if (first) {
+            left = box.left();
+            top = box.top();
+            right = box.right();
+            bottom = box.bottom();
+            first = false;
+        } else {
+            left = std::min(left, box.left());
+            top = std::min(top, box.top());
+            right = std::max(right, box.right());
+            bottom = std::max(bottom, box.bottom());
+        }
+    }
+    return QPointF((left + right) / 2.0, (top + bottom) / 2.0);
+}
+
+// Отменяет последнее изменение сцены; панели обновятся по уведомлению сцены.
+void CadWindow::onUndoRequested()
+{
+    UCAD_TRACE_SCOPE("CadWindow::onUndoRequested");
+    m_undoJournal.undo(*m_scene);
+}
+
+// Повторяет последнее отмененное изменение сцены.
+void CadWindow::onRedoRequested()
+{
+    UCAD_TRACE_SCOPE("CadWindow::onRedoRequested");
+    m_undoJournal.redo(*m_scene);
+}
+
+// Показывает или скрывает статистику отрисовки на инфо-панели вьюпорта.
+void CadWindow::onStatsOverlayToggled()
+{
+    m_viewportPanel->setStatsOverlayVisible(!m_viewportPanel->isStatsOverlayVisible());
+}
+
+// Начинает запись статистики каждого кадра в выбранный CSV-файл или завершает ее.
+void CadWindow::onStatsCsvRequested()
+{
+    RenderStats& stats = m_viewportPanel->getRenderStats();
+    if (stats.isRecordingCsv()) {
+        stats.stopCsv();
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, "Запись статистики отрисовки", QString(), "Таблица CSV (*.csv)");
+    if (path.isEmpty()) return;
+    if (!path.endsWith(".csv")) path += ".csv";
+
+    QString error;
+    if (!stats.startCsv(path, &error)) {
+        QMessageBox::warning(this, "Запись статистики отрисовки", error);
+        return;
+    }
+    m_viewportPanel->setStatsOverlayVisible(true);
+}
+
+// Находит пересечения всех отрезков сцены, отмечает их во вьюпорте и выводит сводку.
+void CadWindow::onIntersectionsRequested()
+{
+    UCAD_TRACE_SCOPE("CadWindow::onIntersectionsRequested");
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<SegmentIntersection> intersections = IntersectionFinder::find(m_scene->getSegments());
+    const double elapsedMs = timer.nsecsElapsed() / 1.0e6;
+
+    std::size_t crossings = 0, touches = 0, overlaps = 0;
+    for (const SegmentIntersection& intersection : intersections) {
+        switch (intersection.kind) {
+        case IntersectionKind::Crossing: ++crossings; break;
+        case IntersectionKind::Touch: ++touches; break;
+        case IntersectionKind::Overlap: ++overlaps; break;
+        }
+    }
+
+    const QString text = intersections.empty()
+        ? QString("Пересечений не найдено.\nПоиск: %1 мс.").arg(elapsedMs, 0, 'f', 1)
+        : QString("Найдено пересечений: %1\n"
+                  "  пересечения: %2\n  примыкания: %3\n  наложения: %4\n"
+                  "Поиск: %5 мс.\n\nОтметки во вьюпорте снимаются при изменении сцены.")
+              .arg(intersections.size()).arg(crossings).arg(touches).arg(overlaps)
+              .arg(elapsedMs, 0, 'f', 1);
+
+    m_viewportPanel->setIntersections(std::move(intersections));
+    QMessageBox::information(this, "Пересечения отрезков", text);
+}
+
+// Начинает запись трассы или завершает ее и сохраняет в выбранный JSON-файл.
+void CadWindow::onTraceRequested()
+{
+    if (!Trace::isAvailable()) {
+        QMessageBox::information(this, "Запись трассы",
+                                 "Программа собрана без трассировки (UNIVERSITYCAD_ENABLE_TRACING=OFF).");
+        return;
     }
+
+    if (!Trace::isRecording()) {
+        Trace::start();
+        return;
+    }
+
+    Trace::stop();
+    QString path = QFileDialog::getSaveFileName(this, "Запись трассы", QString(), "Трасса Chrome (*.json)");
+    if (path.isEmpty()) return;
+    if (!path.endsWith(".json")) path += ".json";
+
+    QString error;
+    if (!Trace::writeJson(path, &error)) QMessageBox::warning(this, "Запись трассы", error);
 }
 
-// Слот, реагирующий на изменение объекта в Properties.
-void CadWindow::onObjectModified(Object* obj)
+// Добавляет слой с именем, введенным пользователем, и делает его текущим.
+void CadWindow::onAddLayerRequested()
 {
-    // Просто запрашиваем перерисовку вьюпорта.
-    m_viewportPanel->update();
+    bool ok = false;
+    const QString defaultName = QString("Слой %1").arg(static_cast<int>(m_scene->getLayerCount()));
+    const QString name = QInputDialog::getText(this, "Новый слой", "Имя слоя:", QLineEdit::Normal, defaultName, &ok);
+    if (!ok || name.isEmpty()) return;
+    if (m_scene->findLayer(name) != Layer::npos) {
+        QMessageBox::warning(this, "Новый слой", QString("Слой \"%1\" уже существует.").arg(name));
+        return;
+    }
+
+    Layer layer;
+    layer.name = name;
+    layer.color = m_propertiesPanel->getSelectedColor();
+    onCurrentLayerRequested(m_scene->addLayer(layer));
+}
 
-    // Мы также можем обновить список (на случай, если бы имя изменилось).
-    // Используем sceneChanged, т.к. он уже подключен к updateObjectList.
-    emit sceneChanged(m_scene);
+// Делает слой текущим: на него добавляются новые объекты, и они получают цвет слоя.
+void CadWindow::onCurrentLayerRequested(std::uint32_t layer)
+{
+    m_scene->setCurrentLayer(layer);
+    m_propertiesPanel->setSelectedColor(m_scene->getLayer(layer).color);
+}
+
+// Переносит выделенные объекты на слой (один шаг отмены).
+void CadWindow::onMoveToLayerRequested(std::uint32_t layer)
+{
+    UCAD_TRACE_SCOPE("CadWindow::onMoveToLayerRequested");
+    if (m_selection.isEmpty()) return;
+    m_scene->setPrimitivesLayer(m_selection.getHandles(), layer);
+}
+
+// Исключает из выделения объекты, которые стали недоступны для выбора.
+void CadWindow::dropUneditableFromSelection()
+{
+    std::vector<Handle> kept;
+    for (const Handle& handle : m_selection.getHandles()) {
+        if (m_scene->isPrimitiveEditable(handle)) kept.push_back(handle);
+    }
+    if (kept.size() == m_selection.getHandles().size()) return;
+
+    syncObjectListSelection(setSelection(kept));
+}
+
+// Слот, принимающий выделение из списка объектов.
+void CadWindow::onObjectsSelected(const std::vector<Handle>& handles)
+{
+    UCAD_TRACE_SCOPE("CadWindow::onObjectsSelected");
+    setSelection(handles);
+}
+
+// Слот, принимающий выбор во вьюпорте и синхронизирующий с ним список объектов.
+void CadWindow::onObjectsPicked(const std::vector<Handle>& handles, bool additive)
+{
+    UCAD_TRACE_SCOPE("CadWindow::onObjectsPicked");
+    std::vector<Handle> changed;
+    if (additive) {
+        // С Shift щелчок переключает выделение объекта, а рамка добавляет объекты к выделению.
+        if (handles.size() == 1) {
+            m_selection.toggle(handles.front());
+            changed.push_back(handles.front());
+        } else {
+            for (const Handle& handle : handles) {
+                if (m_selection.contains(handle)) continue;
+                m_selection.add(handle);
+                changed.push_back(handle);
+            }
+        }
+        m_viewportPanel->updateSelection(changed);
+        updatePropertiesForSelection();
+    } else {
+        changed = setSelection(handles);
+    }
+
+    // Список объектов обновляет только строки объектов, чье выделение изменилось.
+    syncObjectListSelection(changed);
+}
+
+// Заменяет выделение и сообщает вьюпорту, у каких объектов изменилась подсветка.
+std::vector<Handle> CadWindow::setSelection(const std::vector<Handle>& handles)
+{
+    UCAD_TRACE_SCOPE("CadWindow::setSelection");
+    // Выделение обновляется на месте: затраты пропорциональны старому и новому выделению, а не сцене.
+    std::vector<Handle> changed;
+    m_selection.assign(handles, &changed);
+    m_viewportPanel->updateSelection(changed);
+    updatePropertiesForSelection();
+    return changed;
+}
+
+// Передает списку объектов, какие из изменившихся объектов выделены, а какие нет.
+void CadWindow::syncObjectListSelection(const std::vector<Handle>& changed)
+{
+    std::vector<Handle> selected;
+    std::vector<Handle> deselected;
+    for (const Handle& handle : changed) {
+        (m_selection.contains(handle) ? selected : deselected).push_back(handle);
+    }
+    m_controlPanel->updateObjectSelection(selected, deselected);
+}
+
+// Показывает в панели свойств выделенный объект.
+void CadWindow::updatePropertiesForSelection()
+{
+    UCAD_TRACE_SCOPE("CadWindow::updatePropertiesForSelection");
+    if (m_selection.isEmpty()) {
+        // Если выбор сброшен - возвращаем панель в режим "Создание".
+        m_propertiesPanel->showCreationPropertiesFor(m_activePrimitiveType);
+    } else {
+        // Редактируется только единственный выделенный объект; при нескольких показывается заглушка.
+        m_propertiesPanel->showEditingPropertiesFor(m_selection.single());
+    }
 }
@@ -5,6 +5,13 @@
 #include <memory>
 
 #include "Enums.h"
+#include "Handle.h"
+#include "SceneChange.h"
+#include "Selection.h"
+#include "UndoJournal.h"
+
+#include <vector>
+#include <cstdint>
 
 // Прямые объявления для уменьшения зависимостей в заголовочных файлах.
 class QSplitter;
@@ -16,9 +23,12 @@ class Draw;
 class Point;
 class QColor;
 class Object;
+class QPointF;
+struct Affine2D;
 
 // Главное окно приложения CAD.
-class CadWindow : public QMainWindow
+// Окно подписано на изменения сцены и пересылает их панелям сигналом sceneChanged.
+class CadWindow : public QMainWindow, public SceneListener
 {
     Q_OBJECT
 
@@ -29,6 +39,9 @@ public:
     // Деструктор главного окна.
     ~CadWindow();
 
+    // Получает уведомление сцены и пересылает его панелям.
+    void onSceneChanged(const SceneChange& change) override;
+
 private slots:
     // Слот для изменения шага сетки.
     void onGridStepChanged(int step);
@@ -42,18 +55,57 @@ private slots:
     // Слот для создания нового отрезка на сцене.
     void createSegment(const Point& start, const Point& end, const QColor& color);
 
+    // Слот для создания отрезка по двум точкам, заданным во вьюпорте.
+    void onSegmentDrawn(const QPointF& start, const QPointF& end);
+
     // Слот для обработки запроса на удаление объекта.
     void onDeleteRequested();
 
-    // Слот для обработки выбора объекта в списке.
-    void onObjectSelected(Object* selectedObject);
+    // Слот для поиска пересечений всех отрезков сцены и их отметки во вьюпорте.
+    void onIntersectionsRequested();
+
+    // Слоты панели слоев: добавление слоя (имя запрашивается у пользователя), выбор текущего
+    // слоя (его цвет становится цветом новых объектов) и перенос выделенных объектов на слой.
+    void onAddLayerRequested();
+    void onCurrentLayerRequested(std::uint32_t layer);
+    void onMoveToLayerRequested(std::uint32_t layer);
+
+    // Слоты для загрузки сцены из файла и сохранения ее в файл.
+    void onOpenRequested();
+    void onSaveRequested();
+
+    // Слоты для импорта отрезков из DXF и экспорта сцены в DXF.
+    void onImportDxfRequested();
+    void onExportDxfRequested();
+
+    // Слоты для преобразования выделенных объектов (одно действие - один шаг отмены).
+    void onMoveRequested(double dx, double dy);
+    void onRotateRequested(double angle);
+    void onScaleRequested(double factor);
+    void onMirrorRequested(Qt::Orientation axis);
+
+    // Слоты для отмены и повтора последнего изменения сцены.
+    void onUndoRequested();
+    void onRedoRequested();
+
+    // Слот для показа и скрытия статистики отрисовки во вьюпорте.
+    void onStatsOverlayToggled();
+
+    // Слот для начала и завершения записи статистики отрисовки в CSV.
+    void onStatsCsvRequested();
 
-    // Слот для обработки изменения данных объекта.
-    void onObjectModified(Object* obj);
+    // Слот для начала записи трассы и ее сохранения в формате Chrome trace-event JSON.
+    void onTraceRequested();
+
+    // Слот для обработки выделения в списке объектов (пустой список - выбор сброшен).
+    void onObjectsSelected(const std::vector<Handle>& handles);
+
+    // Слот для обработки выбора объектов щелчком или рамкой во вьюпорте.
+    void onObjectsPicked(const std::vector<Handle>& handles, bool additive);
 
 signals:
-    // Сигнал, испускаемый при любом изменении в сцене.
-    void sceneChanged(const Scene* scene);
+    // Сигнал об изменениях сцены за одну транзакцию (панели обновляются точечно).
+    void sceneChanged(const SceneChange& change);
 
 private:
     // Настраивает пользовательский интерфейс окна.
@@ -62,9 +114,31 @@ private:
     // Создает все необходимые сигнально-слотовые соединения.
     void createConnections();
 
+    // Создает действия с клавиатурными сокращениями (отмена, повтор, статистика отрисовки).
+    void createActions();
+
     // Инициализирует стратегии отрисовки для разных типов примитивов.
     void setupDrawingStrategies();
 
+    // Заменяет выделение и перерисовывает подсветку только у объектов, чье выделение изменилось.
+    // Возвращает эти объекты.
+    std::vector<Handle> setSelection(const std::vector<Handle>& handles);
+
+    // Обновляет в списке объектов выделение строк объектов, чье выделение изменилось.
+    void syncObjectListSelection(const std::vector<Handle>& changed);
+
+    // Применяет преобразование к выделенным объектам.
+    void transformSelection(const Affine2D& transform);
+
+    // Возвращает центр прямоугольника, охватывающего выделенные объекты.
+    QPointF getSelectionCenter() const;
+
+    // Показывает в панели свойств единственный выделенный объект или панель создания.
+    void updatePropertiesForSelection();
+
+    // Исключает из выделения объекты скрытых и заблокированных слоев.
+    void dropUneditableFromSelection();
+
     // UI компоненты.
     QSplitter* m_mainSplitter;
     QSplitter* m_rightColumnSplitter;
@@ -75,6 +149,7 @@ private:
     // Ядро.
     Scene* m_scene;
     std::map<PrimitiveType, std::unique_ptr<Draw>> m_drawingStrategies;
-    Object* m_selectedObject = nullptr; // Указатель на выбранный объект.
+    Selection m_selection; // Выделенные объекты.
+    UndoJournal m_undoJournal; // История изменений сцены для отмены и повтора.
     PrimitiveType m_activePrimitiveType = PrimitiveType::Generic; // Хранит активный инструмент
 };
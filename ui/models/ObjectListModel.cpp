@@ -0,0 +1,269 @@
+#include "ObjectListModel.h"
+#include "Scene.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Наибольшее число отдельных вставок или диапазонов удаления, о которых модель сообщает по одному.
+// Больший разрозненный пакет (например, отмена удаления 100 тыс. объектов) применяется одним
+// линейным проходом и одним сигналом изменения раскладки.
+constexpr std::size_t kMaxRowSignals = 32;
+
+} // namespace
+
+// Конструктор модели.
+ObjectListModel::ObjectListModel(QObject* parent) : QAbstractListModel(parent) {}
+
+// Устанавливает сцену и заполняет модель ее примитивами.
+void ObjectListModel::setScene(const Scene* scene)
+{
+    UCAD_TRACE_SCOPE("ObjectListModel::setScene");
+    beginResetModel();
+    m_scene = scene;
+    m_handles.clear();
+    m_ids.clear();
+    m_idBySlot.clear();
+    if (m_scene) {
+        m_handles = m_scene->getPrimitiveHandles();
+        m_ids.reserve(m_handles.size());
+        for (const Handle& handle : m_handles) {
+            const unsigned id = m_scene->getPrimitiveID(handle);
+            m_ids.push_back(id);
+            if (handle.index >= m_idBySlot.size()) m_idBySlot.resize(handle.index + 1, 0);
+            m_idBySlot[handle.index] = id;
+        }
+    }
+    endResetModel();
+}
+
+// Возвращает количество строк.
+int ObjectListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_handles.size());
+}
+
+// Возвращает данные строки: текст формируется только для запрошенных (видимых) строк.
+QVariant ObjectListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+
+    const Handle handle = m_handles[index.row()];
+    if (role == HandleRole) {
+        return QVariant::fromValue<qulonglong>(handle.toKey());
+    }
+    if (role == Qt::DisplayRole) {
+        const unsigned id = m_ids[index.row()];
+
+        // Формируем имя в зависимости от типа объекта
+        if (m_scene && m_scene->getPrimitiveType(handle) == PrimitiveType::Segment) {
+            return QString("Отрезок %1").arg(id);
+        }
+        return QString("Объект %1").arg(id);
+    }
+    return QVariant();
+}
+
+// Возвращает дескриптор примитива в строке.
+Handle ObjectListModel::handleAt(const QModelIndex& index) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) return Handle();
+    return m_handles[index.row()];
+}
+
+// Возвращает индекс строки примитива.
+QModelIndex ObjectListModel::indexOf(Handle handle) const
+{
+    const int row = findRow(handle);
+    return (row >= 0) ? index(row) : QModelIndex();
+}
+
+// Применяет изменения сцены к строкам модели.
+void ObjectListModel::applyChange(const SceneChange& change)
+{
+    UCAD_TRACE_SCOPE("ObjectListModel::applyChange");
+    // Содержимое сцены заменено целиком - список строится заново.
+    if (change.reset) {
+        setScene(m_scene);
+        return;
+    }
+
+    removePrimitives(change.removed);
+    addPrimitives(change.added);
+    updatePrimitives(change.modified);
+}
+
+// Добавляет строки для новых примитивов.
+void ObjectListModel::addPrimitives(const std::vector<SceneChange::Entry>& entries)
+{
+    if (!m_scene || entries.empty()) return;
+
+    std::vector<std::pair<unsigned, Handle>> added;
+    added.reserve(entries.size());
+    for (const auto& entry : entries) {
+        const Handle handle = entry.handle;
+        const unsigned id = m_scene->getPrimitiveID(handle);
+        if (id == 0) continue; // Примитив уже удален
+        added.emplace_back(id, handle);
+        if (handle.index >= m_idBySlot.size()) m_idBySlot.resize(handle.index + 1, 0);
+        m_idBySlot[handle.index] = id;
+    }
+    if (added.empty()) return;
+    std::sort(added.begin(), added.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Обычный случай: новые ID больше всех имеющихся - строки добавляются одним блоком в конец.
+    if (m_ids.empty() || added.front().first > m_ids.back()) {
+        const int first = static_cast<int>(m_handles.size());
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(added.size()) - 1);
+        for (const auto& entry : added) {
+            m_ids.push_back(entry.first);
+            m_handles.push_back(entry.second);
+        }
+        endInsertRows();
+        return;
+    }
+
+    // Небольшой пакет: каждая строка вставляется на свое место по ID.
+    if (added.size() <= kMaxRowSignals) {
+        for (const auto& entry : added) {
+            const auto it = std::lower_bound(m_ids.begin(), m_ids.end(), entry.first);
+            const int row = static_cast<int>(it - m_ids.begin());
+            beginInsertRows(QModelIndex(), row, row);
+            m_ids.insert(it, entry.first);
+            m_handles.insert(m_handles.begin() + row, entry.second);
+            endInsertRows();
+        }
+        return;
+    }
+
+    // Крупный пакет сливается с имеющимися строками за один проход.
+    std::vector<int> newRows(m_ids.size());
+    std::vector<unsigned> ids;
+    std::vector<Handle> handles;
+    ids.reserve(m_ids.size() + added.size());
+    handles.reserve(m_handles.size() + added.size());
+    std::size_t next = 0;
+    for (std::size_t row = 0; row < m_ids.size(); ++row) {
+        for (; next < added.size() && added[next].first < m_ids[row]; ++next) {
+            ids.push_back(added[next].first);
+            handles.push_back(added[next].second);
+        }
+        newRows[row] = static_cast<int>(ids.size());
+        ids.push_back(m_ids[row]);
+        handles.push_back(m_handles[row]);
+    }
+    for (; next < added.size(); ++next) {
+        ids.push_back(added[next].first);
+        handles.push_back(added[next].second);
+    }
+    replaceRows(std::move(ids), std::move(handles), newRows);
+}
+
+// Удаляет строки удаленных примитивов.
+void ObjectListModel::removePrimitives(const std::vector<SceneChange::Entry>& entries)
+{
+    if (entries.empty()) return;
+
+    std::vector<int> rows;
+    rows.reserve(entries.size());
+    for (const auto& entry : entries) {
+        const int row = findRow(entry.handle);
+        if (row >= 0) rows.push_back(row);
+    }
+    if (rows.empty()) return;
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // Разрозненные строки удаляются одним проходом со сдвигом оставшихся.
+    std::size_t ranges = 1;
+    for (std::size_t i = 1; i < rows.size(); ++i) ranges += (rows[i] != rows[i - 1] + 1);
+    if (ranges > kMaxRowSignals) {
+        std::vector<int> newRows(m_ids.size());
+        std::vector<unsigned> ids;
+        std::vector<Handle> handles;
+        ids.reserve(m_ids.size() - rows.size());
+        handles.reserve(m_handles.size() - rows.size());
+        std::size_t next = 0;
+        for (std::size_t row = 0; row < m_ids.size(); ++row) {
+            if (next < rows.size() && rows[next] == static_cast<int>(row)) {
+                newRows[row] = -1;
+                ++next;
+                continue;
+            }
+            newRows[row] = static_cast<int>(ids.size());
+            ids.push_back(m_ids[row]);
+            handles.push_back(m_handles[row]);
+        }
+        replaceRows(std::move(ids), std::move(handles), newRows);
+        return;
+    }
+
+    // Удаляем с конца, объединяя соседние строки в один диапазон.
+    int last = static_cast<int>(rows.size()) - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && rows[first - 1] == rows[first] - 1) --first;
+
+        const int from = rows[first];
+        const int to = rows[last];
+        beginRemoveRows(QModelIndex(), from, to);
+        m_ids.erase(m_ids.begin() + from, m_ids.begin() + to + 1);
+        m_handles.erase(m_handles.begin() + from, m_handles.begin() + to + 1);
+        endRemoveRows();
+
+        last = first - 1;
+    }
+}
+
+// Заменяет строки модели одним изменением раскладки; сохраненные индексы (выделение, текущая
+// строка) переносятся по таблице новых номеров строк (-1 - строка удалена).
+void ObjectListModel::replaceRows(std::vector<unsigned> ids, std::vector<Handle> handles,
+                                  const std::vector<int>& newRows)
+{
+    emit layoutAboutToBeChanged();
+    const QModelIndexList from = persistentIndexList();
+    m_ids = std::move(ids);
+    m_handles = std::move(handles);
+
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (const QModelIndex& oldIndex : from) {
+        const int row = (oldIndex.row() < static_cast<int>(newRows.size())) ? newRows[oldIndex.row()] : -1;
+        to.push_back(row >= 0 ? index(row) : QModelIndex());
+    }
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+}
+
+// Сообщает представлению об изменении данных примитивов одним сигналом на весь диапазон строк.
+void ObjectListModel::updatePrimitives(const std::vector<SceneChange::Entry>& entries)
+{
+    int first = -1;
+    int last = -1;
+    for (const auto& entry : entries) {
+        const int row = findRow(entry.handle);
+        if (row < 0) continue;
+        first = (first < 0) ? row : std::min(first, row);
+        last = std::max(last, row);
+    }
+    if (first < 0) return;
+
+    emit dataChanged(index(first), index(last), {Qt::DisplayRole});
+}
+
+// Ищет строку примитива двоичным поиском по ID.
+int ObjectListModel::findRow(Handle handle) const
+{
+    if (!handle.isValid() || handle.index >= m_idBySlot.size()) return -1;
+
+    const unsigned id = m_idBySlot[handle.index];
+    const auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if (it == m_ids.end() || *it != id) return -1;
+
+    const int row = static_cast<int>(it - m_ids.begin());
+    return (m_handles[row] == handle) ? row : -1;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <vector>
+
+#include "Handle.h"
+#include "SceneChange.h"
+
+// Прямые объявления.
+class Scene;
+
+// Модель списка объектов сцены для QListView.
+// Хранит только дескрипторы и ID примитивов в порядке создания; текст строки
+// формируется по запросу представления, поэтому отрисовываются лишь видимые строки.
+// Изменения сцены передаются точечно: вставка, удаление и изменение строк, без сброса модели;
+// крупные разрозненные пакеты применяются одним линейным проходом и сигналом изменения раскладки.
+class ObjectListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    // Роль, по которой возвращается упакованный дескриптор примитива (Handle::toKey()).
+    static constexpr int HandleRole = Qt::UserRole;
+
+    // Конструктор модели.
+    explicit ObjectListModel(QObject* parent = nullptr);
+
+    // Устанавливает сцену и заполняет модель ее примитивами (единственный полный сброс).
+    void setScene(const Scene* scene);
+
+    // Возвращает количество строк.
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    // Возвращает данные строки для указанной роли.
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    // Возвращает дескриптор примитива в строке (пустой для неверного индекса).
+    Handle handleAt(const QModelIndex& index) const;
+
+    // Возвращает индекс строки примитива (неверный индекс, если примитива нет в модели).
+    QModelIndex indexOf(Handle handle) const;
+
+    // Применяет изменения сцены: удаляет, добавляет и обновляет только затронутые строки.
+    void applyChange(const SceneChange& change);
+
+private:
+    // Добавляет строки для новых примитивов сцены.
+    void addPrimitives(const std::vector<SceneChange::Entry>& entries);
+
+    // Удаляет строки удаленных примитивов (соседние строки удаляются одним диапазоном).
+    void removePrimitives(const std::vector<SceneChange::Entry>& entries);
+
+    // Заменяет строки модели одним изменением раскладки (для крупных разрозненных пакетов).
+    // newRows - новый номер каждой прежней строки или -1, если строка удалена.
+    void replaceRows(std::vector<unsigned> ids, std::vector<Handle> handles, const std::vector<int>& newRows);
+
+    // Сообщает представлению, что данные примитивов изменились.
+    void updatePrimitives(const std::vector<SceneChange::Entry>& entries);
+
+    // Возвращает номер строки примитива или -1.
+    int findRow(Handle handle) const;
+
+    // Сцена, из которой берутся данные строк.
+    const Scene* m_scene = nullptr;
+
+    // Дескрипторы и ID примитивов по строкам; ID возрастают, что позволяет искать строку двоичным поиском.
+    std::vector<Handle> m_handles;
+    std::vector<unsigned> m_ids;
+
+    // ID примитива по номеру ячейки дескриптора (нужен, когда примитив уже удален со сцены).
+    std::vector<unsigned> m_idBySlot;
+};
@@ -1,15 +1,51 @@
 #include "Control.h"
 #include "Scene.h"
+#include "ObjectListModel.h"
+#include "Trace.h"
 
 #include <QVBoxLayout>
 #include <QFormLayout>
 #include <QGroupBox>
 #include <QSpinBox>
+#include <QDoubleSpinBox>
 #include <QComboBox>
 #include <QPushButton>
 #include <QToolButton>
 #include <QButtonGroup>
-#include <QListWidget>
+#include <QListView>
+#include <QItemSelectionModel>
+#include <QCheckBox>
+#include <QTreeWidget>
+#include <QHeaderView>
+
+#include <algorithm>
+
+namespace {
+
+// Возвращает строки объектов списка, объединенные в диапазоны соседних строк
+// (выделение тысяч объектов остается компактным). Объекты без строки пропускаются.
+QItemSelection rowRanges(const ObjectListModel& model, const std::vector<Handle>& handles)
+{
+    std::vector<int> rows;
+    rows.reserve(handles.size());
+    for (const Handle& handle : handles) {
+        const QModelIndex index = model.indexOf(handle);
+        if (index.isValid()) rows.push_back(index.row());
+    }
+    std::sort(rows.begin(), rows.end());
+
+    QItemSelection selection;
+    std::size_t i = 0;
+    while (i < rows.size()) {
+        std::size_t j = i;
+        while (j + 1 < rows.size() && rows[j + 1] <= rows[j] + 1) ++j;
+        selection.select(model.index(rows[i]), model.index(rows[j]));
+        i = j + 1;
+    }
+    return selection;
+}
+
+} // namespace
 
 // Конструктор панели управления.
 Control::Control(QWidget *parent) : QWidget(parent)
@@ -51,16 +87,119 @@ Control::Control(QWidget *parent) : QWidget(parent)
     coordLayout->addWidget(m_polarBtn);
     sceneLayout->addRow("Координаты:", coordLayout);
 
+    m_levelOfDetailCheckBox = new QCheckBox("Точки вместо мелких");
+    m_levelOfDetailCheckBox->setChecked(true);
+    sceneLayout->addRow("Детализация:", m_levelOfDetailCheckBox);
+
+    m_parallelRenderingCheckBox = new QCheckBox("Параллельно по плиткам");
+    m_parallelRenderingCheckBox->setChecked(true);
+    sceneLayout->addRow("Отрисовка:", m_parallelRenderingCheckBox);
+
+    m_snappingCheckBox = new QCheckBox("К объектам и сетке");
+    m_snappingCheckBox->setChecked(true);
+    sceneLayout->addRow("Привязка:", m_snappingCheckBox);
+
+    auto* fileLayout = new QHBoxLayout();
+    m_openBtn = new QPushButton("Открыть...");
+    m_saveBtn = new QPushButton("Сохранить...");
+    fileLayout->addWidget(m_openBtn);
+    fileLayout->addWidget(m_saveBtn);
+    sceneLayout->addRow("Файл:", fileLayout);
+
+    auto* dxfLayout = new QHBoxLayout();
+    m_importDxfBtn = new QPushButton("Импорт...");
+    m_exportDxfBtn = new QPushButton("Экспорт...");
+    dxfLayout->addWidget(m_importDxfBtn);
+    dxfLayout->addWidget(m_exportDxfBtn);
+    sceneLayout->addRow("DXF:", dxfLayout);
+
     // --- 2. Группа "Объекты сцены" ---
     auto* objectsGroup = new QGroupBox("Объекты сцены");
     auto* objectsLayout = new QVBoxLayout(objectsGroup);
-    m_objectListWidget = new QListWidget();
-    m_deleteBtn = new QPushButton("Удалить выбранный");
+    // Список строится по модели: строки не создаются заранее, а текст формируется
+    // только для видимых элементов. Одинаковая высота строк избавляет представление
+    // от измерения каждого элемента.
+    m_objectListModel = new ObjectListModel(this);
+    m_objectListView = new QListView();
+    m_objectListView->setModel(m_objectListModel);
+    m_objectListView->setUniformItemSizes(true);
+    m_objectListView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_objectListView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_deleteBtn = new QPushButton("Удалить выбранные");
     m_deleteBtn->setObjectName("deleteButton");
-    objectsLayout->addWidget(m_objectListWidget);
+    m_intersectionsBtn = new QPushButton("Найти пересечения");
+    objectsLayout->addWidget(m_objectListView);
     objectsLayout->addWidget(m_deleteBtn);
+    objectsLayout->addWidget(m_intersectionsBtn);
+
+    // --- 3. Группа "Слои" ---
+    auto* layersGroup = new QGroupBox("Слои");
+    auto* layersLayout = new QVBoxLayout(layersGroup);
+    m_layerTree = new QTreeWidget();
+    m_layerTree->setColumnCount(3);
+    m_layerTree->setHeaderLabels({"Слой", "Видим", "Блок."});
+    m_layerTree->setRootIsDecorated(false);
+    m_layerTree->setUniformRowHeights(true);
+    m_layerTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_layerTree->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    m_layerTree->header()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+    m_layerTree->setMaximumHeight(160);
+    auto* layerButtonsLayout = new QHBoxLayout();
+    m_addLayerBtn = new QPushButton("Добавить");
+    m_currentLayerBtn = new QPushButton("Сделать текущим");
+    m_moveToLayerBtn = new QPushButton("Перенести выбранные");
+    layerButtonsLayout->addWidget(m_addLayerBtn);
+    layerButtonsLayout->addWidget(m_currentLayerBtn);
+    layersLayout->addWidget(m_layerTree);
+    layersLayout->addLayout(layerButtonsLayout);
+    layersLayout->addWidget(m_moveToLayerBtn);
+
+    // --- 4. Группа "Преобразования" (применяются к выделенным объектам) ---
+    auto* transformGroup = new QGroupBox("Преобразования");
+    auto* transformLayout = new QFormLayout(transformGroup);
+    transformLayout->setLabelAlignment(Qt::AlignLeft);
+
+    auto* moveLayout = new QHBoxLayout();
+    m_moveDxSpinBox = new QDoubleSpinBox();
+    m_moveDxSpinBox->setRange(-1e6, 1e6);
+    m_moveDxSpinBox->setDecimals(2);
+    m_moveDySpinBox = new QDoubleSpinBox();
+    m_moveDySpinBox->setRange(-1e6, 1e6);
+    m_moveDySpinBox->setDecimals(2);
+    m_moveBtn = new QPushButton("Перенести");
+    moveLayout->addWidget(m_moveDxSpinBox);
+    moveLayout->addWidget(m_moveDySpinBox);
+    moveLayout->addWidget(m_moveBtn);
+    transformLayout->addRow("Смещение:", moveLayout);
+
+    auto* rotateLayout = new QHBoxLayout();
+    m_rotateAngleSpinBox = new QDoubleSpinBox();
+    m_rotateAngleSpinBox->setRange(-360.0, 360.0);
+    m_rotateAngleSpinBox->setDecimals(4);
+    m_rotateAngleSpinBox->setValue(90.0);
+    m_rotateBtn = new QPushButton("Повернуть");
+    rotateLayout->addWidget(m_rotateAngleSpinBox);
+    rotateLayout->addWidget(m_rotateBtn);
+    transformLayout->addRow("Угол:", rotateLayout);
+
+    auto* scaleLayout = new QHBoxLayout();
+    m_scaleFactorSpinBox = new QDoubleSpinBox();
+    m_scaleFactorSpinBox->setRange(0.001, 1000.0);
+    m_scaleFactorSpinBox->setDecimals(3);
+    m_scaleFactorSpinBox->setValue(2.0);
+    m_scaleBtn = new QPushButton("Масштабировать");
+    scaleLayout->addWidget(m_scaleFactorSpinBox);
+    scaleLayout->addWidget(m_scaleBtn);
+    transformLayout->addRow("Масштаб:", scaleLayout);
+
+    auto* mirrorLayout = new QHBoxLayout();
+    m_mirrorHorizontalBtn = new QPushButton("По горизонтали");
+    m_mirrorVerticalBtn = new QPushButton("По вертикали");
+    mirrorLayout->addWidget(m_mirrorHorizontalBtn);
+    mirrorLayout->addWidget(m_mirrorVerticalBtn);
+    transformLayout->addRow("Отражение:", mirrorLayout);
 
-    // --- 3. Группа "Создание примитивов" ---
+    // --- 5. Группа "Создание примитивов" ---
     auto* primitivesGroup = new QGroupBox("Создание объектов");
     auto* primitivesLayout = new QHBoxLayout(primitivesGroup);
     primitivesLayout->setAlignment(Qt::AlignLeft);
@@ -84,6 +223,8 @@ Control::Control(QWidget *parent) : QWidget(parent)
     // --- Сборка панели ---
     mainLayout->addWidget(sceneGroup);
     mainLayout->addWidget(objectsGroup);
+    mainLayout->addWidget(layersGroup);
+    mainLayout->addWidget(transformGroup);
     mainLayout->addWidget(primitivesGroup);
 
     // --- Соединения ---
@@ -91,10 +232,46 @@ Control::Control(QWidget *parent) : QWidget(parent)
     connect(m_angleUnitComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index){
         emit angleUnitChanged(static_cast<AngleUnit>(m_angleUnitComboBox->itemData(index).toInt()));
     });
+    connect(m_levelOfDetailCheckBox, &QCheckBox::toggled, this, &Control::levelOfDetailChanged);
+    connect(m_parallelRenderingCheckBox, &QCheckBox::toggled, this, &Control::parallelRenderingChanged);
+    connect(m_snappingCheckBox, &QCheckBox::toggled, this, &Control::snappingChanged);
     connect(m_cartesianBtn, &QToolButton::clicked, this, &Control::onCartesianClicked);
     connect(m_polarBtn, &QToolButton::clicked, this, &Control::onPolarClicked);
-    connect(m_objectListWidget, &QListWidget::itemSelectionChanged, this, &Control::onSelectionChanged);
+    connect(m_objectListView->selectionModel(), &QItemSelectionModel::selectionChanged, this, &Control::onSelectionChanged);
     connect(m_deleteBtn, &QPushButton::clicked, this, &Control::deleteRequested);
+    connect(m_intersectionsBtn, &QPushButton::clicked, this, &Control::intersectionsRequested);
+    connect(m_layerTree, &QTreeWidget::itemChanged, this, &Control::onLayerItemChanged);
+    connect(m_addLayerBtn, &QPushButton::clicked, this, &Control::addLayerRequested);
+    connect(m_currentLayerBtn, &QPushButton::clicked, this, [this]{
+        const std::uint32_t layer = selectedLayer();
+        if (layer != Layer::npos) emit currentLayerRequested(layer);
+    });
+    connect(m_layerTree, &QTreeWidget::itemDoubleClicked, this, [this](QTreeWidgetItem* item, int column){
+        if (column == 0) emit currentLayerRequested(static_cast<std::uint32_t>(m_layerTree->indexOfTopLevelItem(item)));
+    });
+    connect(m_moveToLayerBtn, &QPushButton::clicked, this, [this]{
+        const std::uint32_t layer = selectedLayer();
+        if (layer != Layer::npos) emit moveToLayerRequested(layer);
+    });
+    connect(m_openBtn, &QPushButton::clicked, this, &Control::openRequested);
+    connect(m_saveBtn, &QPushButton::clicked, this, &Control::saveRequested);
+    connect(m_importDxfBtn, &QPushButton::clicked, this, &Control::importDxfRequested);
+    connect(m_exportDxfBtn, &QPushButton::clicked, this, &Control::exportDxfRequested);
+    connect(m_moveBtn, &QPushButton::clicked, this, [this]{
+        emit moveRequested(m_moveDxSpinBox->value(), m_moveDySpinBox->value());
+    });
+    connect(m_rotateBtn, &QPushButton::clicked, this, [this]{
+        emit rotateRequested(m_rotateAngleSpinBox->value());
+    });
+    connect(m_scaleBtn, &QPushButton::clicked, this, [this]{
+        emit scaleRequested(m_scaleFactorSpinBox->value());
+    });
+    connect(m_mirrorHorizontalBtn, &QPushButton::clicked, this, [this]{
+        emit mirrorRequested(Qt::Horizontal);
+    });
+    connect(m_mirrorVerticalBtn, &QPushButton::clicked, this, [this]{
+        emit mirrorRequested(Qt::Vertical);
+    });
 
     // Соединение для кнопки "Отрезок"
     connect(m_createSegmentBtn, &QToolButton::toggled, this, [this](bool checked){
@@ -102,67 +279,102 @@ Control::Control(QWidget *parent) : QWidget(parent)
     });
 }
 
-// Обновляет содержимое списка объектов на основе данных из сцены.
-void Control::updateObjectList(const Scene* scene)
+// Устанавливает сцену для списка объектов.
+void Control::setScene(const Scene* scene)
 {
-    m_objectListWidget->blockSignals(true);
+    m_scene = scene;
+    m_objectListModel->setScene(scene);
+    refreshLayers();
+}
 
-    // Сохраняем ID выбранного объекта, чтобы восстановить выбор
-    Object* currentSelectedObject = nullptr;
-    if (m_objectListWidget->currentItem()) {
-        currentSelectedObject = static_cast<Object*>(m_objectListWidget->currentItem()->data(Qt::UserRole).value<void*>());
-    }
+// Обновляет строки списка объектов, затронутые изменением сцены (выбор остальных строк сохраняется).
+void Control::applySceneChange(const SceneChange& change)
+{
+    UCAD_TRACE_SCOPE("Control::applySceneChange");
+    m_objectListModel->applyChange(change);
+    if (change.reset || !change.layers.empty()) refreshLayers();
+}
 
-    m_objectListWidget->clear();
-    if (!scene) {
-        m_objectListWidget->blockSignals(false);
-        return;
+// Перестраивает список слоев; текущий слой выделяется жирным шрифтом.
+void Control::refreshLayers()
+{
+    m_syncingLayers = true;
+    const int selectedRow = m_layerTree->currentIndex().row();
+    m_layerTree->clear();
+    if (m_scene) {
+        for (std::uint32_t layer = 0; layer < m_scene->getLayerCount(); ++layer) {
+            const Layer& properties = m_scene->getLayer(layer);
+            auto* item = new QTreeWidgetItem(m_layerTree);
+            item->setText(0, properties.name);
+            item->setForeground(0, properties.color);
+            item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable);
+            item->setCheckState(1, properties.visible ? Qt::Checked : Qt::Unchecked);
+            item->setCheckState(2, properties.locked ? Qt::Checked : Qt::Unchecked);
+            if (layer == m_scene->getCurrentLayer()) {
+                QFont font = item->font(0);
+                font.setBold(true);
+                item->setFont(0, font);
+            }
+        }
     }
+    if (selectedRow >= 0 && selectedRow < m_layerTree->topLevelItemCount()) {
+        m_layerTree->setCurrentItem(m_layerTree->topLevelItem(selectedRow));
+    }
+    m_syncingLayers = false;
+}
 
-    QListWidgetItem* itemToSelect = nullptr; // Элемент для восстановления выбора
-
-    for (const auto& obj : scene->getPrimitives()) {
-
-        QString itemName;
+// Возвращает номер слоя, выбранного в списке.
+std::uint32_t Control::selectedLayer() const
+{
+    const int row = m_layerTree->currentIndex().row();
+    return row >= 0 ? static_cast<std::uint32_t>(row) : Layer::npos;
+}
 
-        // Формируем имя в зависимости от типа объекта
-        if (obj->getType() == PrimitiveType::Segment) {
-            itemName = QString("Отрезок %1").arg(obj->getID());
-        }
-        // else if (obj->getType() == PrimitiveType::Point) {
-        //     itemName = QString("Точка %1").arg(obj->getID());
-        // }
-        else {
-            itemName = QString("Объект %1").arg(obj->getID());
-        }
+// Испускает сигнал о смене видимости или блокировки слоя по флажку в списке.
+void Control::onLayerItemChanged(QTreeWidgetItem* item, int column)
+{
+    if (m_syncingLayers) return;
 
-        QListWidgetItem* item = new QListWidgetItem(itemName, m_objectListWidget);
-        item->setData(Qt::UserRole, QVariant::fromValue(static_cast<void*>(obj.get())));
+    const auto layer = static_cast<std::uint32_t>(m_layerTree->indexOfTopLevelItem(item));
+    const bool checked = item->checkState(column) == Qt::Checked;
+    if (column == 1) emit layerVisibilityChanged(layer, checked);
+    if (column == 2) emit layerLockChanged(layer, checked);
+}
 
-        // Проверяем, нужно ли восстановить выбор этого элемента
-        if (obj.get() == currentSelectedObject) {
-            itemToSelect = item;
-        }
-    }
+// Выделяет и снимает выделение только у строк изменившихся объектов
+// и прокручивает список к первой из выделенных строк.
+void Control::updateObjectSelection(const std::vector<Handle>& selected, const std::vector<Handle>& deselected)
+{
+    UCAD_TRACE_SCOPE("Control::updateObjectSelection");
+    const QItemSelection added = rowRanges(*m_objectListModel, selected);
+    const QItemSelection removed = rowRanges(*m_objectListModel, deselected);
 
-    // Восстанавливаем выбор
-    if (itemToSelect) {
-        itemToSelect->setSelected(true);
+    m_syncingSelection = true;
+    QItemSelectionModel* selectionModel = m_objectListView->selectionModel();
+    if (!removed.isEmpty()) selectionModel->select(removed, QItemSelectionModel::Deselect);
+    if (!added.isEmpty()) {
+        selectionModel->select(added, QItemSelectionModel::Select);
+        const QModelIndex first = m_objectListModel->index(added.first().top());
+        selectionModel->setCurrentIndex(first, QItemSelectionModel::NoUpdate);
+        m_objectListView->scrollTo(first);
     }
-
-    m_objectListWidget->blockSignals(false);
+    m_syncingSelection = false;
 }
 
 // Срабатывает при выборе элемента в списке и испускает сигнал objectSelected.
 void Control::onSelectionChanged()
 {
-    auto selectedItems = m_objectListWidget->selectedItems();
-    if (!selectedItems.isEmpty()) {
-        Object* selectedObject = static_cast<Object*>(selectedItems.first()->data(Qt::UserRole).value<void*>());
-        emit objectSelected(selectedObject);
-    } else {
-        emit objectSelected(nullptr);
+    UCAD_TRACE_SCOPE("Control::onSelectionChanged");
+    if (m_syncingSelection) return;
+
+    // Выделение хранится диапазонами строк - обходим их без построения списка индексов.
+    std::vector<Handle> handles;
+    for (const QItemSelectionRange& range : m_objectListView->selectionModel()->selection()) {
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            handles.push_back(m_objectListModel->handleAt(m_objectListModel->index(row)));
+        }
     }
+    emit objectsSelected(handles);
 }
 
 // Испускает сигнал о смене системы координат на декартову.
@@ -4,15 +4,23 @@
 #include <QPushButton>
 
 #include "Enums.h"
+#include "Handle.h"
+#include "SceneChange.h"
+
+#include <cstdint>
 
 // Прямые объявления.
 class QSpinBox;
+class QDoubleSpinBox;
 class QComboBox;
 class QToolButton;
 class QButtonGroup;
-class QListWidget;
+class QListView;
+class ObjectListModel;
+class QCheckBox;
+class QTreeWidget;
+class QTreeWidgetItem;
 class Scene;
-class Object;
 
 // Панель с настройками, списком объектов и инструментами.
 class Control : public QWidget
@@ -23,22 +31,58 @@ public:
     // Конструктор панели управления.
     explicit Control(QWidget *parent = nullptr);
 
+    // Устанавливает сцену, примитивы которой показываются в списке объектов.
+    void setScene(const Scene* scene);
+
 public slots:
-    // Обновляет список объектов на панели данными из сцены.
-    void updateObjectList(const Scene* scene);
+    // Обновляет строки списка объектов, затронутые изменением сцены.
+    void applySceneChange(const SceneChange& change);
+
+    // Выделяет строки объектов selected и снимает выделение со строк deselected
+    // (остальные строки не затрагиваются) без сигнала objectsSelected.
+    void updateObjectSelection(const std::vector<Handle>& selected, const std::vector<Handle>& deselected);
 
 signals:
     // Сигналы об изменении настроек.
     void gridStepChanged(int step);
     void angleUnitChanged(AngleUnit unit);
     void coordinateSystemChanged(CoordinateSystemType type);
+    void levelOfDetailChanged(bool enabled);
+    void parallelRenderingChanged(bool enabled);
+    void snappingChanged(bool enabled);
 
-    // Сигнал о том, что пользователь выбрал объект в списке.
-    void objectSelected(Object* selectedObject);
+    // Сигнал о том, что пользователь изменил выделение в списке (пустой список - выбор сброшен).
+    void objectsSelected(const std::vector<Handle>& handles);
 
     // Сигнал о нажатии кнопки "Удалить".
     void deleteRequested();
 
+    // Сигнал о нажатии кнопки поиска пересечений отрезков.
+    void intersectionsRequested();
+
+    // Сигналы панели слоев: добавление слоя, выбор текущего слоя, перенос выделенных
+    // объектов на слой, показ и скрытие, блокировка слоя.
+    void addLayerRequested();
+    void currentLayerRequested(std::uint32_t layer);
+    void moveToLayerRequested(std::uint32_t layer);
+    void layerVisibilityChanged(std::uint32_t layer, bool visible);
+    void layerLockChanged(std::uint32_t layer, bool locked);
+
+    // Сигналы о нажатии кнопок "Открыть" и "Сохранить".
+    void openRequested();
+    void saveRequested();
+
+    // Сигналы о нажатии кнопок импорта и экспорта DXF.
+    void importDxfRequested();
+    void exportDxfRequested();
+
+    // Сигналы о преобразовании выделенных объектов: перенос на (dx, dy), поворот на угол
+    // в текущих единицах углов, масштабирование и отражение относительно центра выделения.
+    void moveRequested(double dx, double dy);
+    void rotateRequested(double angle);
+    void scaleRequested(double factor);
+    void mirrorRequested(Qt::Orientation axis);
+
     // Сигнал о выборе инструмента для создания примитива.
     void primitiveTypeSelected(PrimitiveType type);
 
@@ -55,14 +99,54 @@ private slots:
     // Слот, срабатывающий при выборе инструмента (напр. Отрезок).
     void onPrimitiveToolToggled(bool checked, PrimitiveType type);
 
+    // Слот, срабатывающий при переключении флажков видимости и блокировки слоя.
+    void onLayerItemChanged(QTreeWidgetItem* item, int column);
+
 private:
+    // Перестраивает список слоев по сцене (слоев немного, поэтому список строится целиком).
+    void refreshLayers();
+
+    // Возвращает номер слоя, выбранного в списке (Layer::npos, если выбора нет).
+    std::uint32_t selectedLayer() const;
+
+    // Сцена, слои которой показываются на панели.
+    const Scene* m_scene = nullptr;
+
     // Элементы UI.
     QSpinBox* m_gridStepSpinBox;
     QComboBox* m_angleUnitComboBox;
     QToolButton* m_cartesianBtn;
     QToolButton* m_polarBtn;
-    QListWidget* m_objectListWidget;
+    QCheckBox* m_levelOfDetailCheckBox;
+    QCheckBox* m_parallelRenderingCheckBox;
+    QCheckBox* m_snappingCheckBox;
+    QPushButton* m_openBtn;
+    QPushButton* m_saveBtn;
+    QPushButton* m_importDxfBtn;
+    QPushButton* m_exportDxfBtn;
+    QListView* m_objectListView;
+    ObjectListModel* m_objectListModel;
     QPushButton* m_deleteBtn;
+    QPushButton* m_intersectionsBtn;
+    QDoubleSpinBox* m_moveDxSpinBox;
+    QDoubleSpinBox* m_moveDySpinBox;
+    QDoubleSpinBox* m_rotateAngleSpinBox;
+    QDoubleSpinBox* m_scaleFactorSpinBox;
+    QPushButton* m_moveBtn;
+    QPushButton* m_rotateBtn;
+    QPushButton* m_scaleBtn;
+    QPushButton* m_mirrorHorizontalBtn;
+    QPushButton* m_mirrorVerticalBtn;
+    QTreeWidget* m_layerTree;
+    QPushButton* m_addLayerBtn;
+    QPushButton* m_currentLayerBtn;
+    QPushButton* m_moveToLayerBtn;
+
+    // Список слоев перестраивается программно - сигналы флажков не испускаются.
+    bool m_syncingLayers = false;
+
+    // Выделение меняется программно - сигнал objectsSelected не испускается.
+    bool m_syncingSelection = false;
 
     // Группа для кнопок-инструментов.
     QButtonGroup* m_primitiveToolsGroup;
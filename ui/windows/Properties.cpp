@@ -2,6 +2,8 @@
 #include "Point.h"
 #include "Segment.h"
 #include "Object.h"
+#include "Scene.h"
+#include "Trace.h"
 
 #include <QVBoxLayout>
 #include <QFormLayout>
@@ -17,8 +19,7 @@
 Properties::Properties(QWidget *parent)
     : QWidget(parent),
     m_coordSystem(CoordinateSystemType::Cartesian),
-    m_selectedColor(Qt::white),
-    m_currentObject(nullptr) // Вначале ничего не редактируем
+    m_selectedColor(Qt::white)
 {
     this->setObjectName("PropertiesPanel");
 
@@ -38,6 +39,25 @@ Properties::Properties(QWidget *parent)
     m_stack->setCurrentWidget(m_placeholderWidget);
 }
 
+// Устанавливает сцену, в которой ищутся редактируемые объекты.
+void Properties::setScene(Scene* scene)
+{
+    m_scene = scene;
+}
+
+// Возвращает цвет, выбранный на панели.
+QColor Properties::getSelectedColor() const
+{
+    return m_selectedColor;
+}
+
+// Возвращает редактируемый объект по сохраненному дескриптору.
+Object* Properties::currentObject() const
+{
+    if (!m_scene || !m_currentHandle.isValid()) return nullptr;
+    return m_scene->getPrimitive(m_currentHandle);
+}
+
 // Создает виджет-заглушку
 QWidget* Properties::createPlaceholderWidget()
 {
@@ -148,7 +168,7 @@ QWidget* Properties::createSegmentWidgets()
 // Показывает панель для создания нового примитива.
 void Properties::showCreationPropertiesFor(PrimitiveType type)
 {
-    m_currentObject = nullptr; // Мы в режиме создания, не редактирования
+    m_currentHandle = Handle(); // Мы в режиме создания, не редактирования
 
     if (type == PrimitiveType::Segment) {
         m_stack->setCurrentWidget(m_segmentWidget);
@@ -160,12 +180,15 @@ void Properties::showCreationPropertiesFor(PrimitiveType type)
 }
 
 // Показывает панель для редактирования существующего объекта.
-void Properties::showEditingPropertiesFor(Object* obj)
+void Properties::showEditingPropertiesFor(Handle handle)
 {
-    m_currentObject = obj; // Сохраняем указатель на редактируемый объект
+    UCAD_TRACE_SCOPE("Properties::showEditingPropertiesFor");
+    m_currentHandle = handle; // Сохраняем дескриптор редактируемого объекта
 
+    Object* obj = currentObject();
     if (obj == nullptr) {
-        // Если объект сброшен (nullptr), возвращаемся к заглушке
+        // Если объект сброшен или уже удален, возвращаемся к заглушке
+        m_currentHandle = Handle();
         m_stack->setCurrentWidget(m_placeholderWidget);
         return;
     }
@@ -191,8 +214,9 @@ void Properties::setCoordinateSystem(CoordinateSystemType type)
     m_segmentParamsStack->setCurrentIndex((type == CoordinateSystemType::Cartesian) ? 0 : 1);
 
     // Если редактируем объект, нужно пересчитать и полярные/декартовы поля
-    if(m_currentObject && m_currentObject->getType() == PrimitiveType::Segment) {
-        populateFields(static_cast<Segment*>(m_currentObject));
+    Object* obj = currentObject();
+    if(obj && obj->getType() == PrimitiveType::Segment) {
+        populateFields(static_cast<Segment*>(obj));
     } else {
         updateSegmentMetrics(); // Обновляем метрики для полей создания
     }
@@ -206,8 +230,9 @@ void Properties::updateAngleLabels()
     m_endAngleLabel->setText(unit);
 
     // Аналогично, пересчитываем поля, если в режиме редактирования
-    if(m_currentObject && m_currentObject->getType() == PrimitiveType::Segment) {
-        populateFields(static_cast<Segment*>(m_currentObject));
+    Object* obj = currentObject();
+    if(obj && obj->getType() == PrimitiveType::Segment) {
+        populateFields(static_cast<Segment*>(obj));
     } else {
         updateSegmentMetrics();
     }
@@ -236,10 +261,10 @@ void Properties::updateSegmentMetrics()
 // Обрабатывает нажатие кнопки "Создать" или "Применить".
 void Properties::onApplyClicked()
 {
-    if (m_currentObject) {
-        // Режим Редактирования - обновляем существующий объект
+    UCAD_TRACE_SCOPE("Properties::onApplyClicked");
+    if (currentObject()) {
+        // Режим Редактирования - обновляем существующий объект (сцена сама сообщит об изменении)
         updateSelectedObject();
-        emit objectModified(m_currentObject); // Сообщаем, что объект изменен
     } else {
         // Режим Создания - создаем новый объект
         Point start, end;
@@ -257,13 +282,22 @@ void Properties::onColorButtonClicked()
         updateColorButton(m_selectedColor);
 
         // Если мы в режиме редактирования, сразу применяем цвет
-        if (m_currentObject) {
-            m_currentObject->setColor(m_selectedColor);
-            emit objectModified(m_currentObject); // Сообщаем об изменении
+        if (Object* obj = currentObject()) {
+            Scene::Transaction transaction(*m_scene);
+            obj->setColor(m_selectedColor);
+            m_scene->updatePrimitive(m_currentHandle);
         }
     }
 }
 
+// Устанавливает цвет для новых объектов; при редактировании объекта цвет в полях не меняется.
+void Properties::setSelectedColor(const QColor& color)
+{
+    if (m_currentHandle.isValid()) return;
+    m_selectedColor = color;
+    updateColorButton(m_selectedColor);
+}
+
 // Обновляет цвет фона кнопки выбора цвета.
 void Properties::updateColorButton(const QColor& color)
 {
@@ -273,6 +307,7 @@ void Properties::updateColorButton(const QColor& color)
 // Заполняет поля ввода данными из объекта Segment.
 void Properties::populateFields(Segment* segment)
 {
+    UCAD_TRACE_SCOPE("Properties::populateFields");
     if (!segment) return;
 
     // Блокируем сигналы, чтобы не вызывать updateSegmentMetrics 10 раз
@@ -310,20 +345,25 @@ void Properties::populateFields(Segment* segment)
     updateSegmentMetrics();
 }
 
-// Обновляет m_currentObject данными из полей ввода.
+// Обновляет редактируемый объект данными из полей ввода.
 void Properties::updateSelectedObject()
 {
-    if (!m_currentObject || m_currentObject->getType() != PrimitiveType::Segment) {
+    UCAD_TRACE_SCOPE("Properties::updateSelectedObject");
+    Object* obj = currentObject();
+    if (!obj || obj->getType() != PrimitiveType::Segment) {
         return;
     }
 
-    auto* segment = static_cast<Segment*>(m_currentObject);
+    auto* segment = static_cast<Segment*>(obj);
     Point start, end;
     getPointsFromFields(start, end); // Получаем точки из полей
 
+    // Все изменения объекта передаются слушателям сцены одним уведомлением.
+    Scene::Transaction transaction(*m_scene);
     segment->setStart(start);
     segment->setEnd(end);
     segment->setColor(m_selectedColor);
+    m_scene->updatePrimitive(m_currentHandle);
 }
 
 // Вспомогательный метод для получения точек из полей.
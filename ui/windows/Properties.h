@@ -3,6 +3,7 @@
 #include <QWidget>
 
 #include "Enums.h"
+#include "Handle.h"
 
 // Прямые объявления.
 class QStackedWidget;
@@ -13,6 +14,7 @@ class QColor;
 class QDoubleSpinBox;
 class Object;
 class Segment;
+class Scene;
 
 // Панель для ввода параметров создаваемого объекта.
 class Properties : public QWidget
@@ -23,6 +25,12 @@ public:
     // Конструктор панели свойств.
     explicit Properties(QWidget *parent = nullptr);
 
+    // Устанавливает сцену, в которой ищутся редактируемые объекты.
+    void setScene(Scene* scene);
+
+    // Возвращает цвет, выбранный на панели (им создаются новые объекты).
+    QColor getSelectedColor() const;
+
 public slots:
     // Устанавливает текущую систему координат (декартову или полярную).
     void setCoordinateSystem(CoordinateSystemType type);
@@ -33,16 +41,16 @@ public slots:
     // Показывает панель создания.
     void showCreationPropertiesFor(PrimitiveType type);
 
-    // Показывает панель редактирования для выбранного объекта.
-    void showEditingPropertiesFor(Object* obj);
+    // Показывает панель редактирования для объекта с указанным дескриптором.
+    void showEditingPropertiesFor(Handle handle);
+
+    // Устанавливает цвет для новых объектов (цвет текущего слоя).
+    void setSelectedColor(const QColor& color);
 
 signals:
     // Сигнал, запрашивающий создание отрезка с заданными параметрами.
     void segmentCreateRequested(const Point& start, const Point& end, const QColor& color);
 
-    // Сигнал, что данные объекта были изменены.
-    void objectModified(Object* obj);
-
 private slots:
     // Слот обрабатывает и "Создать", и "Применить".
     void onApplyClicked();
@@ -54,6 +62,9 @@ private slots:
     void updateSegmentMetrics();
 
 private:
+    // Возвращает редактируемый объект или nullptr (режим создания или объект уже удален).
+    Object* currentObject() const;
+
     // Создает виджет-заглушку (когда не выбран инструмент).
     QWidget* createPlaceholderWidget();
 
@@ -79,9 +90,12 @@ private:
     CoordinateSystemType m_coordSystem;
     QColor m_selectedColor;
 
-    // Указатель на объект, который сейчас редактируется.
-    // Если nullptr, панель находится в режиме "Создание".
-    Object* m_currentObject = nullptr;
+    // Сцена, в которой хранятся редактируемые объекты.
+    Scene* m_scene = nullptr;
+
+    // Дескриптор объекта, который сейчас редактируется.
+    // Если дескриптор пуст, панель находится в режиме "Создание".
+    Handle m_currentHandle;
 
     // Элементы для отрезка
     QStackedWidget* m_segmentParamsStack;
@@ -1,14 +1,123 @@
 #include "Viewport.h"
 #include "Scene.h"
 #include "Point.h"
+#include "Segment.h"
 #include "Draw.h"
+#include "SegmentDraw.h"
+#include "Selection.h"
+#include "Trace.h"
 
 #include <QPainter>
 #include <QMouseEvent>
+#include <QKeyEvent>
 #include <QWheelEvent>
 #include <QLabel>
 #include <QGridLayout>
+#include <QTimer>
+#include <QApplication>
+#include <QScreen>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Наибольшее число затронутых объектов, при котором слой сцены перерисовывается по частям.
+constexpr std::size_t kMaxIncrementalChanges = 256;
+
+// Наименьшая площадь области (в логических пикселях), которую выгодно рисовать по плиткам:
+// небольшие области (подсветка, узкие полосы при панорамировании) рисуются в потоке интерфейса.
+constexpr int kMinTiledRenderArea = 256 * 256 * 2;
+
+// Бюджет времени на отрисовку слоя за один кадр (мс): остаток кадра 60 Гц уходит на вывод и ввод.
+constexpr qint64 kFrameBudgetMs = 12;
+
+// Количество примитивов в порции прогрессивной отрисовки (бюджет проверяется между порциями).
+constexpr std::size_t kProgressiveChunk = 8192;
+
+// Количество классов размера примитивов на экране (по степеням двойки пикселей).
+constexpr int kSizeClasses = 16;
+
+// Бюджет памяти растров слоев вместе с общим растром, байт.
+constexpr qsizetype kLayerRasterBudgetBytes = qsizetype(256) * 1024 * 1024;
+
+// Сторона плитки (в логических пикселях), которыми отмечается нарисованная за кадр часть слоя.
+constexpr int kDrawnTileSize = 64;
+
+// Размеры инфо-панели без статистики и со статистикой отрисовки.
+constexpr QSize kInfoLabelSize(100, 70);
+constexpr QSize kInfoLabelStatsSize(200, 215);
+
+// Период обновления статистики на инфо-панели, мс.
+constexpr int kStatsRefreshIntervalMs = 250;
+
+// Наименьший период обновления координат на инфо-панели при вводе, мс.
+constexpr int kInfoLabelIntervalMs = 100;
+
+// Частота обновления экрана, если система ее не сообщает, Гц.
+constexpr double kDefaultRefreshRate = 60.0;
+
+// Границы периода планировщика кадров, мс.
+constexpr int kMinFrameIntervalMs = 4;
+constexpr int kMaxFrameIntervalMs = 50;
+
+// Радиус захвата точки привязки в пикселях (не зависит от масштаба).
+constexpr double kSnapRadiusPx = 10.0;
+
+// Половина размера маркера привязки в пикселях.
+constexpr double kSnapMarkerSize = 6.0;
+
+// Сдвигает изображение ARGB32 на месте на (dx, dy) логических пикселей; открывшиеся полосы
+// становятся прозрачными. Строки переносятся memmove в порядке, при котором строка-источник
+// читается до того, как ее затрет сдвиг: без выделения памяти и без повторной отрисовки.
+void shiftImage(QImage& image, int dx, int dy)
+{
+    const qreal ratio = image.devicePixelRatio();
+    const int px = qRound(dx * ratio);
+    const int py = qRound(dy * ratio);
+    const int width = image.width();
+    const int height = image.height();
+    if (std::abs(px) >= width || std::abs(py) >= height) {
+        image.fill(Qt::transparent);
+        return;
+    }
+
+    constexpr int kPixelBytes = 4;
+    const qsizetype stride = image.bytesPerLine();
+    uchar* bits = image.bits();
+    const std::size_t keptBytes = static_cast<std::size_t>(width - std::abs(px)) * kPixelBytes;
+    const std::size_t exposedBytes = static_cast<std::size_t>(std::abs(px)) * kPixelBytes;
+    auto moveRow = [&](int y) {
+        uchar* target = bits + y * stride;
+        const uchar* source = bits + (y - py) * stride;
+        std::memmove(target + std::max(px, 0) * kPixelBytes, source + std::max(-px, 0) * kPixelBytes, keptBytes);
+        std::memset(px > 0 ? target : target + (width + px) * kPixelBytes, 0, exposedBytes);
+    };
+    if (py > 0) {
+        for (int y = height - 1; y >= py; --y) moveRow(y);
+        for (int y = 0; y < py; ++y) {
+            std::memset(bits + y * stride, 0, static_cast<std::size_t>(width) * kPixelBytes);
+        }
+    } else {
+        for (int y = 0; y < height + py; ++y) moveRow(y);
+        for (int y = height + py; y < height; ++y) {
+            std::memset(bits + y * stride, 0, static_cast<std::size_t>(width) * kPixelBytes);
+        }
+    }
+}
+
+// Создает прозрачное изображение размера и плотности пикселей слоя сцены.
+QImage transparentImageLike(const QImage& layer)
+{
+    QImage image(layer.size(), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(layer.devicePixelRatio());
+    image.fill(Qt::transparent);
+    return image;
+}
+
+} // namespace
 
 // Конструктор виджета Viewport.
 Viewport::Viewport(QWidget *parent) : QWidget(parent)
@@ -20,7 +129,7 @@ Viewport::Viewport(QWidget *parent) : QWidget(parent)
     // Создание и настройка инфо-панели.
     m_infoLabel = new QLabel(this);
     m_infoLabel->setObjectName("InfoLabel");
-    m_infoLabel->setFixedSize(100, 70);
+    m_infoLabel->setFixedSize(kInfoLabelSize);
     m_infoLabel->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
 
     // Размещение инфо-панели в правом нижнем углу.
@@ -30,110 +139,1258 @@ Viewport::Viewport(QWidget *parent) : QWidget(parent)
     layout->setRowStretch(0, 1);
     layout->setColumnStretch(0, 1);
 
+    // Таймер уточнения масштаба: срабатывает после паузы в прокрутке колеса.
+    m_zoomRefineTimer = new QTimer(this);
+    m_zoomRefineTimer->setSingleShot(true);
+    m_zoomRefineTimer->setInterval(150);
+    connect(m_zoomRefineTimer, &QTimer::timeout, this, [this]() { update(); });
+
+    // Планировщик кадров: накопленный ввод применяется один раз за период обновления экрана.
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setSingleShot(true);
+    m_frameTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_frameTimer, &QTimer::timeout, this, &Viewport::applyPendingInput);
+    m_inputClock.start();
+
+    // Таймер продолжения прогрессивной отрисовки: срабатывает, когда очередь событий пуста.
+    m_progressiveTimer = new QTimer(this);
+    m_progressiveTimer->setSingleShot(true);
+    m_progressiveTimer->setInterval(0);
+    connect(m_progressiveTimer, &QTimer::timeout, this, [this]() { update(); });
+
+    // Таймер построения индекса привязки: порция не дольше бюджета кадра, затем обработка событий.
+    m_snapBuildTimer = new QTimer(this);
+    m_snapBuildTimer->setSingleShot(true);
+    m_snapBuildTimer->setInterval(0);
+    connect(m_snapBuildTimer, &QTimer::timeout, this, [this]() {
+        if (m_scene && m_snapEnabled && !m_snapIndex.build(*m_scene, kFrameBudgetMs)) m_snapBuildTimer->start();
+    });
+
+    // Статистика на инфо-панели обновляется по таймеру, а не из paintEvent:
+    // смена текста панели сама вызывает перерисовку вьюпорта под ней.
+    m_statsRefreshTimer = new QTimer(this);
+    m_statsRefreshTimer->setInterval(kStatsRefreshIntervalMs);
+    connect(m_statsRefreshTimer, &QTimer::timeout, this, &Viewport::updateInfoLabel);
+
+    // Координаты курсора на инфо-панели обновляются реже кадров: смена текста пересчитывает
+    // раскладку панели, а чаще, чем ее успевают прочитать, это не нужно.
+    m_infoLabelTimer = new QTimer(this);
+    m_infoLabelTimer->setSingleShot(true);
+    m_infoLabelTimer->setInterval(kInfoLabelIntervalMs);
+    connect(m_infoLabelTimer, &QTimer::timeout, this, &Viewport::updateInfoLabel);
+
     updateInfoLabel();
 }
 
 // Главный метод отрисовки виджета.
 void Viewport::paintEvent(QPaintEvent *event)
 {
+    UCAD_TRACE_SCOPE("Viewport::paintEvent");
     Q_UNUSED(event);
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    m_repaintRequested = false;
+    m_frameStats = FrameStats();
+    m_frameRepaintedArea = 0.0;
+
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
 
     painter.fillRect(rect(), QColor("#1A1B26"));
 
     drawGrid(painter);
+
+    if (m_scene && m_drawingStrategies) {
+        // Приводим кэшированный слой сцены к текущему виду и выводим его на экран.
+        updateSceneLayer();
+        drawSceneLayer(painter);
+        drawHoverHighlight(painter);
+        drawIntersections(painter);
+    }
+
+    drawRubberBand(painter);
+
+    drawDraftSegment(painter);
+    drawSnapMarker(painter);
+
     drawGizmo(painter);
 
-    if (!m_scene || !m_drawingStrategies) return;
+    if (m_scene) {
+        // Все, что не рассмотрено в этом кадре, отсечено индексом или взято из кэша слоя.
+        const std::size_t total = m_scene->getPrimitiveCount();
+        const double area = std::max(1, width() * height());
+        m_frameStats.culled = total > m_frameStats.visited ? total - m_frameStats.visited : 0;
+        m_frameStats.cacheHitRate = 1.0 - std::min(1.0, m_frameRepaintedArea / area);
+        m_frameStats.frameMs = frameTimer.nsecsElapsed() / 1e6;
+        // Задержка ввода измеряется до конца кадра; вывод буфера на экран в нее не входит.
+        if (m_unpresentedInputNs >= 0) {
+            m_frameStats.inputLatencyMs = (m_inputClock.nsecsElapsed() - m_unpresentedInputNs) / 1e6;
+        }
+        m_renderStats.addFrame(m_frameStats);
+    }
+    m_unpresentedInputNs = -1;
+}
+
+// Приводит кэшированный слой сцены в соответствие с текущими сдвигом и масштабом.
+void Viewport::updateSceneLayer()
+{
+    const qreal pixelRatio = devicePixelRatioF();
+    const QSize layerSize = size() * pixelRatio;
+
+    // Слой устарел целиком: изменилась сцена, размер виджета или плотность пикселей.
+    if (!m_layerValid || m_sceneLayer.size() != layerSize || m_sceneLayer.devicePixelRatio() != pixelRatio) {
+        renderSceneLayer();
+        return;
+    }
+
+    // Во время прокрутки колесом показывается масштабированная копия слоя,
+    // а точная перерисовка откладывается до паузы в прокрутке.
+    if (m_layerZoom != m_zoomFactor) {
+        if (!m_zoomRefineTimer->isActive()) {
+            renderSceneLayer();
+        }
+        return;
+    }
+
+    // Незавершенная прогрессивная отрисовка сдвигается вместе со слоем и продолжается.
+    if (m_layerPanOffset != m_panOffset) {
+        scrollSceneLayer();
+    }
+
+    // Смена видимости слоев: слой сцены собирается из растров слоев.
+    if (m_layerVisibilityChanged) {
+        recompositeLayers();
+    }
+
+    if (!m_layerDirty.isEmpty()) {
+        repaintDirtyLayerRegion();
+    }
+
+    if (m_progressiveActive) {
+        continueProgressivePass();
+    }
+}
+
+// Начинает перерисовку слоя сцены и растров слоев целиком для текущего вида.
+void Viewport::renderSceneLayer()
+{
+    UCAD_TRACE_SCOPE("Viewport::renderSceneLayer");
+    const qreal pixelRatio = devicePixelRatioF();
+    if (m_sceneLayer.size() != size() * pixelRatio) {
+        m_sceneLayer = QImage(size() * pixelRatio, QImage::Format_ARGB32_Premultiplied);
+    }
+    m_sceneLayer.setDevicePixelRatio(pixelRatio);
+    m_sceneLayer.fill(Qt::transparent);
+
+    m_layerPanOffset = m_panOffset;
+    m_layerZoom = m_zoomFactor;
+    m_layerValid = true;
+    m_layerDirty = QRegion();
+
+    // Растры видимых слоев заполняются прогрессивной отрисовкой; растры скрытых слоев
+    // освобождаются и заполняются при показе слоя. Собственные растры в пределах бюджета
+    // памяти получают недавно показанные слои, остальные видимые слои рисуются в общий растр.
+    const std::uint32_t layerCount = m_scene->getLayerCount();
+    m_layerRasters.resize(layerCount);
+    m_shownLayers.resize(layerCount);
+    std::vector<std::uint32_t> visibleLayers;
+    for (std::uint32_t layer = 0; layer < layerCount; ++layer) {
+        const bool visible = m_scene->getLayer(layer).visible;
+        m_shownLayers[layer] = visible ? 1 : 0;
+        LayerRaster& raster = m_layerRasters[layer];
+        raster.image = QImage();
+        raster.valid = visible;
+        raster.shared = false;
+        raster.queueStart = 0;
+        if (visible) visibleLayers.push_back(layer);
+    }
+    const std::size_t ownRasters = maxLayerRasters();
+    if (visibleLayers.size() > ownRasters) {
+        std::nth_element(visibleLayers.begin(), visibleLayers.begin() + ownRasters, visibleLayers.end(),
+                         [this](std::uint32_t a, std::uint32_t b) {
+                             return m_layerRasters[a].lastUsed > m_layerRasters[b].lastUsed;
+                         });
+        for (auto it = visibleLayers.begin() + ownRasters; it != visibleLayers.end(); ++it) {
+            m_layerRasters[*it].shared = true;
+        }
+    }
+    m_sharedRaster = QImage();
+    m_layerVisibilityChanged = false;
+
+    // Слой заполняется прогрессивно: сколько успеет за кадр, остальное - в следующих кадрах.
+    startProgressivePass();
+    continueProgressivePass();
+}
+
+// Собирает очередь видимых примитивов для прогрессивной отрисовки: крупные на экране - первыми.
+void Viewport::startProgressivePass()
+{
+    UCAD_TRACE_SCOPE("Viewport::startProgressivePass");
+    m_progressiveQueue.clear();
+    m_progressiveBatches.clear();
+    m_progressiveNext = 0;
+    m_visibleHandles.clear();
+    m_scene->queryPrimitives(layerRectToWorld(rect()), m_visibleHandles);
+    enqueueProgressive(m_visibleHandles);
+}
+
+// Добавляет примитивы в очередь прогрессивной отрисовки по классу размера, внутри класса - по слоям.
+void Viewport::enqueueProgressive(const std::vector<Handle>& handles)
+{
+    // Сортировка подсчетом по ключу (класс размера, слой) - линейное время даже для миллионов
+    // примитивов; соседние примитивы одного слоя рисуются в его растр одним пакетом.
+    const std::size_t layerCount = std::max<std::size_t>(1, m_scene->getLayerCount());
+    std::vector<std::uint32_t> keys(handles.size());
+    std::vector<std::size_t> offsets(kSizeClasses * layerCount + 1, 0);
+    for (std::size_t i = 0; i < handles.size(); ++i) {
+        const QRectF box = m_scene->getBoundingBox(handles[i]);
+        const double extent = std::max(box.width(), box.height()) * m_layerZoom;
+        const int sizeClass = extent < 1.0 ? 0 : std::min(kSizeClasses - 1, 1 + static_cast<int>(std::log2(extent)));
+        const std::size_t layer = std::min<std::size_t>(m_scene->getPrimitiveLayer(handles[i]), layerCount - 1);
+        keys[i] = static_cast<std::uint32_t>((kSizeClasses - 1 - sizeClass) * layerCount + layer); // Крупные - в начало.
+        ++offsets[keys[i] + 1];
+    }
+    for (std::size_t k = 0; k + 1 < offsets.size(); ++k) {
+        offsets[k + 1] += offsets[k];
+    }
+
+    const std::size_t base = m_progressiveQueue.size();
+    m_progressiveQueue.resize(base + handles.size());
+    for (std::size_t i = 0; i < handles.size(); ++i) {
+        m_progressiveQueue[base + offsets[keys[i]]++] = handles[i];
+    }
+    if (!handles.empty()) m_progressiveBatches.push_back({m_progressiveQueue.size(), rect()});
+    m_progressiveActive = m_progressiveNext < m_progressiveQueue.size();
+}
+
+// Рисует очередные порции прогрессивной отрисовки в растры слоев, пока не исчерпан бюджет кадра,
+// и собирает из растров слой сцены.
+void Viewport::continueProgressivePass()
+{
+    UCAD_TRACE_SCOPE("Viewport::continueProgressivePass");
+    QElapsedTimer timer;
+    timer.start();
+
+    m_drawnTileColumns = (width() + kDrawnTileSize - 1) / kDrawnTileSize;
+    const int tileRows = (height() + kDrawnTileSize - 1) / kDrawnTileSize;
+    m_drawnTiles.assign(static_cast<std::size_t>(m_drawnTileColumns) * tileRows, 0);
+
+    auto batch = m_progressiveBatches.begin();
+    while (m_progressiveNext < m_progressiveQueue.size()) {
+        // Порция не выходит за пакет: у каждого пакета своя еще не нарисованная область слоя.
+        while (batch->end <= m_progressiveNext) ++batch;
+        if (batch->clip.isEmpty()) {
+            m_progressiveNext = batch->end;
+            continue;
+        }
+        const std::size_t end = std::min(batch->end, m_progressiveNext + kProgressiveChunk);
+        // Порция рисуется участками подряд идущих примитивов одного слоя.
+        for (std::size_t first = m_progressiveNext; first < end;) {
+            const std::uint32_t layer = m_scene->getPrimitiveLayer(m_progressiveQueue[first]);
+            std::size_t last = first + 1;
+            while (last < end && m_scene->getPrimitiveLayer(m_progressiveQueue[last]) == layer) ++last;
+            // Записи, поставленные до перестройки растра слоя, уже не рисуются.
+            const bool drawable = layer < m_layerRasters.size() && m_layerRasters[layer].valid
+                && first >= m_layerRasters[layer].queueStart;
+            if (drawable) {
+                m_progressiveChunk.assign(m_progressiveQueue.begin() + first, m_progressiveQueue.begin() + last);
+                {
+                    QPainter painter(&layerImage(layer));
+                    painter.setRenderHint(QPainter::Antialiasing);
+                    drawPrimitives(painter, batch->clip, m_progressiveChunk);
+                }
+                markDrawnTiles(m_progressiveChunk, batch->clip);
+            }
+            first = last;
+        }
+        m_progressiveNext = end;
+        if (timer.elapsed() >= kFrameBudgetMs) break;
+    }
+
+    // Слой сцены собирается только там, где в этом кадре что-то нарисовано.
+    const QRegion drawn = drawnRegion();
+    for (const QRect& drawnRect : drawn) {
+        m_frameRepaintedArea += static_cast<double>(drawnRect.width()) * drawnRect.height();
+    }
+    compositeSceneLayer(drawn);
+
+    if (m_progressiveNext >= m_progressiveQueue.size()) {
+        m_progressiveActive = false;
+        m_progressiveQueue.clear();
+        m_progressiveBatches.clear();
+        m_progressiveNext = 0;
+        for (LayerRaster& raster : m_layerRasters) raster.queueStart = 0;
+    } else {
+        // Продолжение - в следующем проходе цикла событий, после обработки ввода.
+        m_progressiveTimer->start();
+    }
+}
+
+// Сдвигает слой сцены и растры слоев на целое число пикселей и дорисовывает только открывшиеся полосы.
+void Viewport::scrollSceneLayer()
+{
+    UCAD_TRACE_SCOPE("Viewport::scrollSceneLayer");
+    // Сдвиг в экранных пикселях (ось Y экрана направлена вниз).
+    const QPointF delta = m_panOffset - m_layerPanOffset;
+    const int dx = qRound(delta.x() * m_zoomFactor);
+    const int dy = qRound(-delta.y() * m_zoomFactor);
+    if (dx == 0 && dy == 0) return;
+
+    if (std::abs(dx) >= width() || std::abs(dy) >= height()) {
+        renderSceneLayer();
+        return;
+    }
+
+    // Слой теперь соответствует сдвигу ровно на целое число пикселей;
+    // дробный остаток учитывается при выводе слоя на экран.
+    m_layerPanOffset += QPointF(dx / m_zoomFactor, -dy / m_zoomFactor);
+
+    shiftImage(m_sceneLayer, dx, dy);
+    if (!m_sharedRaster.isNull()) shiftImage(m_sharedRaster, dx, dy);
+    for (LayerRaster& raster : m_layerRasters) {
+        if (raster.valid && !raster.image.isNull()) shiftImage(raster.image, dx, dy);
+    }
+
+    // Недорисованные пакеты очереди сужаются до сохранившейся части слоя: открывшиеся
+    // полосы рисуются ниже целиком, поэтому очередь не перестраивается.
+    for (ProgressiveBatch& pending : m_progressiveBatches) {
+        if (pending.end > m_progressiveNext) pending.clip = pending.clip.translated(dx, dy) & rect();
+    }
+
+    // Открывшиеся полосы по горизонтали и вертикали.
+    const QRegion exposed = QRegion(rect()) - QRegion(rect().translated(dx, dy));
+    for (const QRect& strip : exposed) {
+        renderLayers(strip);
+    }
+    compositeSceneLayer(exposed);
+
+    // Устаревшие области сдвигаются вместе с содержимым слоя.
+    m_layerDirty.translate(dx, dy);
+    m_layerDirty &= QRegion(rect());
+}
+
+// Рисует заново устаревшие области растров слоев и собирает их в слое сцены.
+void Viewport::repaintDirtyLayerRegion()
+{
+    UCAD_TRACE_SCOPE("Viewport::repaintDirtyLayerRegion");
+    for (const QRect& dirtyRect : m_layerDirty) {
+        renderLayers(dirtyRect);
+    }
+    compositeSceneLayer(m_layerDirty);
+    m_layerDirty = QRegion();
+}
+
+// Собирает слой сцены из растров слоев после смены видимости. Растр слоя, скрытого
+// при перерисовке вида или освобожденного по бюджету памяти, заполняется прогрессивной
+// отрисовкой при показе слоя, а не в этом кадре.
+void Viewport::recompositeLayers()
+{
+    UCAD_TRACE_SCOPE("Viewport::recompositeLayers");
+    addLayerRasters();
+    m_shownLayers.resize(m_scene->getLayerCount());
+
+    // Общий растр не разбирается по слоям: скрытый слой убирается из него перерисовкой остальных.
+    bool rebuildShared = false;
+    for (std::uint32_t layer = 0; layer < m_layerRasters.size(); ++layer) {
+        const bool visible = m_scene->getLayer(layer).visible;
+        LayerRaster& raster = m_layerRasters[layer];
+        if ((m_shownLayers[layer] != 0) != visible) raster.lastUsed = ++m_layerRasterClock;
+        m_shownLayers[layer] = visible ? 1 : 0;
+        if (raster.shared && !visible) {
+            raster.shared = false;
+            raster.valid = false;
+            rebuildShared = true;
+        }
+    }
+    if (rebuildShared) {
+        if (!m_sharedRaster.isNull()) m_sharedRaster.fill(Qt::transparent);
+        for (std::uint32_t layer = 0; layer < m_layerRasters.size(); ++layer) {
+            if (m_layerRasters[layer].shared) enqueueLayer(layer);
+        }
+    }
+
+    for (std::uint32_t layer = 0; layer < m_layerRasters.size(); ++layer) {
+        if (m_shownLayers[layer] != 0 && !m_layerRasters[layer].valid) {
+            reserveLayerRaster();
+            m_layerRasters[layer].valid = true;
+            enqueueLayer(layer);
+        }
+    }
+    compositeSceneLayer(QRegion(rect()));
+    m_layerVisibilityChanged = false;
+}
+
+// Ставит в очередь прогрессивной отрисовки видимые примитивы слоя. Записи слоя,
+// уже стоящие в очереди, относятся к прежнему содержимому растра и не рисуются.
+void Viewport::enqueueLayer(std::uint32_t layer)
+{
+    m_layerRasters[layer].queueStart = m_progressiveQueue.size();
+    m_visibleHandles.clear();
+    m_scene->queryLayer(layer, layerRectToWorld(rect()), m_visibleHandles);
+    enqueueProgressive(m_visibleHandles);
+}
+
+// Возвращает наибольшее число собственных растров слоев в бюджете памяти (место под общий растр
+// и хотя бы один собственный растр остается всегда).
+std::size_t Viewport::maxLayerRasters() const
+{
+    const qsizetype rasterBytes = std::max<qsizetype>(1, m_sceneLayer.sizeInBytes());
+    return static_cast<std::size_t>(std::max<qsizetype>(2, kLayerRasterBudgetBytes / rasterBytes) - 1);
+}
+
+// Освобождает в бюджете памяти место под еще один собственный растр слоя: освобождается растр
+// слоя, скрытого раньше всех (он строится заново при показе), а если скрытых нет - растр
+// видимого слоя, который дольше всех не переключали, сливается в общий растр.
+void Viewport::reserveLayerRaster()
+{
+    constexpr std::uint32_t kNoLayer = std::numeric_limits<std::uint32_t>::max();
+    std::size_t ownRasters = 0;
+    std::uint32_t hiddenVictim = kNoLayer;
+    std::uint32_t visibleVictim = kNoLayer;
+    for (std::uint32_t layer = 0; layer < m_layerRasters.size(); ++layer) {
+        const LayerRaster& raster = m_layerRasters[layer];
+        if (!raster.valid || raster.shared) continue;
+        ++ownRasters;
+        std::uint32_t& victim = m_shownLayers[layer] != 0 ? visibleVictim : hiddenVictim;
+        if (victim == kNoLayer || raster.lastUsed < m_layerRasters[victim].lastUsed) victim = layer;
+    }
+    if (ownRasters < maxLayerRasters()) return;
+
+    if (hiddenVictim != kNoLayer) {
+        LayerRaster& raster = m_layerRasters[hiddenVictim];
+        raster.image = QImage();
+        raster.valid = false;
+    } else if (visibleVictim != kNoLayer) {
+        LayerRaster& raster = m_layerRasters[visibleVictim];
+        if (!raster.image.isNull()) {
+            if (m_sharedRaster.isNull()) m_sharedRaster = transparentImageLike(m_sceneLayer);
+            QPainter painter(&m_sharedRaster);
+            painter.drawImage(QPoint(0, 0), raster.image);
+        }
+        raster.image = QImage();
+        raster.shared = true;
+    }
+}
+
+// Заводит растры слоев, добавленных после перерисовки вида. Они были пусты - их растры
+// актуальны; сверх бюджета памяти такие слои рисуются в общий растр.
+void Viewport::addLayerRasters()
+{
+    if (m_layerRasters.size() >= m_scene->getLayerCount()) return;
+    std::size_t ownRasters = 0;
+    for (const LayerRaster& raster : m_layerRasters) {
+        if (raster.valid && !raster.shared) ++ownRasters;
+    }
+    const std::size_t maxRasters = maxLayerRasters();
+    while (m_layerRasters.size() < m_scene->getLayerCount()) {
+        LayerRaster raster;
+        raster.valid = true;
+        raster.shared = ownRasters >= maxRasters;
+        raster.lastUsed = ++m_layerRasterClock;
+        if (!raster.shared) ++ownRasters;
+        m_layerRasters.push_back(std::move(raster));
+    }
+}
+
+// Перерисовывает область во всех поддерживаемых растрах слоев, включая растры скрытых слоев.
+void Viewport::renderLayers(const QRect& screenRect)
+{
+    addLayerRasters();
+    m_frameRepaintedArea += static_cast<double>(screenRect.width()) * screenRect.height();
+
+    // Общий растр очищается один раз, затем в него рисуются все слои, которые в нем лежат.
+    if (!m_sharedRaster.isNull()) {
+        QPainter painter(&m_sharedRaster);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(screenRect, Qt::transparent);
+    }
+
+    for (std::uint32_t layer = 0; layer < m_layerRasters.size(); ++layer) {
+        LayerRaster& raster = m_layerRasters[layer];
+        if (!raster.valid) continue;
+
+        // Запрашиваем у слоя только примитивы, попадающие в перерисовываемую область.
+        m_visibleHandles.clear();
+        m_scene->queryLayer(layer, layerRectToWorld(screenRect), m_visibleHandles);
+        if (m_visibleHandles.empty() && (raster.shared || raster.image.isNull())) continue;
+
+        QPainter painter(&layerImage(layer));
+        if (!raster.shared) {
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.fillRect(screenRect, Qt::transparent);
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        }
+        painter.setRenderHint(QPainter::Antialiasing);
+        if (!m_visibleHandles.empty()) drawPrimitives(painter, screenRect, m_visibleHandles);
+    }
+}
+
+// Собирает область слоя сцены из растров видимых слоев: сначала общий растр, затем
+// собственные растры в порядке слоев.
+void Viewport::compositeSceneLayer(const QRegion& region)
+{
+    if (region.isEmpty()) return;
+    QPainter painter(&m_sceneLayer);
+    painter.setClipRegion(region);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(region.boundingRect(), Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    if (!m_sharedRaster.isNull()) painter.drawImage(QPoint(0, 0), m_sharedRaster);
+    const std::size_t count = std::min(m_layerRasters.size(), m_scene->getLayerCount());
+    for (std::uint32_t layer = 0; layer < count; ++layer) {
+        const LayerRaster& raster = m_layerRasters[layer];
+        if (raster.valid && !raster.shared && !raster.image.isNull() && m_scene->getLayer(layer).visible) {
+            painter.drawImage(QPoint(0, 0), raster.image);
+        }
+    }
+}
+
+// Возвращает изображение, в которое рисуется слой (собственный или общий растр),
+// создавая прозрачное при первой отрисовке в него.
+QImage& Viewport::layerImage(std::uint32_t layer)
+{
+    LayerRaster& raster = m_layerRasters[layer];
+    QImage& image = raster.shared ? m_sharedRaster : raster.image;
+    if (image.isNull()) image = transparentImageLike(m_sceneLayer);
+    return image;
+}
+
+// Отмечает плитки слоя, которые задевают нарисованные в пределах clip примитивы.
+void Viewport::markDrawnTiles(const std::vector<Handle>& handles, const QRect& clip)
+{
+    for (const Handle& handle : handles) {
+        const QRect box = worldRectToLayer(m_scene->getBoundingBox(handle)) & clip;
+        if (box.isEmpty()) continue;
+        const int left = box.left() / kDrawnTileSize;
+        const int right = box.right() / kDrawnTileSize;
+        for (int row = box.top() / kDrawnTileSize; row <= box.bottom() / kDrawnTileSize; ++row) {
+            char* tiles = m_drawnTiles.data() + static_cast<std::size_t>(row) * m_drawnTileColumns;
+            std::fill(tiles + left, tiles + right + 1, char(1));
+        }
+    }
+}
+
+// Собирает отмеченные плитки в область слоя: по строкам плиток, подряд идущие плитки - одним прямоугольником.
+QRegion Viewport::drawnRegion()
+{
+    m_drawnRects.clear();
+    const int rows = m_drawnTileColumns > 0 ? static_cast<int>(m_drawnTiles.size() / m_drawnTileColumns) : 0;
+    for (int row = 0; row < rows; ++row) {
+        const char* tiles = m_drawnTiles.data() + static_cast<std::size_t>(row) * m_drawnTileColumns;
+        for (int column = 0; column < m_drawnTileColumns;) {
+            if (!tiles[column]) {
+                ++column;
+                continue;
+            }
+            const int first = column;
+            while (column < m_drawnTileColumns && tiles[column]) ++column;
+            m_drawnRects.push_back(QRect(first * kDrawnTileSize, row * kDrawnTileSize,
+                                         (column - first) * kDrawnTileSize, kDrawnTileSize) & rect());
+        }
+    }
+    QRegion region;
+    region.setRects(m_drawnRects.data(), static_cast<int>(m_drawnRects.size()));
+    return region;
+}
+
+// Выводит слой сцены на экран с учетом разницы между видом слоя и текущим видом.
+void Viewport::drawSceneLayer(QPainter& painter)
+{
+    // Преобразование из координат слоя в текущие экранные координаты:
+    // масштаб - отношение масштабов, сдвиг - разница смещений вида.
+    const double scale = m_zoomFactor / m_layerZoom;
+    const QPointF panDelta = m_panOffset - m_layerPanOffset;
+    const double tx = panDelta.x() * m_zoomFactor;
+    const double ty = height() * (1.0 - scale) - panDelta.y() * m_zoomFactor;
 
-    // Настройка трансформации для отрисовки объектов сцены.
     painter.save();
+    painter.setTransform(QTransform(scale, 0.0, 0.0, scale, tx, ty));
+    painter.drawImage(QPointF(0.0, 0.0), m_sceneLayer);
+    painter.restore();
+}
+
+// Отрисовывает указанные примитивы в экранной области screenRect слоя.
+void Viewport::drawPrimitives(QPainter& painter, const QRect& screenRect, const std::vector<Handle>& handles)
+{
+    m_frameStats.visited += handles.size();
+    if (m_parallelRendering && screenRect.width() * screenRect.height() >= kMinTiledRenderArea) {
+        drawPrimitivesTiled(painter, screenRect, handles);
+        return;
+    }
+
+    painter.save();
+    painter.setClipRect(screenRect);
+
+    // Настройка трансформации для отрисовки объектов сцены (в виде, для которого построен слой).
     painter.translate(0, height());
     painter.scale(1, -1);
-    painter.scale(m_zoomFactor, m_zoomFactor);
-    painter.translate(m_panOffset.x(), m_panOffset.y());
+    painter.scale(m_layerZoom, m_layerZoom);
+    painter.translate(m_layerPanOffset.x(), m_layerPanOffset.y());
+
+    auto segmentDraw = m_drawingStrategies->find(PrimitiveType::Segment);
+    const auto* segmentBatchDraw = (segmentDraw != m_drawingStrategies->end())
+        ? dynamic_cast<const SegmentDraw*>(segmentDraw->second.get()) : nullptr;
 
-    // Отрисовка каждого примитива на сцене.
-    for (const auto& primitive : m_scene->getPrimitives()) {
+    // Разделяем видимые примитивы: отрезки рисуются пакетно по строкам хранилища,
+    // прочие примитивы - по одному через свои стратегии.
+    m_visibleSegmentRows.clear();
+    m_selectedSegmentRows.clear();
+    for (const Handle& handle : handles) {
+        // Проверяем, является ли текущий примитив выбранным
+        bool isSelected = m_selection && m_selection->contains(handle);
+
+        const std::size_t row = m_scene->getSegmentRow(handle);
+        if (row != SegmentStore::npos) {
+            if (segmentBatchDraw) {
+                m_visibleSegmentRows.push_back(row);
+                if (isSelected) m_selectedSegmentRows.push_back(row);
+            } else if (segmentDraw != m_drawingStrategies->end()) {
+                Segment view(m_scene, handle);
+                segmentDraw->second->draw(painter, &view, isSelected);
+                ++m_frameStats.drawn;
+                ++m_frameStats.drawCalls;
+            }
+            continue;
+        }
+
+        Object* primitive = m_scene->getPrimitive(handle);
+        if (!primitive) continue;
         auto it = m_drawingStrategies->find(primitive->getType());
         if (it != m_drawingStrategies->end()) {
-            // Проверяем, является ли текущий примитив выбранным
-            bool isSelected = (primitive.get() == m_selectedObject);
-            it->second->draw(painter, primitive.get(), isSelected);
+            it->second->draw(painter, primitive, isSelected);
+            ++m_frameStats.drawn;
+            ++m_frameStats.drawCalls;
         }
     }
+
+    if (segmentBatchDraw) {
+        // В режиме детализации субпиксельные отрезки выводятся точками.
+        const double lodPixelSize = m_levelOfDetail ? 1.0 / (m_layerZoom * painter.device()->devicePixelRatioF()) : 0.0;
+        m_frameStats.drawCalls += segmentBatchDraw->drawBatch(painter, m_scene->getSegments(), m_visibleSegmentRows,
+                                                              m_selectedSegmentRows, lodPixelSize);
+        m_frameStats.drawn += m_visibleSegmentRows.size();
+    }
     painter.restore();
 }
 
+// Отрисовывает примитивы по плиткам: каждая плитка рисуется в свой растр на рабочем потоке.
+void Viewport::drawPrimitivesTiled(QPainter& painter, const QRect& screenRect, const std::vector<Handle>& handles)
+{
+    // То же преобразование, что и при отрисовке в потоке интерфейса (вид, для которого построен слой).
+    QTransform worldToScreen;
+    worldToScreen.translate(0, height());
+    worldToScreen.scale(1, -1);
+    worldToScreen.scale(m_layerZoom, m_layerZoom);
+    worldToScreen.translate(m_layerPanOffset.x(), m_layerPanOffset.y());
+
+    TileRenderer::View view;
+    view.worldToScreen = worldToScreen;
+    view.pixelRatio = painter.device()->devicePixelRatioF();
+    view.lodPixelSize = m_levelOfDetail ? 1.0 / (m_layerZoom * view.pixelRatio) : 0.0;
+
+    painter.save();
+    painter.setClipRect(screenRect);
+    const TileRenderer::Counters counters =
+        m_tileRenderer.renderPrimitives(painter, screenRect, *m_scene, *m_drawingStrategies, m_selection, view, handles);
+    m_frameStats.drawn += counters.drawn;
+    m_frameStats.drawCalls += counters.drawCalls;
+    painter.restore();
+}
+
+// Переводит мировой прямоугольник в экранную область слоя (с запасом на толщину пера и сглаживание).
+QRect Viewport::worldRectToLayer(const QRectF& worldRect) const
+{
+    // Запас на толщину пера подсветки в мировых единицах и на пиксель сглаживания.
+    const double margin = 3.0;
+    const double left = (worldRect.left() - margin + m_layerPanOffset.x()) * m_layerZoom;
+    const double right = (worldRect.right() + margin + m_layerPanOffset.x()) * m_layerZoom;
+    const double top = height() - (worldRect.bottom() + margin + m_layerPanOffset.y()) * m_layerZoom;
+    const double bottom = height() - (worldRect.top() - margin + m_layerPanOffset.y()) * m_layerZoom;
+    return QRectF(QPointF(left, top), QPointF(right, bottom)).toAlignedRect().adjusted(-1, -1, 1, 1);
+}
+
+// Переводит экранную область слоя в мировые координаты (с запасом на толщину пера).
+QRectF Viewport::layerRectToWorld(const QRect& screenRect) const
+{
+    const double left = screenRect.left() / m_layerZoom - m_layerPanOffset.x();
+    const double right = (screenRect.left() + screenRect.width()) / m_layerZoom - m_layerPanOffset.x();
+    const double bottom = (height() - screenRect.top() - screenRect.height()) / m_layerZoom - m_layerPanOffset.y();
+    const double top = (height() - screenRect.top()) / m_layerZoom - m_layerPanOffset.y();
+
+    // Запас на толщину пера подсветки, чтобы не обрезать линии у края области.
+    const double margin = 3.0;
+    return QRectF(QPointF(left - margin, bottom - margin), QPointF(right + margin, top + margin));
+}
+
+// Включает или выключает упрощенную отрисовку субпиксельных отрезков.
+void Viewport::setLevelOfDetailEnabled(bool enabled)
+{
+    if (m_levelOfDetail != enabled) {
+        m_levelOfDetail = enabled;
+        invalidateSceneLayer();
+    }
+}
+
+// Возвращает статистику отрисовки.
+RenderStats& Viewport::getRenderStats()
+{
+    return m_renderStats;
+}
+
+// Возвращает true, если статистика отрисовки показывается на инфо-панели.
+bool Viewport::isStatsOverlayVisible() const
+{
+    return m_statsVisible;
+}
+
+// Показывает или скрывает статистику отрисовки на инфо-панели.
+void Viewport::setStatsOverlayVisible(bool visible)
+{
+    if (m_statsVisible == visible) return;
+    m_statsVisible = visible;
+    m_infoLabel->setFixedSize(visible ? kInfoLabelStatsSize : kInfoLabelSize);
+    if (visible) {
+        m_renderStats.clear();
+        m_statsRefreshTimer->start();
+    } else {
+        m_statsRefreshTimer->stop();
+    }
+    updateInfoLabel();
+}
+
+// Включает или выключает параллельную отрисовку по плиткам.
+void Viewport::setParallelRenderingEnabled(bool enabled)
+{
+    if (m_parallelRendering != enabled) {
+        m_parallelRendering = enabled;
+        invalidateSceneLayer();
+    }
+}
+
+// Помечает слой сцены устаревшим и запрашивает перерисовку.
+void Viewport::invalidateSceneLayer()
+{
+    m_layerValid = false;
+    update();
+}
+
+// Помечает устаревшей часть слоя, покрывающую мировой прямоугольник.
+void Viewport::invalidateSceneRect(const QRectF& worldRect)
+{
+    // Невалидный слой все равно будет перерисован целиком.
+    if (!m_layerValid) return;
+
+    // Во время прогрессивной отрисовки очередь могла устареть - слой строится заново.
+    if (m_progressiveActive) {
+        invalidateSceneLayer();
+        return;
+    }
+
+    const QRect dirtyRect = worldRectToLayer(worldRect) & rect();
+    if (dirtyRect.isEmpty()) return;
+
+    m_layerDirty += dirtyRect;
+
+    // Слишком сложную область дешевле перерисовать одним охватывающим прямоугольником.
+    if (m_layerDirty.rectCount() > 32) {
+        m_layerDirty = m_layerDirty.boundingRect();
+    }
+
+    update();
+}
+
+// Перерисовывает в слое только прямоугольники примитивов до и после изменения.
+void Viewport::applySceneChange(const SceneChange& change)
+{
+    UCAD_TRACE_SCOPE("Viewport::applySceneChange");
+    // После замены сцены прежние дескрипторы устарели.
+    if (change.reset) {
+        m_hoveredHandle = Handle();
+    }
+
+    // Отметки пересечений относятся к прежнему состоянию сцены.
+    clearIntersections();
+
+    // Смена видимости слоя не перерисовывает примитивы: слой сцены собирается из растров слоев.
+    // Новые слои запоминаются с их текущей видимостью (их примитивы приходят как добавленные).
+    for (std::uint32_t layer : change.layers) {
+        const bool visible = m_scene->getLayer(layer).visible;
+        if (layer >= m_shownLayers.size()) {
+            m_shownLayers.resize(layer + 1, 1);
+            m_shownLayers[layer] = visible ? 1 : 0;
+        } else if ((m_shownLayers[layer] != 0) != visible) {
+            m_layerVisibilityChanged = true;
+            update();
+        }
+    }
+    if (m_hoveredHandle.isValid() && !change.layers.empty() && !m_scene->isPrimitiveEditable(m_hoveredHandle)) {
+        setHoveredObject(Handle());
+    }
+
+    // Точки привязки обновляются по тем же записям, что и слой.
+    m_snapIndex.applyChange(*m_scene, change);
+    scheduleSnapIndexBuild();
+    if (m_snap.handle.isValid() && !m_scene->contains(m_snap.handle)) {
+        m_snap = SnapResult();
+        update();
+    }
+
+    // Массовые изменения (импорт, пакетное редактирование) проще перерисовать целиком.
+    if (change.reset || change.size() > kMaxIncrementalChanges) {
+        invalidateSceneLayer();
+        return;
+    }
+
+    for (const auto& entry : change.added) invalidateSceneRect(entry.newBox);
+    for (const auto& entry : change.removed) invalidateSceneRect(entry.oldBox);
+    for (const auto& entry : change.modified) {
+        invalidateSceneRect(entry.oldBox);
+        invalidateSceneRect(entry.newBox);
+    }
+}
+
 // Обрабатывает нажатие кнопки мыши для начала панорамирования.
 void Viewport::mousePressEvent(QMouseEvent *event)
 {
+    // Нажатие обрабатывается для вида и привязки, которые видит пользователь.
+    applyPendingInput();
     if (event->button() == Qt::MiddleButton) {
         m_isPanning = true;
         m_lastPanPos = event->pos();
         setCursor(Qt::ClosedHandCursor);
+    } else if (event->button() == Qt::LeftButton && m_scene && m_creationTool == PrimitiveType::Segment) {
+        // Инструмент "Отрезок": первый щелчок задает начало, второй - конец (с учетом привязки).
+        const QPointF point = snappedWorldPos(event->position());
+        if (!m_hasDraftStart) {
+            m_hasDraftStart = true;
+            m_draftStart = point;
+        } else {
+            m_hasDraftStart = false;
+            if (point != m_draftStart) emit segmentDrawn(m_draftStart, point);
+        }
+        update();
+    } else if (event->button() == Qt::LeftButton && m_scene) {
+        // Щелчок или рамка определяются при отпускании кнопки.
+        m_leftButtonDown = true;
+        m_rubberBandOrigin = event->pos();
+        m_rubberBandCurrent = event->pos();
     }
 }
 
-// Обновляет координаты на инфо-панели и выполняет панорамирование.
+// Накапливает сдвиг панорамирования и положение курсора до следующего кадра.
 void Viewport::mouseMoveEvent(QMouseEvent *event)
 {
-    m_currentMouseWorldPos = screenToWorld(event->position());
-    updateInfoLabel();
-
+    markInput();
     if (m_isPanning) {
-        QPoint delta = event->pos() - m_lastPanPos;
+        m_pendingPan += event->pos() - m_lastPanPos;
         m_lastPanPos = event->pos();
-        m_panOffset += QPointF(delta.x() / m_zoomFactor, -delta.y() / m_zoomFactor);
+    }
+    m_pendingCursorPos = event->position();
+    m_hasPendingCursor = true;
+    m_hasPendingInput = true;
+    scheduleFrame();
+}
+
+// Обновляет привязку, координаты на инфо-панели, рамку выделения и подсветку для положения курсора.
+void Viewport::applyCursorMove(const QPointF& screenPos)
+{
+    // При привязке на инфо-панели показываются координаты точки привязки.
+    if (!m_isPanning && !m_isRubberBanding) updateSnap(screenPos);
+    m_currentMouseWorldPos = snappedWorldPos(screenPos);
+    scheduleInfoLabelUpdate();
+    if (m_hasDraftStart) update();
+
+    if (m_isPanning) return;
+    if (m_leftButtonDown) {
+        // Рамка начинается, когда курсор сместился дальше порога перетаскивания.
+        m_rubberBandCurrent = screenPos.toPoint();
+        if (!m_isRubberBanding &&
+            (m_rubberBandCurrent - m_rubberBandOrigin).manhattanLength() >= QApplication::startDragDistance()) {
+            m_isRubberBanding = true;
+            setHoveredObject(Handle());
+            m_snap = SnapResult();
+        }
+        if (m_isRubberBanding) update();
+    } else if (m_scene) {
+        setHoveredObject(pickAt(screenPos));
+    }
+}
+
+// Снимает подсветку, когда курсор покидает виджет.
+void Viewport::leaveEvent(QEvent *event)
+{
+    m_hasPendingCursor = false;
+    setHoveredObject(Handle());
+    if (m_snap.isValid()) {
+        m_snap = SnapResult();
+        update();
+    }
+    QWidget::leaveEvent(event);
+}
+
+// Отменяет создание отрезка по Esc.
+void Viewport::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape && m_hasDraftStart) {
+        m_hasDraftStart = false;
         update();
+        return;
     }
+    QWidget::keyPressEvent(event);
 }
 
 // Завершает режим панорамирования.
 void Viewport::mouseReleaseEvent(QMouseEvent *event)
 {
+    applyPendingInput();
     if (event->button() == Qt::MiddleButton && m_isPanning) {
         m_isPanning = false;
         setCursor(Qt::ArrowCursor);
+    } else if (event->button() == Qt::LeftButton && m_leftButtonDown) {
+        m_leftButtonDown = false;
+        const bool additive = event->modifiers() & Qt::ShiftModifier;
+        std::vector<Handle> picked;
+
+        if (m_isRubberBanding) {
+            // Рамка слева направо выделяет объекты целиком внутри, справа налево - касающиеся ее.
+            m_isRubberBanding = false;
+            const SelectionMode mode = (event->pos().x() >= m_rubberBandOrigin.x())
+                ? SelectionMode::Window : SelectionMode::Crossing;
+            const QPointF a = screenToWorld(m_rubberBandOrigin);
+            const QPointF b = screenToWorld(event->pos());
+            m_scene->selectInRect(QRectF(a, b).normalized(), mode, picked);
+            update();
+        } else {
+            // Щелчок выбирает ближайший к курсору объект (щелчок мимо объектов сбрасывает выбор).
+            const Handle handle = pickAt(event->position());
+            if (handle.isValid()) picked.push_back(handle);
+        }
+        emit objectsPicked(picked, additive);
     }
 }
 
-// Обрабатывает события колеса мыши для масштабирования.
+// Накапливает шаги масштабирования колесом мыши до следующего кадра.
 void Viewport::wheelEvent(QWheelEvent *event)
 {
-    double factor = 1.0 + (event->angleDelta().y() / 8.0) / 100.0;
-    QPointF worldPosBefore = screenToWorld(event->position());
-    m_zoomFactor *= factor;
-    m_zoomFactor = std::max(0.05, std::min(m_zoomFactor, 50.0));
-    QPointF worldPosAfter = screenToWorld(event->position());
-    m_panOffset += worldPosBefore - worldPosAfter;
-    updateInfoLabel();
+    // Шаги с разными точками под курсором не сводятся к одному масштабу: прежние применяются сразу
+    // (без перерисовки - она все равно выполнится один раз в кадре).
+    if (m_pendingZoom != 1.0 && m_pendingZoomAnchor != event->position()) applyPendingZoom();
+
+    markInput();
+    m_pendingZoom *= 1.0 + (event->angleDelta().y() / 8.0) / 100.0;
+    m_pendingZoomAnchor = event->position();
+    m_hasPendingInput = true;
+
+    // Пока колесо вращается, показывается масштабированная копия слоя;
+    // точная перерисовка выполнится после паузы.
+    m_zoomRefineTimer->start();
+
+    scheduleFrame();
+}
+
+// Применяет накопленный масштаб так, чтобы точка под курсором осталась на месте.
+void Viewport::applyPendingZoom()
+{
+    if (m_pendingZoom == 1.0) return;
+    const QPointF worldPosBefore = screenToWorld(m_pendingZoomAnchor);
+    m_zoomFactor = std::clamp(m_zoomFactor * m_pendingZoom, 0.05, 50.0);
+    m_panOffset += worldPosBefore - screenToWorld(m_pendingZoomAnchor);
+    m_pendingZoom = 1.0;
+    scheduleInfoLabelUpdate();
+    update();
+}
+
+// Запоминает момент самого раннего еще не примененного ввода.
+void Viewport::markInput()
+{
+    if (m_pendingInputNs < 0) m_pendingInputNs = m_inputClock.nsecsElapsed();
+}
+
+// Планирует применение накопленного ввода: первый ввод после паузы применяется сразу,
+// следующие - не чаще одного раза за период обновления экрана.
+void Viewport::scheduleFrame()
+{
+    if (m_frameTimer->isActive()) return;
+    const qint64 intervalNs = qint64(frameIntervalMs()) * 1000000;
+    const qint64 sinceLastNs = m_lastFrameNs < 0 ? intervalNs : m_inputClock.nsecsElapsed() - m_lastFrameNs;
+    m_frameTimer->start(int(std::max<qint64>(0, intervalNs - sinceLastNs) / 1000000));
+}
+
+// Возвращает период обновления экрана, на котором находится виджет, мс.
+int Viewport::frameIntervalMs() const
+{
+    const QScreen* current = screen();
+    const double rate = (current && current->refreshRate() > 0.0) ? current->refreshRate() : kDefaultRefreshRate;
+    return std::clamp(int(1000.0 / rate), kMinFrameIntervalMs, kMaxFrameIntervalMs);
+}
+
+// Применяет накопленные с прошлого кадра сдвиг, масштаб и положение курсора.
+void Viewport::applyPendingInput()
+{
+    if (!m_hasPendingInput) return;
+    UCAD_TRACE_SCOPE("Viewport::applyPendingInput");
+    m_hasPendingInput = false;
+    m_lastFrameNs = m_inputClock.nsecsElapsed();
+
+    if (!m_pendingPan.isNull()) {
+        m_panOffset += QPointF(m_pendingPan.x() / m_zoomFactor, -m_pendingPan.y() / m_zoomFactor);
+        m_pendingPan = QPoint(0, 0);
+        update();
+    }
+    applyPendingZoom();
+    if (m_hasPendingCursor) {
+        m_hasPendingCursor = false;
+        applyCursorMove(m_pendingCursorPos);
+    }
+
+    // Ввод без видимых последствий (курсор над пустым местом) не дает отсчета задержки.
+    if (m_repaintRequested && m_unpresentedInputNs < 0) m_unpresentedInputNs = m_pendingInputNs;
+    m_pendingInputNs = -1;
+}
+
+// Возвращает объект под курсором (допуск задается в пикселях и не зависит от масштаба).
+Handle Viewport::pickAt(const QPointF& screenPos) const
+{
+    const double kPickTolerancePx = 5.0;
+    return m_scene->pick(screenToWorld(screenPos), kPickTolerancePx / m_zoomFactor);
+}
+
+// Устанавливает объект под курсором.
+void Viewport::setHoveredObject(Handle handle)
+{
+    if (m_hoveredHandle != handle) {
+        m_hoveredHandle = handle;
+        update();
+    }
+}
+
+// Подсвечивает объект под курсором поверх кэшированного слоя сцены.
+void Viewport::drawHoverHighlight(QPainter& painter)
+{
+    if (!m_scene->contains(m_hoveredHandle) || (m_selection && m_selection->contains(m_hoveredHandle))) return;
+
+    painter.save();
+    painter.translate(0, height());
+    painter.scale(1, -1);
+    painter.scale(m_zoomFactor, m_zoomFactor);
+    painter.translate(m_panOffset.x(), m_panOffset.y());
+
+    // Полупрозрачное перо постоянной экранной толщины.
+    QPen hoverPen(QColor(255, 255, 255, 90), 5.0, Qt::SolidLine, Qt::RoundCap);
+    hoverPen.setCosmetic(true);
+    painter.setPen(hoverPen);
+
+    const std::size_t row = m_scene->getSegmentRow(m_hoveredHandle);
+    if (row != SegmentStore::npos) {
+        const SegmentStore& segments = m_scene->getSegments();
+        painter.drawLine(QPointF(segments.getX0(row), segments.getY0(row)),
+                         QPointF(segments.getX1(row), segments.getY1(row)));
+    } else {
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(m_scene->getBoundingBox(m_hoveredHandle));
+    }
+    painter.restore();
+}
+
+// Отрисовывает рамку выделения: сплошную синюю для режима Window и пунктирную зеленую для Crossing.
+void Viewport::drawRubberBand(QPainter& painter)
+{
+    if (!m_isRubberBanding) return;
+
+    const bool window = m_rubberBandCurrent.x() >= m_rubberBandOrigin.x();
+    const QColor color = window ? QColor(0x66, 0xD9, 0xEF) : QColor(0xA6, 0xE2, 0x2E);
+    QColor fill = color;
+    fill.setAlpha(40);
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(QPen(color, 1.0, window ? Qt::SolidLine : Qt::DashLine));
+    painter.setBrush(fill);
+    painter.drawRect(QRect(m_rubberBandOrigin, m_rubberBandCurrent).normalized());
+    painter.restore();
+}
+
+// Включает или выключает привязку курсора.
+void Viewport::setSnappingEnabled(bool enabled)
+{
+    m_snapEnabled = enabled;
+    scheduleSnapIndexBuild();
+    if (!enabled && m_snap.isValid()) {
+        m_snap = SnapResult();
+        update();
+    }
+}
+
+// Устанавливает инструмент создания (незавершенный отрезок отменяется).
+void Viewport::setCreationTool(PrimitiveType type)
+{
+    m_creationTool = type;
+    if (m_hasDraftStart) {
+        m_hasDraftStart = false;
+        update();
+    }
+}
+
+// Ищет точку привязки в пределах радиуса захвата вокруг курсора.
+void Viewport::updateSnap(const QPointF& screenPos)
+{
+    SnapResult snap;
+    if (m_snapEnabled && m_scene) {
+        snap = m_snapIndex.findSnap(*m_scene, screenToWorld(screenPos), kSnapRadiusPx / m_zoomFactor,
+                                    calculateDynamicGridStep());
+        scheduleSnapIndexBuild();
+    }
+
+    // Маркер перерисовывается только при смене точки привязки.
+    if (snap.kind != m_snap.kind || snap.point != m_snap.point) {
+        m_snap = snap;
+        update();
+    }
+}
+
+// Запускает построение индекса привязки, если он не готов (курсор тем временем привязывается
+// по индексу сцены).
+void Viewport::scheduleSnapIndexBuild()
+{
+    if (m_scene && m_snapEnabled && !m_snapIndex.isReady() && !m_snapBuildTimer->isActive()) {
+        m_snapBuildTimer->start();
+    }
+}
+
+// Возвращает точку привязки, если она найдена, иначе точку под курсором.
+QPointF Viewport::snappedWorldPos(const QPointF& screenPos) const
+{
+    return m_snap.isValid() ? m_snap.point : screenToWorld(screenPos);
+}
+
+// Отрисовывает маркер привязки: квадрат - конец, треугольник - середина, крест - пересечение,
+// песочные часы - ближайшая точка отрезка, малый крест - узел сетки.
+void Viewport::drawSnapMarker(QPainter& painter)
+{
+    if (!m_snap.isValid()) return;
+
+    const QPointF c = worldToScreen(m_snap.point);
+    const double s = kSnapMarkerSize;
+
+    painter.save();
+    painter.setPen(QPen(QColor(0xE6, 0xDB, 0x74), 1.5));
+    painter.setBrush(Qt::NoBrush);
+    switch (m_snap.kind) {
+    case SnapKind::Endpoint:
+        painter.drawRect(QRectF(c.x() - s, c.y() - s, 2.0 * s, 2.0 * s));
+        break;
+    case SnapKind::Midpoint: {
+        const QPointF triangle[] = {{c.x(), c.y() - s}, {c.x() + s, c.y() + s}, {c.x() - s, c.y() + s}};
+        painter.drawPolygon(triangle, 3);
+        break;
+    }
+    case SnapKind::Intersection:
+        painter.drawLine(QPointF(c.x() - s, c.y() - s), QPointF(c.x() + s, c.y() + s));
+        painter.drawLine(QPointF(c.x() - s, c.y() + s), QPointF(c.x() + s, c.y() - s));
+        break;
+    case SnapKind::Nearest: {
+        const QPointF hourglass[] = {{c.x() - s, c.y() - s}, {c.x() + s, c.y() - s},
+                                     {c.x() - s, c.y() + s}, {c.x() + s, c.y() + s}};
+        painter.drawPolygon(hourglass, 4);
+        break;
+    }
+    case SnapKind::Grid:
+        painter.drawLine(QPointF(c.x() - s / 2.0, c.y()), QPointF(c.x() + s / 2.0, c.y()));
+        painter.drawLine(QPointF(c.x(), c.y() - s / 2.0), QPointF(c.x(), c.y() + s / 2.0));
+        break;
+    case SnapKind::None:
+        break;
+    }
+    painter.restore();
+}
+
+// Отмечает найденные пересечения.
+void Viewport::setIntersections(std::vector<SegmentIntersection> intersections)
+{
+    m_intersections = std::move(intersections);
+    std::sort(m_intersections.begin(), m_intersections.end(),
+              [](const SegmentIntersection& a, const SegmentIntersection& b) { return a.point.x() < b.point.x(); });
+
+    m_intersectionReach = 0.0;
+    for (const SegmentIntersection& intersection : m_intersections) {
+        m_intersectionReach = std::max(m_intersectionReach, intersection.end.x() - intersection.point.x());
+    }
     update();
 }
 
+// Снимает отметки пересечений.
+void Viewport::clearIntersections()
+{
+    if (m_intersections.empty()) return;
+    m_intersections.clear();
+    m_intersectionReach = 0.0;
+    update();
+}
+
+// Отрисовывает отметки пересечений: точки - кружками, общие участки наложений - широкой линией.
+// Видимые отметки находятся двоичным поиском по X и выводятся двумя пакетными вызовами.
+void Viewport::drawIntersections(QPainter& painter)
+{
+    if (m_intersections.empty()) return;
+
+    const QRectF visible = visibleWorldRect();
+    auto first = std::lower_bound(m_intersections.begin(), m_intersections.end(), visible.left() - m_intersectionReach,
+                                  [](const SegmentIntersection& a, double x) { return a.point.x() < x; });
+    m_intersectionPoints.clear();
+    m_intersectionOverlaps.clear();
+    for (auto it = first; it != m_intersections.end() && it->point.x() <= visible.right(); ++it) {
+        if (it->kind == IntersectionKind::Overlap) {
+            // Наложение выводится, если его охват пересекается с видимой областью.
+            const double bottom = std::min(it->point.y(), it->end.y());
+            const double top = std::max(it->point.y(), it->end.y());
+            if (it->end.x() >= visible.left() && top >= visible.top() && bottom <= visible.bottom()) {
+                m_intersectionOverlaps.emplace_back(worldToScreen(it->point), worldToScreen(it->end));
+            }
+        } else if (visible.contains(it->point)) {
+            m_intersectionPoints.push_back(worldToScreen(it->point));
+        }
+    }
+
+    painter.save();
+    const QColor color(0xF9, 0x26, 0x72, 200);
+    painter.setPen(QPen(color, 5.0, Qt::SolidLine, Qt::RoundCap));
+    painter.drawLines(m_intersectionOverlaps.data(), static_cast<int>(m_intersectionOverlaps.size()));
+    painter.setPen(QPen(color, 8.0, Qt::SolidLine, Qt::RoundCap));
+    painter.drawPoints(m_intersectionPoints.data(), static_cast<int>(m_intersectionPoints.size()));
+    painter.restore();
+}
+
+// Отрисовывает создаваемый отрезок пунктиром от первой точки до курсора.
+void Viewport::drawDraftSegment(QPainter& painter)
+{
+    if (!m_hasDraftStart) return;
+
+    painter.save();
+    painter.setPen(QPen(QColor(255, 255, 255, 160), 1.0, Qt::DashLine));
+    painter.drawLine(worldToScreen(m_draftStart), worldToScreen(m_currentMouseWorldPos));
+    painter.restore();
+}
+
 // Отрисовка координатной сетки.
 void Viewport::drawGrid(QPainter& painter)
 {
-    QPen gridPen(QColor(50, 52, 71), 1.0, Qt::DotLine);
-    QPen axisXPen(QColor("#F92672"), 1.5);
-    QPen axisYPen(QColor("#66D9EF"), 1.5);
-    double dynamicGridStep = calculateDynamicGridStep();
-
-    QPointF topLeft = screenToWorld({0,0});
-    QPointF bottomRight = screenToWorld({(double)width(), (double)height()});
+    // Геометрия сетки перестраивается только при изменении вида или шага.
+    if (m_gridCache.panOffset != m_panOffset || m_gridCache.zoomFactor != m_zoomFactor ||
+        m_gridCache.gridStep != m_gridStep || m_gridCache.size != size()) {
+        rebuildGridGeometry();
+    }
 
-    // Вертикальные линии.
-    for (double x = std::floor(topLeft.x() / dynamicGridStep) * dynamicGridStep; x < bottomRight.x(); x += dynamicGridStep) {
-        QLineF line(worldToScreen({x, topLeft.y()}), worldToScreen({x, bottomRight.y()}));
-        painter.setPen(std::abs(x) < 1e-9 ? axisYPen : gridPen);
-        painter.drawLine(line);
+    // Все вспомогательные линии - одним вызовом, затем оси поверх них.
+    painter.setPen(m_gridPen);
+    painter.drawLines(m_gridCache.lines.data(), static_cast<int>(m_gridCache.lines.size()));
+    if (m_gridCache.hasAxisY) {
+        painter.setPen(m_axisYPen);
+        painter.drawLine(m_gridCache.axisY);
     }
-    // Горизонтальные линии.
-    for (double y = std::floor(bottomRight.y() / dynamicGridStep) * dynamicGridStep; y < topLeft.y(); y += dynamicGridStep) {
-        QLineF line(worldToScreen({topLeft.x(), y}), worldToScreen({bottomRight.x(), y}));
-        painter.setPen(std::abs(y) < 1e-9 ? axisXPen : gridPen);
-        painter.drawLine(line);
+    if (m_gridCache.hasAxisX) {
+        painter.setPen(m_axisXPen);
+        painter.drawLine(m_gridCache.axisX);
     }
 
     // Рисуем белую точку в начале координат.
@@ -145,6 +1402,54 @@ void Viewport::drawGrid(QPainter& painter)
     painter.restore();
 }
 
+// Перестраивает экранные координаты линий сетки для текущего вида.
+void Viewport::rebuildGridGeometry()
+{
+    m_gridCache.panOffset = m_panOffset;
+    m_gridCache.zoomFactor = m_zoomFactor;
+    m_gridCache.gridStep = m_gridStep;
+    m_gridCache.size = size();
+    m_gridCache.lines.clear();
+    m_gridCache.hasAxisX = false;
+    m_gridCache.hasAxisY = false;
+
+    const double dynamicGridStep = calculateDynamicGridStep();
+    const double screenWidth = width();
+    const double screenHeight = height();
+
+    QPointF topLeft = screenToWorld({0,0});
+    QPointF bottomRight = screenToWorld({screenWidth, screenHeight});
+
+    // Линии нумеруются целым индексом k (координата k * шаг): так ось (k == 0)
+    // определяется точно, без накопления ошибки округления.
+    // Вертикальные линии.
+    const long long firstColumn = static_cast<long long>(std::floor(topLeft.x() / dynamicGridStep));
+    const long long lastColumn = static_cast<long long>(std::ceil(bottomRight.x() / dynamicGridStep));
+    for (long long k = firstColumn; k <= lastColumn; ++k) {
+        const double screenX = (k * dynamicGridStep + m_panOffset.x()) * m_zoomFactor;
+        const QLineF line(screenX, 0.0, screenX, screenHeight);
+        if (k == 0) {
+            m_gridCache.axisY = line;
+            m_gridCache.hasAxisY = true;
+        } else {
+            m_gridCache.lines.push_back(line);
+        }
+    }
+    // Горизонтальные линии.
+    const long long firstRow = static_cast<long long>(std::floor(bottomRight.y() / dynamicGridStep));
+    const long long lastRow = static_cast<long long>(std::ceil(topLeft.y() / dynamicGridStep));
+    for (long long k = firstRow; k <= lastRow; ++k) {
+        const double screenY = screenHeight - (k * dynamicGridStep + m_panOffset.y()) * m_zoomFactor;
+        const QLineF line(0.0, screenY, screenWidth, screenY);
+        if (k == 0) {
+            m_gridCache.axisX = line;
+            m_gridCache.hasAxisX = true;
+        } else {
+            m_gridCache.lines.push_back(line);
+        }
+    }
+}
+
 // Отрисовка гизмо (осей координат) в левом нижнем углу.
 void Viewport::drawGizmo(QPainter& painter)
 {
@@ -189,7 +1494,14 @@ void Viewport::drawGizmo(QPainter& painter)
 }
 
 // Устанавливает сцену для отрисовки.
-void Viewport::setScene(Scene* scene) { m_scene = scene; }
+void Viewport::setScene(Scene* scene)
+{
+    m_scene = scene;
+    m_snapIndex.invalidate();
+    scheduleSnapIndexBuild();
+    clearIntersections();
+}
+
 // Устанавливает стратегии отрисовки.
 void Viewport::setDrawingStrategies(const std::map<PrimitiveType, std::unique_ptr<Draw>>* strategies) { m_drawingStrategies = strategies; }
 
@@ -204,15 +1516,42 @@ void Viewport::setGridStep(int step)
 }
 
 // Запрашивает перерисовку виджета.
-void Viewport::update() { QWidget::update(); }
+void Viewport::update()
+{
+    m_repaintRequested = true;
+    QWidget::update();
+}
+
+// Запрашивает обновление инфо-панели не чаще периода ее обновления.
+void Viewport::scheduleInfoLabelUpdate()
+{
+    if (!m_infoLabelTimer->isActive()) m_infoLabelTimer->start();
+}
+
+// Устанавливает набор выделенных объектов для подсветки.
+void Viewport::setSelection(const Selection* selection)
+{
+    m_selection = selection;
+    invalidateSceneLayer();
+}
 
-// Устанавливает текущий выбранный объект для подсветки.
-void Viewport::setSelectedObject(Object* obj)
+// Перерисовывает подсветку объектов, выделение которых изменилось.
+void Viewport::updateSelection(const std::vector<Handle>& changed)
 {
-    if (m_selectedObject != obj) {
-        m_selectedObject = obj;
-        update(); // Запрашиваем перерисовку, чтобы (де)активировать подсветку
+    UCAD_TRACE_SCOPE("Viewport::updateSelection");
+    // Подсветка входит в слой сцены: при небольшом изменении перерисовываются только
+    // области затронутых объектов, при массовом - весь слой.
+    if (changed.size() > kMaxIncrementalChanges) {
+        invalidateSceneLayer();
+        return;
     }
+
+    for (const Handle& handle : changed) {
+        if (m_scene && m_scene->contains(handle)) {
+            invalidateSceneRect(m_scene->getBoundingBox(handle));
+        }
+    }
+    update();
 }
 
 // Преобразует мировые координаты в экранные.
@@ -229,6 +1568,18 @@ QPointF Viewport::screenToWorld(const QPointF& screenPos) const {
     return QPointF(worldX, worldY);
 }
 
+// Возвращает видимую область сцены в мировых координатах.
+QRectF Viewport::visibleWorldRect() const
+{
+    QPointF topLeft = screenToWorld({0, 0});
+    QPointF bottomRight = screenToWorld({(double)width(), (double)height()});
+
+    // Запас на толщину пера подсветки, чтобы не обрезать линии у края экрана.
+    const double margin = 3.0;
+    return QRectF(QPointF(topLeft.x(), bottomRight.y()), QPointF(bottomRight.x(), topLeft.y()))
+        .adjusted(-margin, -margin, margin, margin);
+}
+
 // Слот для смены системы координат на инфо-панели.
 void Viewport::setCoordinateSystem(CoordinateSystemType type)
 {
@@ -267,5 +1618,22 @@ void Viewport::updateInfoLabel()
     }
 
     infoText += QString("\nGrid: %1 px").arg(calculateDynamicGridStep());
+
+    if (m_statsVisible) {
+        const FrameStats& last = m_renderStats.getLastFrame();
+        infoText += QString("\n\nFrame: %1 ms").arg(last.frameMs, 0, 'f', 2);
+        infoText += QString("\nAvg: %1 ms  p99: %2 ms")
+                        .arg(m_renderStats.getAverageFrameMs(), 0, 'f', 2)
+                        .arg(m_renderStats.getPercentileFrameMs(99.0), 0, 'f', 2);
+        infoText += QString("\nVisited: %1").arg(last.visited);
+        infoText += QString("\nCulled: %1").arg(last.culled);
+        infoText += QString("\nDrawn: %1").arg(last.drawn);
+        infoText += QString("\nDraw calls: %1").arg(last.drawCalls);
+        infoText += QString("\nCache hit: %1%").arg(m_renderStats.getAverageCacheHitRate() * 100.0, 0, 'f', 1);
+        infoText += QString("\nInput: %1 ms  p99: %2 ms")
+                        .arg(m_renderStats.getAverageInputLatencyMs(), 0, 'f', 2)
+                        .arg(m_renderStats.getPercentileInputLatencyMs(99.0), 0, 'f', 2);
+        if (m_renderStats.isRecordingCsv()) infoText += "\nCSV: recording";
+    }
     m_infoLabel->setText(infoText);
 }
@@ -1,17 +1,30 @@
 #pragma once
 
 #include <QWidget>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPen>
+#include <QLineF>
+#include <QRegion>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "Enums.h"
+#include "Handle.h"
+#include "SceneChange.h"
+#include "TileRenderer.h"
+#include "RenderStats.h"
+#include "SnapIndex.h"
+#include "IntersectionFinder.h"
 
 // Прямые объявления.
 class Scene;
+class Selection;
 class Draw;
 class QPainter;
 class QLabel;
-class Object;
+class QTimer;
 
 // Виджет для отрисовки 2D-сцены, сетки и навигации.
 class Viewport : public QWidget
@@ -37,6 +50,21 @@ public:
     // Преобразует экранные координаты в мировые.
     QPointF screenToWorld(const QPointF& screenPos) const;
 
+    // Возвращает видимую область сцены в мировых координатах.
+    QRectF visibleWorldRect() const;
+
+    // Возвращает статистику отрисовки (в том числе для записи в CSV).
+    RenderStats& getRenderStats();
+
+    // Возвращает true, если на инфо-панели показывается статистика отрисовки.
+    bool isStatsOverlayVisible() const;
+
+    // Отмечает найденные пересечения отрезков (отметки снимаются при изменении сцены).
+    void setIntersections(std::vector<SegmentIntersection> intersections);
+
+    // Снимает отметки пересечений.
+    void clearIntersections();
+
 public slots:
     // Запрашивает перерисовку виджета.
     void update();
@@ -44,8 +72,43 @@ public slots:
     // Устанавливает систему координат для отображения на инфо-панели.
     void setCoordinateSystem(CoordinateSystemType type);
 
-    // Устанавливает текущий выбранный объект для подсветки.
-    void setSelectedObject(Object* obj);
+    // Устанавливает набор выделенных объектов для подсветки (принадлежит главному окну).
+    void setSelection(const Selection* selection);
+
+    // Перерисовывает подсветку объектов, выделение которых изменилось.
+    void updateSelection(const std::vector<Handle>& changed);
+
+    // Помечает кэшированный слой сцены устаревшим (сцена или стили изменились).
+    void invalidateSceneLayer();
+
+    // Помечает устаревшей часть слоя сцены, покрывающую прямоугольник в мировых координатах.
+    void invalidateSceneRect(const QRectF& worldRect);
+
+    // Перерисовывает в слое только области, затронутые изменением сцены.
+    void applySceneChange(const SceneChange& change);
+
+    // Включает режим детализации: отрезки короче пикселя выводятся точками.
+    void setLevelOfDetailEnabled(bool enabled);
+
+    // Включает параллельную отрисовку слоя сцены по плиткам на всех ядрах процессора.
+    void setParallelRenderingEnabled(bool enabled);
+
+    // Показывает или скрывает статистику отрисовки на инфо-панели.
+    void setStatsOverlayVisible(bool visible);
+
+    // Включает привязку курсора к характерным точкам объектов и узлам сетки.
+    void setSnappingEnabled(bool enabled);
+
+    // Устанавливает инструмент создания: для отрезка щелчки левой кнопкой задают его концы.
+    void setCreationTool(PrimitiveType type);
+
+signals:
+    // Сигнал о выборе объектов щелчком или рамкой левой кнопкой (пустой список - щелчок мимо объектов).
+    // additive - выбор дополняет текущее выделение (зажат Shift).
+    void objectsPicked(const std::vector<Handle>& handles, bool additive);
+
+    // Сигнал о том, что инструментом создания заданы оба конца нового отрезка (мировые координаты).
+    void segmentDrawn(const QPointF& start, const QPointF& end);
 
 protected:
     // Главный метод отрисовки виджета.
@@ -56,17 +119,140 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+    void leaveEvent(QEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
 
 private:
     // Отрисовывает координатную сетку.
     void drawGrid(QPainter& painter);
 
+    // Перестраивает геометрию сетки для текущего вида.
+    void rebuildGridGeometry();
+
+    // Возвращает объект под курсором в пределах допуска в пикселях.
+    Handle pickAt(const QPointF& screenPos) const;
+
+    // Устанавливает объект под курсором и перерисовывает подсветку при его смене.
+    void setHoveredObject(Handle handle);
+
+    // Отрисовывает подсветку объекта под курсором поверх слоя сцены.
+    void drawHoverHighlight(QPainter& painter);
+
+    // Отрисовывает рамку выделения.
+    void drawRubberBand(QPainter& painter);
+
+    // Ищет точку привязки под курсором и перерисовывает маркер при ее смене.
+    void updateSnap(const QPointF& screenPos);
+
+    // Продолжает построение индекса привязки порциями между событиями, пока он не будет готов.
+    void scheduleSnapIndexBuild();
+
+    // Возвращает точку под курсором в мировых координатах с учетом привязки.
+    QPointF snappedWorldPos(const QPointF& screenPos) const;
+
+    // Отрисовывает маркер точки привязки.
+    void drawSnapMarker(QPainter& painter);
+
+    // Отрисовывает создаваемый отрезок от первой заданной точки до курсора.
+    void drawDraftSegment(QPainter& painter);
+
+    // Отрисовывает отметки пересечений, попадающих в видимую область.
+    void drawIntersections(QPainter& painter);
+
     // Отрисовывает гизмо (оси координат) в углу виджета.
     void drawGizmo(QPainter& painter);
 
+    // Приводит кэшированный слой сцены к текущему виду (перерисовка или сдвиг).
+    void updateSceneLayer();
+
+    // Начинает перерисовку кэшированного слоя сцены и растров слоев целиком
+    // (прогрессивно, в пределах бюджета кадра).
+    void renderSceneLayer();
+
+    // Собирает очередь видимых примитивов для прогрессивной отрисовки слоя.
+    void startProgressivePass();
+
+    // Добавляет примитивы в очередь прогрессивной отрисовки (крупные - первыми, затем по слоям).
+    void enqueueProgressive(const std::vector<Handle>& handles);
+
+    // Рисует следующие порции очереди в растры слоев, пока не исчерпан бюджет кадра.
+    void continueProgressivePass();
+
+    // Сдвигает слой и растры слоев при панорамировании и дорисовывает открывшиеся полосы.
+    void scrollSceneLayer();
+
+    // Перерисовывает в растрах и слое накопленные устаревшие области.
+    void repaintDirtyLayerRegion();
+
+    // Собирает слой сцены из растров видимых слоев (после смены видимости слоев).
+    void recompositeLayers();
+
+    // Ставит примитивы слоя в очередь прогрессивной отрисовки для перестройки его растра.
+    void enqueueLayer(std::uint32_t layer);
+
+    // Возвращает наибольшее число собственных растров слоев в бюджете памяти.
+    std::size_t maxLayerRasters() const;
+
+    // Освобождает место под собственный растр слоя, если бюджет памяти растров исчерпан.
+    void reserveLayerRaster();
+
+    // Заводит растры слоев, добавленных в сцену после перерисовки вида.
+    void addLayerRasters();
+
+    // Перерисовывает экранную область слоя во всех поддерживаемых растрах слоев.
+    void renderLayers(const QRect& screenRect);
+
+    // Собирает область слоя сцены из растров видимых слоев.
+    void compositeSceneLayer(const QRegion& region);
+
+    // Возвращает изображение, в которое рисуется слой (создается при первой отрисовке в него).
+    QImage& layerImage(std::uint32_t layer);
+
+    // Отмечает плитки слоя, задетые нарисованными примитивами.
+    void markDrawnTiles(const std::vector<Handle>& handles, const QRect& clip);
+
+    // Возвращает область отмеченных плиток слоя.
+    QRegion drawnRegion();
+
+    // Выводит слой сцены на экран (при прокрутке колеса - масштабированным).
+    void drawSceneLayer(QPainter& painter);
+
+    // Отрисовывает указанные примитивы в экранной области слоя.
+    void drawPrimitives(QPainter& painter, const QRect& screenRect, const std::vector<Handle>& handles);
+
+    // Отрисовывает указанные примитивы по плиткам на рабочих потоках.
+    void drawPrimitivesTiled(QPainter& painter, const QRect& screenRect, const std::vector<Handle>& handles);
+
+    // Переводит прямоугольник в мировых координатах в экранную область слоя.
+    QRect worldRectToLayer(const QRectF& worldRect) const;
+
+    // Переводит экранную область слоя в мировые координаты.
+    QRectF layerRectToWorld(const QRect& screenRect) const;
+
     // Обновляет текст на информационной панели.
     void updateInfoLabel();
 
+    // Запрашивает обновление инфо-панели не чаще периода ее обновления.
+    void scheduleInfoLabelUpdate();
+
+    // Запоминает момент самого раннего еще не показанного ввода.
+    void markInput();
+
+    // Планирует кадр: накопленный ввод применяется и выводится не чаще частоты обновления экрана.
+    void scheduleFrame();
+
+    // Возвращает период обновления экрана, на котором находится виджет, мс.
+    int frameIntervalMs() const;
+
+    // Применяет накопленные с прошлого кадра сдвиг, масштаб и положение курсора.
+    void applyPendingInput();
+
+    // Применяет накопленный масштаб вокруг точки под курсором.
+    void applyPendingZoom();
+
+    // Обновляет привязку, подсветку и рамку выделения для положения курсора.
+    void applyCursorMove(const QPointF& screenPos);
+
     // Рассчитывает динамический шаг сетки для текущего масштаба.
     double calculateDynamicGridStep() const;
 
@@ -76,8 +262,153 @@ private:
     // Указатель на стратегии отрисовки.
     const std::map<PrimitiveType, std::unique_ptr<Draw>>* m_drawingStrategies = nullptr;
 
-    // Указатель на выбранный объект (для подсветки).
-    Object* m_selectedObject = nullptr;
+    // Выделенные объекты (для подсветки).
+    const Selection* m_selection = nullptr;
+
+    // Состояние рамки выделения: точка нажатия и текущая точка в экранных координатах.
+    bool m_leftButtonDown = false;
+    bool m_isRubberBanding = false;
+    QPoint m_rubberBandOrigin;
+    QPoint m_rubberBandCurrent;
+
+    // Дескриптор объекта под курсором (подсвечивается поверх слоя, не входит в кэш).
+    Handle m_hoveredHandle;
+
+    // Привязка курсора: индекс точек привязки и текущая точка (маркер рисуется поверх слоя).
+    SnapIndex m_snapIndex;
+    SnapResult m_snap;
+    bool m_snapEnabled = true;
+
+    // Таймер продолжения построения индекса привязки: срабатывает, когда очередь событий пуста.
+    QTimer* m_snapBuildTimer;
+
+    // Отмеченные пересечения (упорядочены по X точки) и наибольшая протяженность наложения по X.
+    std::vector<SegmentIntersection> m_intersections;
+    double m_intersectionReach = 0.0;
+    std::vector<QPointF> m_intersectionPoints;
+    std::vector<QLineF> m_intersectionOverlaps;
+
+    // Инструмент создания и первая точка создаваемого отрезка.
+    PrimitiveType m_creationTool = PrimitiveType::Generic;
+    bool m_hasDraftStart = false;
+    QPointF m_draftStart;
+
+    // Буфер дескрипторов примитивов, попавших в видимую область (переиспользуется между кадрами).
+    std::vector<Handle> m_visibleHandles;
+
+    // Буферы строк видимых и выделенных отрезков для пакетной отрисовки.
+    std::vector<std::size_t> m_visibleSegmentRows;
+    std::vector<std::size_t> m_selectedSegmentRows;
+
+    // Перья сетки и осей (создаются один раз).
+    QPen m_gridPen{QColor(50, 52, 71), 1.0, Qt::DotLine};
+    QPen m_axisXPen{QColor(0xF9, 0x26, 0x72), 1.5};
+    QPen m_axisYPen{QColor(0x66, 0xD9, 0xEF), 1.5};
+
+    // Кэш геометрии сетки в экранных координатах и вид, для которого она построена.
+    struct GridCache
+    {
+        QPointF panOffset;
+        double zoomFactor = 0.0;
+        int gridStep = 0;
+        QSize size;
+        std::vector<QLineF> lines;
+        QLineF axisX, axisY;
+        bool hasAxisX = false;
+        bool hasAxisY = false;
+    } m_gridCache;
+
+    // Кэшированный растровый слой сцены и вид, для которого он построен.
+    QImage m_sceneLayer;
+    QPointF m_layerPanOffset{0.0, 0.0};
+    double m_layerZoom = 1.0;
+    bool m_layerValid = false;
+
+    // Устаревшие области слоя (в экранных координатах слоя), которые нужно перерисовать.
+    QRegion m_layerDirty;
+
+    // Растр одного слоя сцены в виде слоя сцены (пустое изображение - слой в виде ничего не рисует),
+    // признак того, что растр поддерживается актуальным, признак отрисовки слоя в общий растр,
+    // момент последнего переключения слоя и позиция в очереди прогрессивной отрисовки, с которой
+    // рисуются примитивы слоя.
+    struct LayerRaster
+    {
+        QImage image;
+        bool valid = false;
+        bool shared = false;
+        std::uint64_t lastUsed = 0;
+        std::size_t queueStart = 0;
+    };
+
+    // Растры слоев сцены: отрисовка рисует примитивы в растр их слоя, а слой сцены собирается
+    // из растров видимых слоев, поэтому переключение слоя не перебирает примитивы. Растры
+    // сдвигаются и перерисовываются вместе со слоем сцены; растры скрытых при полной перерисовке
+    // слоев не строятся и заполняются прогрессивной отрисовкой при показе слоя.
+    // Собственные растры ограничены бюджетом памяти: сверх него освобождаются растры слоев,
+    // скрытых раньше всех, а видимые слои, которые дольше всех не переключали, рисуются
+    // в общий растр (он собирается в слой сцены под собственными растрами).
+    std::vector<LayerRaster> m_layerRasters;
+    QImage m_sharedRaster;
+    std::uint64_t m_layerRasterClock = 0;
+
+    // Видимость слоев, с которой построен слой сцены, и признак ее изменения.
+    std::vector<char> m_shownLayers;
+    bool m_layerVisibilityChanged = false;
+
+    // Прогрессивная отрисовка слоя: очередь примитивов (крупные - первыми), позиция в ней
+    // и буфер текущей порции. Новый масштаб отменяет незавершенную очередь, а сдвиг
+    // только сужает области пакетов до сохранившейся при прокрутке части слоя.
+    std::vector<Handle> m_progressiveQueue;
+    std::vector<Handle> m_progressiveChunk;
+    std::size_t m_progressiveNext = 0;
+    bool m_progressiveActive = false;
+
+    // Пакет очереди, добавленный одним запросом: конец пакета в очереди и область слоя,
+    // в которой его примитивы еще не нарисованы.
+    struct ProgressiveBatch
+    {
+        std::size_t end;
+        QRect clip;
+    };
+    std::vector<ProgressiveBatch> m_progressiveBatches;
+
+    // Плитки слоя, задетые примитивами в текущем кадре прогрессивной отрисовки,
+    // и буфер прямоугольников их области.
+    std::vector<char> m_drawnTiles;
+    int m_drawnTileColumns = 0;
+    std::vector<QRect> m_drawnRects;
+    QTimer* m_progressiveTimer;
+
+    // Режим детализации для субпиксельных отрезков (включен по умолчанию).
+    bool m_levelOfDetail = true;
+
+    // Параллельная отрисовка по плиткам (включена по умолчанию) и ее растры плиток.
+    bool m_parallelRendering = true;
+    TileRenderer m_tileRenderer;
+
+    // Таймер отложенной точной перерисовки после масштабирования колесом.
+    QTimer* m_zoomRefineTimer;
+
+    // Планировщик кадров: события мыши только накапливают сдвиг (в пикселях), произведение
+    // шагов масштаба с точкой под курсором и последнее положение курсора, а таймер применяет
+    // их один раз за период обновления экрана и запрашивает одну перерисовку.
+    QTimer* m_frameTimer;
+    QPoint m_pendingPan{0, 0};
+    double m_pendingZoom = 1.0;
+    QPointF m_pendingZoomAnchor;
+    QPointF m_pendingCursorPos;
+    bool m_hasPendingCursor = false;
+    bool m_hasPendingInput = false;
+
+    // Часы ввода, момент начала предыдущего кадра и моменты самого раннего ввода:
+    // еще не примененного и уже примененного, но не выведенного на экран (нс, -1 - нет).
+    QElapsedTimer m_inputClock;
+    qint64 m_lastFrameNs = -1;
+    qint64 m_pendingInputNs = -1;
+    qint64 m_unpresentedInputNs = -1;
+
+    // Признак запрошенной и еще не выполненной перерисовки.
+    bool m_repaintRequested = false;
 
     // Параметры навигации.
     int m_gridStep = 50;
@@ -86,6 +417,16 @@ private:
     QPoint m_lastPanPos;
     bool m_isPanning = false;
 
+    // Статистика отрисовки: окно последних кадров и показатели текущего кадра.
+    RenderStats m_renderStats;
+    FrameStats m_frameStats;
+    double m_frameRepaintedArea = 0.0; // Площадь слоя, перерисованная в текущем кадре (логические пиксели).
+    bool m_statsVisible = false;
+    QTimer* m_statsRefreshTimer;
+
+    // Таймер обновления инфо-панели при вводе: координаты курсора не переписываются чаще его периода.
+    QTimer* m_infoLabelTimer;
+
     // Поля для инфо-панели.
     QLabel* m_infoLabel;
     QPointF m_currentMouseWorldPos{0.0, 0.0};